@@ -0,0 +1,182 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: Multi-LED blink scheduler. One thread drives every LED from a list of deadlines
+ *               sorted by time, so each LED costs a channel entry instead of a thread stack
+ *
+ * Modules:
+ *      CSE321_project1_mabautis_log - Toggle messages, printed by the log thread
+ *
+ * Subroutines:
+ * int blink_add(PinName pin, const char *name, uint32_t on_ms, uint32_t off_ms, uint32_t phase_ms) - Registers an LED, returns its channel
+ * void blink_start(Thread &thread) - Runs the scheduler on thread
+ * void blink_pause(int channel) - Stops a channel with its LED off (ISR safe)
+ * void blink_resume(int channel) - Restarts a paused channel with a full on period (ISR safe)
+ * void blink_toggle(int channel) - Pauses a blinking channel or resumes a paused one (ISR safe)
+ * void blink_run(void) - Scheduler thread, sleeps until the earliest deadline or a pause request
+ * void apply_requests(void) - Moves channels in and out of the schedule to match the pause requests
+ * void schedule_insert(BlinkChannel *channel) - Adds a channel to the schedule in deadline order
+ * void schedule_remove(BlinkChannel *channel) - Takes a channel out of the schedule
+ *
+ * Assignment: Project 1
+ * Inputs:
+ * Outputs:
+ *      Any GPIO output pin registered as a channel
+ * Constraints:
+ *      Channels are added before blink_start, the channel table is not locked
+ *      Timing resolution is the 1ms RTOS tick. Every deadline is the previous one plus the phase
+ *      time, so periods do not drift
+ *      Pause requests are a bit mask the ISRs write and only the scheduler applies, so the schedule
+ *      itself is never shared
+ * References:
+ *      MBED Thread flags - https://os.mbed.com/docs/mbed-os/v6.15/apis/thisthread.html
+ */
+#include "CSE321_project1_mabautis_blink.h"
+#include "CSE321_project1_mabautis_log.h"
+
+#define FLAG_REQUEST 1 // Scheduler thread flag: the pause requests changed
+
+struct BlinkChannel {
+  gpio_t gpio;                        // Output pin
+  const char *name;                   // LED name in the toggle messages
+  uint32_t on_ms;                     // Time on each period
+  uint32_t off_ms;                    // Time off each period
+  Kernel::Clock::time_point deadline; // End of the current phase
+  BlinkChannel *next;                 // Next channel in the schedule
+  uint8_t output_on;                  // Current phase, 1 -> on, 0 -> off
+  uint8_t paused;                     // Pause request the scheduler has applied
+};
+
+static void blink_run(void); // Scheduler thread, sleeps until the earliest deadline or a pause request
+static void apply_requests(void); // Moves channels in and out of the schedule to match the pause requests
+static void schedule_insert(BlinkChannel *channel); // Adds a channel to the schedule in deadline order
+static void schedule_remove(BlinkChannel *channel); // Takes a channel out of the schedule
+
+static BlinkChannel channels[BLINK_CHANNELS]; // Registered LEDs
+static int channel_count = 0; // Number of registered LEDs
+static BlinkChannel *schedule = nullptr; // Blinking channels, earliest deadline first
+static volatile uint32_t pause_requests = 0; // Bit per channel, 1 -> the channel should be paused
+static Thread *scheduler = nullptr; // Thread running blink_run
+
+int blink_add(PinName pin, const char *name, uint32_t on_ms, uint32_t off_ms, uint32_t phase_ms) {
+  if (channel_count == BLINK_CHANNELS || !on_ms || !off_ms) {
+    return -1; // No free channels, or a period that would never end
+  }
+  BlinkChannel &ch = channels[channel_count];
+  gpio_init_out_ex(&ch.gpio, pin, 0); // Off until its first on phase
+  ch.name = name;
+  ch.on_ms = on_ms;
+  ch.off_ms = off_ms;
+  ch.deadline = Kernel::Clock::time_point(std::chrono::milliseconds(phase_ms)); // Made absolute by blink_run
+  ch.output_on = 0;
+  ch.paused = 0;
+  return channel_count++;
+}
+
+void blink_start(Thread &thread) {
+  scheduler = &thread;
+  thread.start(&blink_run);
+}
+
+void blink_pause(int channel) {
+  if (channel < 0 || channel >= channel_count) {
+    return;
+  }
+  core_util_critical_section_enter(); // Callers are threads and ISRs
+  pause_requests |= 1u << channel;
+  core_util_critical_section_exit();
+  if (scheduler) {
+    scheduler->flags_set(FLAG_REQUEST);
+  }
+}
+
+void blink_resume(int channel) {
+  if (channel < 0 || channel >= channel_count) {
+    return;
+  }
+  core_util_critical_section_enter();
+  pause_requests &= ~(1u << channel);
+  core_util_critical_section_exit();
+  if (scheduler) {
+    scheduler->flags_set(FLAG_REQUEST);
+  }
+}
+
+void blink_toggle(int channel) {
+  if (channel < 0 || channel >= channel_count) {
+    return;
+  }
+  core_util_critical_section_enter();
+  pause_requests ^= 1u << channel;
+  core_util_critical_section_exit();
+  if (scheduler) {
+    scheduler->flags_set(FLAG_REQUEST);
+  }
+}
+
+static void blink_run(void) {
+  Kernel::Clock::time_point start = Kernel::Clock::now();
+  for (int i = 0; i < channel_count; i++) {
+    channels[i].deadline += start.time_since_epoch(); // First on phase starts phase_ms from now
+    schedule_insert(&channels[i]);
+  }
+  while (true) {
+    apply_requests();
+    if (!schedule) {
+      ThisThread::flags_wait_any(FLAG_REQUEST); // Every channel paused, nothing to wake up for
+      continue;
+    }
+    if (ThisThread::flags_wait_any_until(FLAG_REQUEST, schedule->deadline)) {
+      continue; // Pause request, 0 -> the earliest deadline was reached
+    }
+    Kernel::Clock::time_point now = Kernel::Clock::now();
+    while (schedule && schedule->deadline <= now) { // Every channel due at this tick
+      BlinkChannel *ch = schedule;
+      schedule = ch->next;
+      ch->output_on = !ch->output_on;
+      gpio_write(&ch->gpio, ch->output_on);
+      LOG_INFO("Toggle the %s LED %s", ch->name, ch->output_on ? "on" : "off"); // Both strings are literals
+      ch->deadline += std::chrono::milliseconds(ch->output_on ? ch->on_ms : ch->off_ms);
+      schedule_insert(ch);
+    }
+  }
+}
+
+static void apply_requests(void) {
+  uint32_t requests = pause_requests;
+  for (int i = 0; i < channel_count; i++) {
+    BlinkChannel &ch = channels[i];
+    uint8_t paused = (requests >> i) & 1;
+    if (paused == ch.paused) {
+      continue;
+    }
+    ch.paused = paused;
+    if (paused) {
+      schedule_remove(&ch);
+      ch.output_on = 0;
+      gpio_write(&ch.gpio, 0); // Paused LEDs stay off
+    } else {
+      ch.output_on = 0;
+      ch.deadline = Kernel::Clock::now(); // Due now, turns on for a full on period
+      schedule_insert(&ch);
+    }
+  }
+}
+
+static void schedule_insert(BlinkChannel *channel) {
+  BlinkChannel **link = &schedule;
+  while (*link && (*link)->deadline <= channel->deadline) { // Equal deadlines keep their order
+    link = &(*link)->next;
+  }
+  channel->next = *link;
+  *link = channel;
+}
+
+static void schedule_remove(BlinkChannel *channel) {
+  for (BlinkChannel **link = &schedule; *link; link = &(*link)->next) {
+    if (*link == channel) {
+      *link = channel->next;
+      return;
+    }
+  }
+}
@@ -0,0 +1,40 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: Multi-LED blink scheduler. One thread drives every LED from a list of deadlines
+ *               sorted by time, so each LED costs a channel entry instead of a thread stack
+ *
+ * Modules:
+ *
+ * Subroutines:
+ * int blink_add(PinName pin, const char *name, uint32_t on_ms, uint32_t off_ms, uint32_t phase_ms) - Registers an LED, returns its channel
+ * void blink_start(Thread &thread) - Runs the scheduler on thread
+ * void blink_pause(int channel) - Stops a channel with its LED off (ISR safe)
+ * void blink_resume(int channel) - Restarts a paused channel with a full on period (ISR safe)
+ * void blink_toggle(int channel) - Pauses a blinking channel or resumes a paused one (ISR safe)
+ *
+ * Assignment: Project 1
+ * Inputs:
+ * Outputs:
+ *      Any GPIO output pin registered as a channel
+ * Constraints:
+ *      Channels are added before blink_start, the channel table is not locked
+ *      Timing resolution is the 1ms RTOS tick. Every deadline is the previous one plus the phase
+ *      time, so periods do not drift
+ * References:
+ *      MBED Thread flags - https://os.mbed.com/docs/mbed-os/v6.15/apis/thisthread.html
+ */
+#ifndef CSE321_PROJECT1_MABAUTIS_BLINK_H
+#define CSE321_PROJECT1_MABAUTIS_BLINK_H
+
+#include <mbed.h>
+
+#define BLINK_CHANNELS 8 // Maximum number of LEDs, one bit each in the pause request mask
+
+int blink_add(PinName pin, const char *name, uint32_t on_ms, uint32_t off_ms, uint32_t phase_ms); // Registers an LED, returns its channel or -1
+void blink_start(Thread &thread); // Runs the scheduler on thread
+void blink_pause(int channel); // Stops a channel with its LED off (ISR safe)
+void blink_resume(int channel); // Restarts a paused channel with a full on period (ISR safe)
+void blink_toggle(int channel); // Pauses a blinking channel or resumes a paused one (ISR safe)
+
+#endif
@@ -1,47 +1,85 @@
 #include "mbed.h"
+#include "CSE321_project1_mabautis_blink.h"
+#include "CSE321_project1_mabautis_log.h"
 
-// Create a thread to drive an LED to have an on time of 2000ms and off time of 500ms
+// Create a thread to drive an LED to have an on time of 2000ms and off time of 500ms. With the
+// blink-demo option the same thread also blinks the green and red LEDs on their own schedules
 
-Thread controller; // Allows event based execution, scheduling, and priority management
+#ifndef MBED_CONF_APP_CONTROLLER_STACK_PEAK
+#define MBED_CONF_APP_CONTROLLER_STACK_PEAK 0
+#endif
+#ifndef MBED_CONF_APP_LOG_STACK_PEAK
+#define MBED_CONF_APP_LOG_STACK_PEAK 0
+#endif
+#ifndef MBED_CONF_APP_BLINK_DEMO
+#define MBED_CONF_APP_BLINK_DEMO 0
+#endif
+#ifndef MBED_CONF_APP_STACK_MARGIN
+#define MBED_CONF_APP_STACK_MARGIN 25
+#endif
+
+// Controller stack from the peak measured with the memory command (mbed_app.json), 0 keeps the default
+#define STACK_MARGIN_BYTES 256 // Always added on top of the percentage (FPU context frame is 200 bytes)
+#define STACK_FROM_PEAK(peak, fallback) \
+  ((peak) ? (((peak) * (100 + MBED_CONF_APP_STACK_MARGIN) / 100 + STACK_MARGIN_BYTES + 7) & ~7u) : (fallback))
+#define CONTROLLER_STACK_SIZE STACK_FROM_PEAK(MBED_CONF_APP_CONTROLLER_STACK_PEAK, OS_STACK_SIZE)
+#define LOGGER_STACK_SIZE STACK_FROM_PEAK(MBED_CONF_APP_LOG_STACK_PEAK, 2048) // snprintf
+#define MEMORY_THREADS_MAX 6 // main, idle, timer, controller, log and spare
+
+Thread controller(osPriorityNormal, CONTROLLER_STACK_SIZE, nullptr, "controller"); // Allows event based execution, scheduling, and priority management
+Thread logger(osPriorityLow, LOGGER_STACK_SIZE, nullptr, "log"); // Prints the log messages the controller leaves in RAM
 
 // Function prototypes
-void led_handler();     // Toggles blue LED on and off
 void set_toggle_flag(); // Allow state to be toggled
-void toggle_state();    // Toggle state to halt the blinking LED
+void toggle_state();    // Pauses or resumes the blue LED
+void print_memory();    // Prints each thread's stack peak and the heap use
+void print_cpu();       // Prints the idle and sleep time since the last cpu command
 
-DigitalOut blue_led(LED2);     // Set blue LED as an output
 InterruptIn button_1(BUTTON1); // Set button 1 as an input
 
-int _state = 0;       // Active low state which allows the thread handler to toggle the blue LED
-int toggle_flag = 0; // Toggle flag must be 1 to allow for state change
+int blue_led = -1; // Blink channel of the blue LED
+
+int toggle_flag = 0; // Set on the rising edge, only the button ISRs use it
 
 int main()
 {
   printf("----------------START----------------\n");
   printf("Starting state of thread: %d\n", controller.get_state());
-  controller.start(led_handler); // Begin thread execution
+  log_start(logger); // Before the controller logs anything
+  blue_led = blink_add(LED2, "blue", 2000, 500, 0);
+#if MBED_CONF_APP_BLINK_DEMO
+  blink_add(LED1, "green", 1000, 1000, 0); // Extra channels that exercise the scheduler, off by default
+  blink_add(LED3, "red", 250, 1250, 500); // Flashes between the green edges
+#endif
+  blink_start(controller); // Begin thread execution, one thread for every LED
   printf("State of thread right after start: %d\n", controller.get_state());
   button_1.rise(set_toggle_flag); // On rising edge, set the toggle flag
   button_1.fall(toggle_state);    // On falling edge, attempt to toggle the state
 
-  return 0;
-}
-
-// Thread handler to toggle blue LED on and off
-void led_handler()
-{
+  // Serial commands: "memory" prints the stack and heap report, "cpu" the idle time
+  char line[16];
+  int length = 0;
   while (true)
   {
-    if (_state == 0)
+    int c = getchar(); // Blocks the main thread until a character arrives
+    if (c != '\r' && c != '\n')
     {
-      blue_led = !blue_led;
-      printf("Toggle the blue LED on");
-      thread_sleep_for(2000); // Sleep thread for 2000ms
-
-      blue_led = !blue_led;
-      printf("Toggle the blue LED off");
-      thread_sleep_for(500); // Sleep thread for 500ms
+      if (length < (int)sizeof(line) - 1)
+      {
+        line[length++] = c;
+      }
+      continue;
+    }
+    line[length] = '\0';
+    if (length && strcmp(line, "memory") == 0)
+    {
+      print_memory();
     }
+    else if (length && strcmp(line, "cpu") == 0)
+    {
+      print_cpu();
+    }
+    length = 0;
   }
 }
 
@@ -54,10 +92,46 @@ void toggle_state()
 {
   if (toggle_flag == 1)
   {
-    // Increment state and take remainder to keep the state either 0 or 1
-    _state++;
-    _state %= 2;
+    blink_toggle(blue_led); // The controller applies it, only it touches the schedule
 
     toggle_flag = 0; // Set toggle flag back to 0 until next rising edge
   }
-}
\ No newline at end of file
+}
+
+void print_memory()
+{
+  static mbed_stats_stack_t stacks[MEMORY_THREADS_MAX];
+  size_t count = mbed_stats_stack_get_each(stacks, MEMORY_THREADS_MAX);
+  printf("thread         peak   size  sized\n");
+  for (size_t i = 0; i < count; i++)
+  {
+    const char *name = osThreadGetName((osThreadId_t)stacks[i].thread_id);
+    printf("%-12s %6lu %6lu %6lu\n", name ? name : "?", (unsigned long)stacks[i].max_size,
+           (unsigned long)stacks[i].reserved_size, (unsigned long)STACK_FROM_PEAK(stacks[i].max_size, 0));
+  }
+  printf("sized = peak + %d%% + %d bytes, set controller-stack-peak or log-stack-peak in mbed_app.json to use it\n",
+         MBED_CONF_APP_STACK_MARGIN, STACK_MARGIN_BYTES);
+
+  mbed_stats_heap_t heap;
+  mbed_stats_heap_get(&heap);
+  printf("heap %lu bytes now, %lu peak, %lu reserved, %lu failed allocations\n", (unsigned long)heap.current_size,
+         (unsigned long)heap.max_size, (unsigned long)heap.reserved_size, (unsigned long)heap.alloc_fail_cnt);
+}
+
+void print_cpu()
+{
+  static mbed_stats_cpu_t last; // Totals at the previous cpu command, zero at boot
+  mbed_stats_cpu_t now;
+  mbed_stats_cpu_get(&now); // Times in us since boot (platform.cpu-stats-enabled)
+  uint64_t uptime = now.uptime - last.uptime;
+  uint64_t idle = now.idle_time - last.idle_time;
+  uint64_t sleep = now.sleep_time - last.sleep_time + now.deep_sleep_time - last.deep_sleep_time;
+  last = now;
+  if (!uptime)
+  {
+    return;
+  }
+  printf("idle %lu.%lu%% of the last %lu ms, asleep %lu.%lu%%\n", (unsigned long)(idle * 100 / uptime),
+         (unsigned long)(idle * 1000 / uptime % 10), (unsigned long)(uptime / 1000),
+         (unsigned long)(sleep * 100 / uptime), (unsigned long)(sleep * 1000 / uptime % 10));
+}
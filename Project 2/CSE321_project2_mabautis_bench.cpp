@@ -0,0 +1,77 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: Microbenchmark runner. Times every entry of a benchmark table with the DWT cycle
+ *               counter and prints one CSV row per entry
+ *
+ * Modules:
+ *
+ * Subroutines:
+ * void bench_run(const char *project, const Benchmark *benchmarks, int count) - Times every benchmark and prints the results as CSV
+ * uint32_t time_call(const Benchmark *benchmark, int i) - Cycles taken by one call of a benchmark
+ * void nothing(int i) - Empty benchmark, measures the cost of timing a call
+ *
+ * Assignment: Project 2
+ * Inputs:
+ * Outputs:
+ *      USB serial (STDIO), "project,benchmark,iterations,min_cycles,avg_cycles,max_cycles,avg_us" then one row per benchmark
+ * Constraints:
+ *      Only built into the firmware when the bench option is set in mbed_app.json
+ *      Cycles exclude the setup call and the cost of reading the counter. Interrupts are left on, so
+ *      max_cycles includes any ISR that landed in a call; min_cycles is the figure to compare
+ *      One call must take less than 2^32 cycles (~35s at 120MHz)
+ * References:
+ *      ARMv7-M Architecture Reference Manual, DWT - https://developer.arm.com/documentation/ddi0403/latest
+ */
+#include "CSE321_project2_mabautis_bench.h"
+#include <mbed.h>
+
+#define OVERHEAD_SAMPLES 64 // Empty calls timed to find the cost of timing
+
+static uint32_t time_call(const Benchmark *benchmark, int i); // Cycles taken by one call of a benchmark
+static void nothing(int i); // Empty benchmark, measures the cost of timing a call
+
+static const Benchmark empty_benchmark = {"overhead", OVERHEAD_SAMPLES, nullptr, &nothing};
+
+void bench_run(const char *project, const Benchmark *benchmarks, int count) {
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk; // DWT is part of the trace block
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+  uint32_t overhead = UINT32_MAX;
+  for (int i = 0; i < OVERHEAD_SAMPLES; i++) {
+    uint32_t cycles = time_call(&empty_benchmark, i);
+    overhead = cycles < overhead ? cycles : overhead;
+  }
+
+  printf("project,benchmark,iterations,min_cycles,avg_cycles,max_cycles,avg_us\n");
+  for (int b = 0; b < count; b++) {
+    const Benchmark *benchmark = &benchmarks[b];
+    uint32_t min_cycles = UINT32_MAX;
+    uint32_t max_cycles = 0;
+    uint64_t total = 0;
+    for (int i = 0; i < benchmark->iterations; i++) {
+      if (benchmark->setup) {
+        benchmark->setup(i);
+      }
+      uint32_t cycles = time_call(benchmark, i);
+      cycles = cycles > overhead ? cycles - overhead : 0;
+      min_cycles = cycles < min_cycles ? cycles : min_cycles;
+      max_cycles = cycles > max_cycles ? cycles : max_cycles;
+      total += cycles;
+    }
+    uint32_t avg_cycles = benchmark->iterations ? total / benchmark->iterations : 0;
+    uint32_t avg_ns = (uint64_t)avg_cycles * 1000 / (SystemCoreClock / 1000000);
+    printf("%s,%s,%d,%lu,%lu,%lu,%lu.%03lu\n", project, benchmark->name, benchmark->iterations,
+           (unsigned long)(benchmark->iterations ? min_cycles : 0), (unsigned long)avg_cycles,
+           (unsigned long)max_cycles, (unsigned long)(avg_ns / 1000), (unsigned long)(avg_ns % 1000));
+  }
+}
+
+static uint32_t time_call(const Benchmark *benchmark, int i) {
+  uint32_t start = DWT->CYCCNT;
+  benchmark->run(i);
+  return DWT->CYCCNT - start; // Unsigned, correct across one counter wrap
+}
+
+static void nothing(int i) {}
@@ -6,21 +6,38 @@
  * Modules: 
  *      CSE321_project2_mabautis_stm_methods - Contains initialization code for the RCC and GPIO pins and code to write to MODER
  *      CSE321_project2_mabautis_lcd1602 - Contains intiialization and operation code for a 1602 LCD
+ *      CSE321_project2_mabautis_patterns - Non-blocking LED/buzzer pattern player driven by a single ticker
+ *      CSE321_project2_mabautis_state_machine - Transition table for the timer modes and keypad input
+ *      CSE321_project2_mabautis_persist - Keeps the timer state in the RTC backup registers so a running timer survives a reset
+ *      CSE321_project2_mabautis_bench - Times a benchmark table with the DWT cycle counter and prints CSV
+ *      CSE321_project2_mabautis_profile - DWT cycles, calls and worst case of every ISR, main loop pass and queued event
  *
  * Subroutines:
  *      void isr_col(void) - Rising edge Interrupt Service Routine for column pins [PF_14, PE_11, PE_9, PF_13]
  *      void isr_falling_edge(void) - Falling edge Interrupt Service Routine for column pins [PF_14, PE_11, PE_9, PF_13]
- *      void key_handler(void) - Determines if a key press is valid (debounced) and then calls validKey or powerOnTimer
- *      void validKey(char letter) - Handles input based on current mode
- *      void powerOnTimer(void) - Initalizes flags and LCD then calls validKey('D')
+ *      void select_row(int row) - Powers one keypad row and turns the others off, one write_to_pin per row pin
+ *      void key_handler(void) - Determines if a key press is valid (debounced) and then queues the key
+ *      void handle_key(char key) - Looks up the key in the transition table for the current mode and runs the transition
+ *      void handle_transition(int action, int next_mode, char key) - Runs the action of a table transition and enters the next mode
+ *      void enterDigit(char digit) - Adds a digit to the entered time if it is valid for the cursor position
+ *      void showInputPrompt(void) - Resets the entered time and prints the input prompt
  *      void timer_handler(void) - Ticker to count in 1s increments if mode = 2. Queues timer() to run blocking code
  *      void timer(void) - Handles checking remaining time, incrementing timer, and printing the associated output
- *      void blinkLED(void) - Handles turning on and off LED with a specified blinking interval
+ *      void printTime(const char *prompt, int seconds) - Prints a prompt and a time in M S format
+ *      void showPaused(void) - Prints the paused prompt with the held time
+ *      void save_timer_state(void) - Records the current mode, direction and absolute start time in the backup registers,
+ *      or clears them when no timer is running or paused
+ *      void restore_timer_state(void) - Resumes a running or paused timer from the backup registers after a reset
+ *      void blinkLED(void) - Starts the valid key press blink pattern without blocking
+ *      void timer_done_display_off(void) - Turns the display off once the timer done pattern has finished
+ *      void isr_serial(void) - Serial RX Interrupt Service Routine, collects a command line and queues "top"
+ *      void bench_*(int i) - Benchmark build only, the timed calls and setups of the benchmark table
  *
  * Assignment: Project 2
  *
  * Inputs: 
  *      4x4 Matrix Keypad - Rows: [PA_3, PC_0, PC_3, PC_1] Columns: [PF_14, PE_11, PE_9, PF_13]
+ *      USB serial - "top" prints the CPU time of every profiled ISR, main loop pass and event
  *
  * Outputs: 
  *      1602 LCD - SDA: PB_9 SCL: PB_8
@@ -37,23 +54,50 @@
 #include <CSE321_project2_mabautis_lcd1602.h>
 #include <mbed.h>
 #include <CSE321_project2_mabautis_stm_methods.h>
+#include <CSE321_project2_mabautis_patterns.h>
+#include <CSE321_project2_mabautis_state_machine.h>
+#include <CSE321_project2_mabautis_persist.h>
+#include <CSE321_project2_mabautis_bench.h>
+#include <CSE321_project2_mabautis_profile.h>
 #include <string>
 
 #define ASCII_ZERO 48
 #define ASCII_FIVE 53
-#define ASCII_NINE 57
 
 void isr_col(void); //Rising edge Interrupt Service Routine for column pins [PF_14, PE_11, PE_9, PF_13]
 void isr_falling_edge(void); // Falling edge Interrupt Service Routine for column pins [PF_14, PE_11, PE_9, PF_13]
+void select_row(int row); // Powers one keypad row and turns the others off, one write_to_pin per row pin
 
-void key_handler(void); // Determines if a key press is valid (debounced) and then calls validKey or powerOnTimer
-void validKey(char letter); // Handles input based on current mode
-void powerOnTimer(void); // Initalizes flags and LCD then calls validKey('D')
+void key_handler(void); // Determines if a key press is valid (debounced) and then queues the key
+void handle_key(char key); // Looks up the key in the transition table for the current mode and runs the transition
+void handle_transition(int action, int next_mode, char key); // Runs the action of a table transition and enters the next mode
+void enterDigit(char digit); // Adds a digit to the entered time if it is valid for the cursor position
+void showInputPrompt(void); // Resets the entered time and prints the input prompt
 
 void timer_handler(void); // Ticker to count in 1s increments if mode = 2. Queues timer() to run blocking code
 void timer(void); // Handles checking remaining time, incrementing timer, and printing the associated output
+void printTime(const char *prompt, int seconds); // Prints a prompt and a time in M S format
+void showPaused(void); // Prints the paused prompt with the held time
 
-void blinkLED(void); // Handles turning on and off LED with a specified blinking interval
+void save_timer_state(void); // Records the running or paused timer in the backup registers, clears them otherwise
+void restore_timer_state(void); // Resumes a running or paused timer from the backup registers after a reset
+
+void blinkLED(void); // Starts the valid key press blink pattern without blocking
+void timer_done_display_off(void); // Turns the display off once the timer done pattern has finished
+
+void isr_serial(void); // Serial RX Interrupt Service Routine, collects a command line and queues "top"
+
+#if MBED_CONF_APP_BENCH
+void bench_lcd_print(int i); // Prints a full 16 character line
+void bench_lcd_clear(int i);
+void bench_lcd_set_cursor(int i); // Moves the cursor across both rows
+void bench_home_cursor(int i); // Setup, every print starts at the left of row 0
+void bench_keypad_scan(int i); // Powers each row in turn and reads the four columns
+void bench_rows_write_to_pin(int i); // One row change the way the main loop does it
+void bench_rows_bsrr(int i); // Same row change as one BSRR write per port
+void bench_timer_running(int i); // Setup, counting down from 10 minutes
+void bench_timer(int i); // One timer() tick
+#endif
 
 EventQueue queue; // Initialize EventQueue to queue blocking code from ISR
 
@@ -63,6 +107,10 @@ Ticker timer_ticker;
 
 CSE321_LCD LCD(16, 2, LCD_5x8DOTS, PB_9, PB_8); // Initialize LCD
 
+UnbufferedSerial serial_port(USBTX, USBRX); // Command input, output still goes through printf
+char serial_line[16]; // Command being typed
+int serial_length = 0;
+
 // Initialize interrupts for columns of keypad. Set pull down to pull port down to 0 volts
 InterruptIn col_0(PF_14, PullDown);
 InterruptIn col_1(PE_11, PullDown);
@@ -74,7 +122,7 @@ char keypad[4][4] = {{'1', '2', '3', 'A'},
                      {'7', '8', '9', 'C'},
                      {'*', '0', '#', 'D'}}; // Enumerate keypad matrix
 
-int mode = 0; // 0 -> Off, 1 -> Input, 2 -> Timer
+int mode = MODE_OFF; // 0 -> Off, 1 -> Input, 2 -> Timer, 3 -> Paused
 
 int row = 0; // Current keypad row to power
 
@@ -90,7 +138,58 @@ int count_direction = 0; //  0 -> Down, 1 -> Up,
 int time_remaining = 0;  // In seconds (count_direction = 0)
 int time_passed = 0; // In Seconds (count_direction = 1)
 
+// Output patterns played by the pattern engine
+const Pattern key_blink = {250, 0, 1, 0}; // Valid key press -> LED on for .25 seconds
+const Pattern timer_done_blink = {200, 200, 4, 1}; // Timer done -> blink LED 4 times [1600ms]
+#define TIMER_DONE_DISPLAY_MS 3600 // Display stays on for the done pattern plus 2 seconds
+
+int key_led = -1; // Pattern channel for the valid key press LED (PA_5)
+int done_led = -1; // Pattern channel for the timer done LEDs (PA_6)
+
+// Handlers in this file with a profiler slot
+enum ProfiledHandler {
+  PROFILE_ISR_COL = 0,
+  PROFILE_ISR_FALLING_EDGE,
+  PROFILE_KEY_HANDLER,
+  PROFILE_TIMER_HANDLER,
+  PROFILE_ISR_SERIAL,
+  PROFILE_ROW_SCAN,
+  PROFILE_HANDLE_TRANSITION,
+  PROFILE_TIMER,
+  PROFILE_DISPLAY_OFF,
+  PROFILED_HANDLERS
+};
+const char *const profiled_names[PROFILED_HANDLERS] = {"isr_col", "isr_falling_edge", "key_handler", "timer_handler",
+                                                       "isr_serial", "row", "handle_transition", "timer",
+                                                       "display_off"};
+const int profiled_kinds[PROFILED_HANDLERS] = {PROFILE_ISR, PROFILE_ISR, PROFILE_ISR, PROFILE_ISR, PROFILE_ISR,
+                                               PROFILE_THREAD, PROFILE_EVENT, PROFILE_EVENT, PROFILE_EVENT};
+int profile_slots[PROFILED_HANDLERS]; // Slot of each handler in the profiler table
+
+#if MBED_CONF_APP_BENCH
+// Hot paths timed by the benchmark build (mbed_app.json "bench"), printed as CSV
+const Benchmark benchmarks[] = {
+    {"lcd_print_16", 100, &bench_home_cursor, &bench_lcd_print},
+    {"lcd_clear", 20, nullptr, &bench_lcd_clear},
+    {"lcd_set_cursor", 100, nullptr, &bench_lcd_set_cursor},
+    {"keypad_scan", 1000, nullptr, &bench_keypad_scan},
+    {"rows_write_to_pin", 1000, nullptr, &bench_rows_write_to_pin},
+    {"rows_bsrr", 1000, nullptr, &bench_rows_bsrr},
+    {"timer_tick", 20, &bench_timer_running, &bench_timer},
+};
+
+// One BSRR value per port for each row: set the row's pin, reset the other row pins (PA_3, PC_0, PC_3, PC_1)
+const uint32_t row_bsrr_a[4] = {1u << 3, 1u << (3 + 16), 1u << (3 + 16), 1u << (3 + 16)};
+const uint32_t row_bsrr_c[4] = {(1u << 0 | 1u << 3 | 1u << 1) << 16, 1u << 0 | (1u << 3 | 1u << 1) << 16,
+                                1u << 3 | (1u << 0 | 1u << 1) << 16, 1u << 1 | (1u << 0 | 1u << 3) << 16};
+#endif
+
 int main() {
+  profile_start(); // Cycle counter on before any profiled code runs
+  for (int i = 0; i < PROFILED_HANDLERS; i++) {
+    profile_slots[i] = profile_slot(profiled_names[i], profiled_kinds[i]);
+  }
+
   // Enable clock control register for GPIO A & C
   enable_rcc('a');
   enable_rcc('c');
@@ -100,6 +199,9 @@ int main() {
   // Declare GPIOA pin 6 as an output
   set_pin_mode(6, GPIOA, 1);
 
+  key_led = pattern_add_channel(GPIOA, 5); // Drive PA_5 from the pattern engine
+  done_led = pattern_add_channel(GPIOA, 6); // Drive PA_6 from the pattern engine
+
   // Declare GPIOA pin 3 as an output
   set_pin_mode(3, GPIOA, 1);
   // Declare GPIOC pin 0 as an output
@@ -109,8 +211,18 @@ int main() {
   // Declare GPIOC pin 1 as an output
   set_pin_mode(1, GPIOC, 1);
 
+  restore_timer_state(); // Pick up a timer that was running before a reset, no user re-entry needed
+
   LCD.begin(); // Initialize LCD
-  LCD.noBacklight(); // Turn backlight off, starting in mode 0
+#if MBED_CONF_APP_BENCH
+  bench_run("project2", benchmarks, sizeof(benchmarks) / sizeof(benchmarks[0]));
+  return 0; // Benchmark build, the keypad and timer are not started
+#endif
+  if (mode == MODE_PAUSED) {
+    showPaused(); // Restored paused timer, show the held time
+  } else if (mode != MODE_TIMER) {
+    LCD.noBacklight(); // Turn backlight off, starting in mode 0
+  }
 
 // Declare interrupts for rising edge of each column of keypad
   col_0.rise(&isr_col);
@@ -126,80 +238,76 @@ int main() {
 
   debounce_ticker.attach(&key_handler, 1ms); // Start ticker to handle debouncing keys
   timer_ticker.attach(&timer_handler, 1s); // Start ticker to increment timer every second
+  serial_port.attach(&isr_serial); // "top" over the USB serial
 
   while (1) {
     if (!key_pressed) {
+      uint32_t start = profile_begin();
       row++; // Increment row
       row %= 4; // Keep row between 0 and 3
-      switch (row) {
-      case 0: // Turn off other rows, turn on row 0
-        write_to_pin(0, GPIOC, 0);
-        write_to_pin(3, GPIOC, 0);
-        write_to_pin(1, GPIOC, 0);
-        write_to_pin(3, GPIOA, 1);
-        break;
-      case 1: // Turn off other rows, turn on row 1
-        write_to_pin(3, GPIOA, 0);
-        write_to_pin(3, GPIOC, 0);
-        write_to_pin(1, GPIOC, 0);
-        write_to_pin(0, GPIOC, 1);
-        break;
-      case 2: // Turn off other rows, turn on row 2
-        write_to_pin(3, GPIOA, 0);
-        write_to_pin(0, GPIOC, 0);
-        write_to_pin(1, GPIOC, 0);
-        write_to_pin(3, GPIOC, 1);
-        break;
-      case 3: // Turn off other rows, turn on row 3
-        write_to_pin(3, GPIOA, 0);
-        write_to_pin(0, GPIOC, 0);
-        write_to_pin(3, GPIOC, 0);
-        write_to_pin(1, GPIOC, 1);
-        break;
-      }
+      select_row(row);
+      profile_end(profile_slots[PROFILE_ROW_SCAN], start);
     }
-   queue.dispatch_once(); // Dispatch waiting events [valid_key, timer, powerOnTimer]
+   queue.dispatch_once(); // Dispatch waiting events [handle_transition, timer, timer_done_display_off]
+  }
+}
+
+void select_row(int row) {
+  switch (row) {
+  case 0: // Turn off other rows, turn on row 0
+    write_to_pin(0, GPIOC, 0);
+    write_to_pin(3, GPIOC, 0);
+    write_to_pin(1, GPIOC, 0);
+    write_to_pin(3, GPIOA, 1);
+    break;
+  case 1: // Turn off other rows, turn on row 1
+    write_to_pin(3, GPIOA, 0);
+    write_to_pin(3, GPIOC, 0);
+    write_to_pin(1, GPIOC, 0);
+    write_to_pin(0, GPIOC, 1);
+    break;
+  case 2: // Turn off other rows, turn on row 2
+    write_to_pin(3, GPIOA, 0);
+    write_to_pin(0, GPIOC, 0);
+    write_to_pin(1, GPIOC, 0);
+    write_to_pin(3, GPIOC, 1);
+    break;
+  case 3: // Turn off other rows, turn on row 3
+    write_to_pin(3, GPIOA, 0);
+    write_to_pin(0, GPIOC, 0);
+    write_to_pin(3, GPIOC, 0);
+    write_to_pin(1, GPIOC, 1);
+    break;
   }
 }
 
-void isr_col(void) { key_pressed = 1; } // Set flag to handle in debounce ticker
+void isr_col(void) {
+  uint32_t start = profile_begin();
+  key_pressed = 1; // Set flag to handle in debounce ticker
+  profile_end(profile_slots[PROFILE_ISR_COL], start);
+}
 
 void isr_falling_edge(void) {
+  uint32_t start = profile_begin();
   // Set flags to 0
   key_pressed = 0;
   debounce_buffer = 0;
   debounced = 0;
+  profile_end(profile_slots[PROFILE_ISR_FALLING_EDGE], start);
 }
 
 void key_handler(void) {
+  uint32_t start = profile_begin();
   if (key_pressed) {
     if (!debounce_buffer) {
       debounce_buffer = 1; // Set flag
     } else {
       if (!debounced) {
-        switch (mode) {
-        case 0: // Check for power on button in Off Mode
-          if (col_3.read() && keypad[row][3] == 'D') {
-            queue.call(&powerOnTimer); // Power on Timer
-          }
-          break;
-        case 1: // Check for number or valid mode letter in Input Mode
-          if (col_0.read() && keypad[row][0] != '*') {
-            queue.call(&validKey, keypad[row][0]);
-          } else if (col_1.read()) {
-            queue.call(&validKey, keypad[row][1]);
-          } else if (col_2.read() && keypad[row][2] != '#') {
-            queue.call(&validKey, keypad[row][2]);
-          } else if (col_3.read() && keypad[row][3] != 'D' &&
-                     keypad[row][3] != 'C') {
-            queue.call(&validKey, keypad[row][3]);
-          }
-          break;
-        case 2: // Check for valid mode letter in Timer Mode
-          if (col_3.read() && keypad[row][3] != 'A') {
-            queue.call(&validKey, keypad[row][3]);
-          }
-          break;
+        // Read the columns once to find the pressed key. The table lookup waits for the queue, so a timer event
+        // queued ahead of the key (expiry) has already changed the mode it is looked up in
+        int col = col_0.read() ? 0 : col_1.read() ? 1 : col_2.read() ? 2 : col_3.read() ? 3 : -1;
+        if (col >= 0) {
+          queue.call(&handle_key, keypad[row][col]); // Run blocking LCD code outside the ISR
         }
       }
       // Set flags
@@ -208,119 +316,239 @@ void key_handler(void) {
     }
   } else
     debounce_buffer = 0; 
+  profile_end(profile_slots[PROFILE_KEY_HANDLER], start);
 }
 
 void timer_handler(void) {
-  if (mode == 2) {
+  uint32_t start = profile_begin();
+  if (mode == MODE_TIMER) {
     queue.call(timer); // Call timer handler if in Timer Mode
   }
+  profile_end(profile_slots[PROFILE_TIMER_HANDLER], start);
 }
 
 void timer(void) {
-  if (mode == 2) {
-    LCD.clear(); // Clear Screen 
+  uint32_t start = profile_begin();
+  if (mode == MODE_TIMER) {
     if (!time_remaining) { // Check if timer is over
-      mode = 0; // Set mode to Off
-      count_direction ? LCD.print("Times Up") : LCD.print("Time Reached"); // Print prompt based on counting direction
-      for (int i = 0; i < 4; i++) { // Blink LED 4 times [1600ms]
-        write_to_pin(6, GPIOA, 1);
-        thread_sleep_for(200);
-        write_to_pin(6, GPIOA, 0);
-        thread_sleep_for(200);
-      }
-      thread_sleep_for(2000); // 2 second delay and then turn off display
-      LCD.clear();
-      LCD.noBacklight();
-    } else {
-      count_direction ? LCD.print("Time Passed: ")
-                      : LCD.print("Time Remaining: "); // Print prompt based on counting direction
-      LCD.setCursor(0, 1); // Set cursor to second row
-
-      string time = count_direction ? to_string(time_passed / 60) + "M " +
-                                          to_string(time_passed % 60) + "S"
-                                    : to_string(time_remaining / 60) + "M " +
-                                          to_string(time_remaining % 60) + "S"; // Print time based on counting direction
-
-      LCD.print(&time[0]); // Pass in pointer to beginning of string to print
+      Transition transition = next_transition(mode, EVENT_EXPIRED);
+      handle_transition(transition.action, transition.next, 0);
+      profile_end(profile_slots[PROFILE_TIMER], start);
+      return;
     }
+    count_direction ? printTime("Time Passed: ", time_passed)
+                    : printTime("Time Remaining: ", time_remaining); // Print prompt based on counting direction
     time_remaining--; // Decrement time remaining
     time_passed++; // Incremement time passed
   }
+  profile_end(profile_slots[PROFILE_TIMER], start);
 }
 
-void powerOnTimer(void) {
-  mode = 1; // Set mode to Input
-  LCD.backlight(); // Turn on LCD backlight
-  validKey('D'); // Handle mode change
+void printTime(const char *prompt, int seconds) {
+  string time = to_string(seconds / 60) + "M " + to_string(seconds % 60) + "S";
+
+  LCD.clear(); // Clear Screen
+  LCD.print(prompt); // Print prompt
+  LCD.setCursor(0, 1); // Set cursor to second row
+  LCD.print(&time[0]); // Pass in pointer to beginning of string to print
 }
 
 void blinkLED(void) {
-  write_to_pin(5, GPIOA, 1); // Turn LED on
-  thread_sleep_for(250); // Wait .25 seconds
-  write_to_pin(5, GPIOA, 0); // Turn LED off
+  play_pattern(key_led, &key_blink); // LED on for .25 seconds, returns immediately
+}
+
+void timer_done_display_off(void) {
+  uint32_t start = profile_begin();
+  if (mode == MODE_OFF) { // Leave the display alone if the timer was powered back on
+    LCD.clear();
+    LCD.noBacklight();
+  }
+  profile_end(profile_slots[PROFILE_DISPLAY_OFF], start);
+}
+
+void handle_key(char key) {
+  Transition transition = next_transition(mode, classify_key(key));
+  if (transition.action != ACTION_NONE) {
+    handle_transition(transition.action, transition.next, key);
+  }
 }
 
-void validKey(char letter) {
-  switch (letter) { //Handle valid mode change
-  case 'A':
-      mode = 2; // Enter Timer Mode
-      cursor = 0; // Reset cursor flag
-      blinkLED(); // Valid key press -> blink LED
+void handle_transition(int action, int next_mode, char key) {
+  uint32_t start = profile_begin();
+  mode = next_mode; // Enter the mode given by the transition table
+  switch (action) {
+  case ACTION_POWER_ON:
+    LCD.backlight(); // Turn on LCD backlight
+    showInputPrompt();
+    blinkLED(); // Valid key press -> blink LED
+    break;
+
+  case ACTION_ENTER_DIGIT:
+    enterDigit(key);
+    break;
+
+  case ACTION_START:
+  case ACTION_RESUME:
+    cursor = 0; // Reset cursor flag
+    blinkLED(); // Valid key press -> blink LED
     break;
 
-  case 'B':
-    mode = 0; // Turn off Timer
+  case ACTION_PAUSE:
+    showPaused(); // Show the held time
+    blinkLED(); // Valid key press -> blink LED
+    break;
+
+  case ACTION_TURN_OFF:
     // Reset flags
     cursor = 0;
     time_remaining = 0;
     time_passed = 0;
-    
+
     LCD.clear(); // Clear LCD
     LCD.noBacklight(); // Turn off LCD
     break;
 
-  case 'C':
+  case ACTION_TOGGLE_DIRECTION:
     count_direction = !count_direction; // Toggle direction flag
     blinkLED(); // Valid key press -> blink LED
     break;
 
-  case 'D':
-    mode = 1;
-    // Reset flags
-    time_remaining = 0;
-    time_passed = 0;
-    
-    LCD.clear(); // Clear LCD
-    LCD.print("Enter Time:"); // Print prompt
-    LCD.setCursor(0, 1); // Set cursor to second row
-    LCD.print("0:00"); // Print timer prompt
-
+  case ACTION_RESET_INPUT:
+    showInputPrompt();
     blinkLED(); // Valid key press -> blink LED
     break;
+
+  case ACTION_EXPIRE:
+    LCD.clear(); // Clear Screen
+    count_direction ? LCD.print("Times Up") : LCD.print("Time Reached"); // Print prompt based on counting direction
+    play_pattern(done_led, &timer_done_blink); // Blink LED 4 times [1600ms]
+    queue.call_in(std::chrono::milliseconds(TIMER_DONE_DISPLAY_MS), &timer_done_display_off); // 2 second delay after blinking and then turn off display
+    break;
+  }
+  save_timer_state(); // Every transition is recorded so a reset can resume from it
+  profile_end(profile_slots[PROFILE_HANDLE_TRANSITION], start);
+}
+
+void showPaused(void) {
+  count_direction ? printTime("Paused: ", time_passed)
+                  : printTime("Paused: ", time_remaining);
+}
+
+void save_timer_state(void) {
+  if (mode != MODE_TIMER && mode != MODE_PAUSED) {
+    persist_clear(); // Off, input or expired: a reset must not bring back the last timer
+    return;
+  }
+  TimerRecord record;
+  record.mode = mode;
+  record.count_direction = count_direction;
+  record.duration = time_remaining + time_passed; // Sum stays equal to the entered time while counting
+  record.elapsed = time_passed;
+  record.start_time = (uint32_t)time(NULL) - time_passed; // Absolute start, so the time spent in reset is counted
+  persist_save(&record);
+}
+
+void restore_timer_state(void) {
+  TimerRecord record;
+  if (!persist_restore(&record) ||
+      (record.mode != MODE_TIMER && record.mode != MODE_PAUSED)) {
+    return; // Nothing to resume, start in Off Mode
+  }
+  if ((uint32_t)time(NULL) < record.start_time) {
+    persist_clear(); // RTC went back (reset or set) since the record was written, its times are stale
+    return;
+  }
+  uint32_t elapsed = record.mode == MODE_TIMER
+                         ? (uint32_t)time(NULL) - record.start_time // Still counting while the board was reset
+                         : record.elapsed; // Paused, time was held
+  if (elapsed > record.duration) {
+    elapsed = record.duration; // Ran out during the reset, next tick reports it
+  }
+  count_direction = record.count_direction;
+  time_passed = elapsed;
+  time_remaining = record.duration - elapsed;
+  mode = record.mode;
+}
+
+void showInputPrompt(void) {
+  // Reset flags
+  cursor = 0;
+  time_remaining = 0;
+  time_passed = 0;
+
+  LCD.clear(); // Clear LCD
+  LCD.print("Enter Time:"); // Print prompt
+  LCD.setCursor(0, 1); // Set cursor to second row
+  LCD.print("0:00"); // Print timer prompt
+}
+
+void enterDigit(char digit) {
+  int valid = 0; // Set flag to determine if number is valid
+  if (cursor == 0) { // Any number valid in minutes spot
+    time_remaining += (digit - ASCII_ZERO) * 60; // Subtract number by ASCII ZERO to convert to integer then convert to seconds
+    valid = 1; // Set flag
+  } else if (cursor == 1 && digit <= ASCII_FIVE) { // Only 0-5 allowed in 1st seconds spot
+    time_remaining += (digit - ASCII_ZERO) * 10; // Subtract number by ASCII ZERO to convert to integer and multiply by 10 to represent 10s place
+    valid = 1; //Set flag
+  } else if (cursor == 2) { // Any number valid in 2nd seconds spot
+    time_remaining += digit - ASCII_ZERO; // Subtract number by ASCII ZERO to convert to integer
+    valid = 1; // Set flag
+  }
+  if (valid) { // Check if valid number entered before handling
+    cursor++; // Increment timer cursor
+    printTime("Enter Time:", time_remaining);
+    blinkLED(); // Valid key press -> blink LED
   }
+}
 
-  if (letter >= ASCII_ZERO && letter <= ASCII_NINE) {
-    int valid = 0; // Set flag to determine if number is valid
-    if (cursor == 0) { // Any number valid in minutes spot
-      time_remaining += (letter - ASCII_ZERO) * 60; // Subtract number by ASCII ZERO to convert to integer then convert to seconds
-      valid = 1; // Set flag
-    } else if (cursor == 1 && letter <= ASCII_FIVE) { // Only 0-5 allowed in 1st seconds spot
-      time_remaining += (letter - ASCII_ZERO) * 10; // Subtract number by ASCII ZERO to convert to integer and multiply by 10 to represent 10s place
-      valid = 1; //Set flag
-    } else if (cursor == 2) { // Any number valid in 2nd seconds spot
-      time_remaining += letter - ASCII_ZERO; // Subtract number by ASCII ZERO to convert to integer 
-      valid = 1; // Set flag
+void isr_serial(void) {
+  uint32_t start = profile_begin();
+  char c;
+  while (serial_port.readable() && serial_port.read(&c, 1) == 1) {
+    if (c == '\r' || c == '\n') { // End of the command
+      serial_line[serial_length] = 0;
+      if (strcmp(serial_line, "top") == 0) {
+        queue.call(&profile_print); // Printing blocks, run it from the main loop
+      }
+      serial_length = 0;
+    } else if (serial_length < (int)sizeof(serial_line) - 1) {
+      serial_line[serial_length++] = c;
     }
-    if (valid) { // Check if valid number entered before handling
-      cursor++; // Increment timer cursor
-      string time = to_string(time_remaining / 60) + "M " +
-                    to_string(time_remaining % 60) + "S"; // Print time based on counting direction
-
-      LCD.clear(); // Clear LCD
-      LCD.print("Enter Time:"); // Print prompt
-      LCD.setCursor(0, 1); // Set cursor to second row
-      LCD.print(&time[0]); // Pass in pointer to beginning of string to print
-      blinkLED(); // Valid key press -> blink LED
+  }
+  profile_end(profile_slots[PROFILE_ISR_SERIAL], start);
+}
+
+#if MBED_CONF_APP_BENCH
+void bench_lcd_print(int i) { LCD.print("0123456789ABCDEF"); }
+
+void bench_lcd_clear(int i) { LCD.clear(); }
+
+void bench_lcd_set_cursor(int i) { LCD.setCursor(i % 16, i / 16 % 2); }
+
+void bench_home_cursor(int i) { LCD.setCursor(0, 0); }
+
+void bench_keypad_scan(int i) {
+  for (int scan_row = 0; scan_row < 4; scan_row++) {
+    select_row(scan_row);
+    if (col_0.read() | col_1.read() | col_2.read() | col_3.read()) {
+      break; // A key is held, the real scan stops on its row
     }
   }
 }
+
+void bench_rows_write_to_pin(int i) { select_row(i % 4); }
+
+void bench_rows_bsrr(int i) {
+  GPIOA->BSRR = row_bsrr_a[i % 4];
+  GPIOC->BSRR = row_bsrr_c[i % 4];
+}
+
+void bench_timer_running(int i) {
+  mode = MODE_TIMER;
+  count_direction = 0;
+  time_remaining = 600;
+  time_passed = 0;
+}
+
+void bench_timer(int i) { timer(); }
+#endif
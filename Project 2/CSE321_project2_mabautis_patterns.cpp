@@ -0,0 +1,137 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: Non-blocking LED/buzzer pattern player driven by a single ticker
+ *
+ * Modules:
+ *      CSE321_project2_mabautis_stm_methods - Used to write the pattern outputs to the GPIO pins
+ *      CSE321_project2_mabautis_profile - CPU time of the pattern ticker
+ *
+ * Subroutines:
+ * int pattern_add_channel(GPIO_TypeDef *port, unsigned int pin) - Registers an output pin and returns its channel number
+ * int play_pattern(int channel, const Pattern *pattern) - Starts a pattern on a channel without blocking
+ * void stop_pattern(int channel) - Stops the pattern on a channel and turns the output off
+ * int pattern_active(int channel) - Returns 1 if a pattern is still playing on the channel
+ * void pattern_tick(void) - Ticker ISR that advances every playing channel by one tick
+ *
+ * Assignment: Project 2
+ * Inputs:
+ * Outputs:
+ *      Any GPIO output pin registered as a channel (LEDs, active buzzer)
+ * Constraints:
+ *      Pattern timing resolution is PATTERN_TICK_MS. Durations are rounded up to the next tick
+ * References:
+ *      MBED Ticker - https://os.mbed.com/docs/mbed-os/v6.15/apis/ticker.html
+ */
+#include "CSE321_project2_mabautis_patterns.h"
+#include "CSE321_project2_mabautis_stm_methods.h"
+#include "CSE321_project2_mabautis_profile.h"
+
+struct PatternChannel {
+  GPIO_TypeDef *port;       // Output port
+  unsigned int pin;         // Output pin
+  const Pattern *pattern;   // Pattern currently playing (nullptr -> idle)
+  unsigned int ticks_left;  // Ticks left in the current on/off phase
+  unsigned int cycles_left; // On/off cycles left (ignored for PATTERN_FOREVER)
+  int output_on;            // Current phase, 1 -> on, 0 -> off
+};
+
+static void pattern_tick(void); // Ticker ISR that advances every playing channel by one tick
+
+static PatternChannel channels[PATTERN_CHANNELS]; // Registered outputs
+static int channel_count = 0; // Number of registered outputs
+static int ticker_running = 0; // Ticker is only attached while a pattern is playing
+
+static Ticker pattern_ticker; // Single ticker shared by every channel
+static int tick_slot = -1; // Profiler slot of pattern_tick
+
+static unsigned int ms_to_ticks(unsigned int ms) {
+  unsigned int ticks = (ms + PATTERN_TICK_MS - 1) / PATTERN_TICK_MS; // Round up to the next tick
+  return ticks ? ticks : 1;
+}
+
+int pattern_add_channel(GPIO_TypeDef *port, unsigned int pin) {
+  if (channel_count == PATTERN_CHANNELS) {
+    return -1; // No free channels
+  }
+  if (!channel_count) {
+    tick_slot = profile_slot("pattern_tick", PROFILE_ISR);
+  }
+  channels[channel_count].port = port;
+  channels[channel_count].pin = pin;
+  channels[channel_count].pattern = nullptr;
+  write_to_pin(pin, port, 0); // Start with output off
+  return channel_count++;
+}
+
+int play_pattern(int channel, const Pattern *pattern) {
+  if (channel < 0 || channel >= channel_count) {
+    return 0;
+  }
+  int started = 0;
+  core_util_critical_section_enter(); // Channel state is shared with the ticker ISR
+  PatternChannel &ch = channels[channel];
+  if (!ch.pattern || pattern->priority >= ch.pattern->priority) { // Keep higher priority patterns playing
+    ch.pattern = pattern;
+    ch.cycles_left = pattern->repeat;
+    ch.ticks_left = ms_to_ticks(pattern->on_ms);
+    ch.output_on = 1;
+    write_to_pin(ch.pin, ch.port, 1);
+    if (!ticker_running) {
+      ticker_running = 1;
+      pattern_ticker.attach(&pattern_tick, std::chrono::milliseconds(PATTERN_TICK_MS));
+    }
+    started = 1;
+  }
+  core_util_critical_section_exit();
+  return started;
+}
+
+void stop_pattern(int channel) {
+  if (channel < 0 || channel >= channel_count) {
+    return;
+  }
+  core_util_critical_section_enter();
+  channels[channel].pattern = nullptr;
+  write_to_pin(channels[channel].pin, channels[channel].port, 0); // Leave output off
+  core_util_critical_section_exit();
+}
+
+int pattern_active(int channel) {
+  if (channel < 0 || channel >= channel_count) {
+    return 0;
+  }
+  return channels[channel].pattern != nullptr;
+}
+
+static void pattern_tick(void) {
+  uint32_t start = profile_begin();
+  int playing = 0; // Number of channels still playing after this tick
+  for (int i = 0; i < channel_count; i++) {
+    PatternChannel &ch = channels[i];
+    if (!ch.pattern) {
+      continue;
+    }
+    if (--ch.ticks_left == 0) {
+      if (ch.output_on && ch.pattern->off_ms) { // End of on phase -> off phase
+        ch.output_on = 0;
+        ch.ticks_left = ms_to_ticks(ch.pattern->off_ms);
+      } else if (ch.pattern->repeat != PATTERN_FOREVER && --ch.cycles_left == 0) { // Last cycle finished
+        ch.pattern = nullptr;
+        ch.output_on = 0;
+      } else { // Start the next cycle
+        ch.output_on = 1;
+        ch.ticks_left = ms_to_ticks(ch.pattern->on_ms);
+      }
+      write_to_pin(ch.pin, ch.port, ch.output_on);
+    }
+    if (ch.pattern) {
+      playing++;
+    }
+  }
+  if (!playing) { // Nothing left to drive, stop ticking until the next play_pattern
+    ticker_running = 0;
+    pattern_ticker.detach();
+  }
+  profile_end(tick_slot, start);
+}
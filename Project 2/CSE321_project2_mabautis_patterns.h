@@ -0,0 +1,45 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: Non-blocking LED/buzzer pattern player driven by a single ticker
+ *
+ * Modules:
+ *      CSE321_project2_mabautis_stm_methods - Used to write the pattern outputs to the GPIO pins
+ *
+ * Subroutines:
+ * int pattern_add_channel(GPIO_TypeDef *port, unsigned int pin) - Registers an output pin and returns its channel number
+ * int play_pattern(int channel, const Pattern *pattern) - Starts a pattern on a channel without blocking
+ * void stop_pattern(int channel) - Stops the pattern on a channel and turns the output off
+ * int pattern_active(int channel) - Returns 1 if a pattern is still playing on the channel
+ *
+ * Assignment: Project 2
+ * Inputs:
+ * Outputs:
+ *      Any GPIO output pin registered as a channel (LEDs, active buzzer)
+ * Constraints:
+ *      Pattern timing resolution is PATTERN_TICK_MS. Durations are rounded up to the next tick
+ * References:
+ *      MBED Ticker - https://os.mbed.com/docs/mbed-os/v6.15/apis/ticker.html
+ */
+#ifndef CSE321_PROJECT2_MABAUTIS_PATTERNS_H
+#define CSE321_PROJECT2_MABAUTIS_PATTERNS_H
+
+#include <mbed.h>
+
+#define PATTERN_CHANNELS 4 // Maximum number of outputs driven by the pattern player
+#define PATTERN_TICK_MS 10 // Resolution of the pattern ticker
+#define PATTERN_FOREVER 0  // Repeat count for patterns that play until stopped
+
+struct Pattern {
+  unsigned int on_ms;    // Time output is high each repeat
+  unsigned int off_ms;   // Time output is low each repeat (0 -> steady on)
+  unsigned int repeat;   // Number of on/off cycles (PATTERN_FOREVER -> until stopped)
+  unsigned int priority; // A pattern only replaces a playing pattern of equal or lower priority
+};
+
+int pattern_add_channel(GPIO_TypeDef *port, unsigned int pin); // Registers an output pin and returns its channel number
+int play_pattern(int channel, const Pattern *pattern); // Starts a pattern on a channel without blocking
+void stop_pattern(int channel); // Stops the pattern on a channel and turns the output off
+int pattern_active(int channel); // Returns 1 if a pattern is still playing on the channel
+
+#endif
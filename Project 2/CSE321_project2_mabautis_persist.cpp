@@ -0,0 +1,118 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: Keeps the timer state in the RTC backup registers so a running timer survives a reset
+ *
+ * Modules:
+ *
+ * Subroutines:
+ * void persist_save(const TimerRecord *record) - Writes the record into the older of the two backup register slots
+ * int persist_restore(TimerRecord *record) - Reads the newest valid record, returns 0 if there is none
+ * void persist_clear(void) - Invalidates both slots
+ *
+ * Assignment: Project 2
+ * Inputs:
+ * Outputs:
+ * Constraints:
+ *      Backup registers keep their value through a system reset but not through a power loss
+ *      Times are RTC seconds (time(NULL)), so the RTC has to keep running through the reset
+ * References:
+ *      STM32L4 Reference Manual, RTC backup registers and backup domain access -
+ * https://www.st.com/resource/en/reference_manual/rm0432-stm32l4-series-advanced-armbased-32bit-mcus-stmicroelectronics.pdf
+ */
+#include "CSE321_project2_mabautis_persist.h"
+
+// Each slot is [magic | sequence, mode | direction, duration, start_time, elapsed, checksum].
+// Records are written to the older slot so a reset in the middle of a write leaves the
+// previous record intact, and the checksum rejects the half written one.
+#define PERSIST_FIRST_REGISTER 8 // BKP0R-BKP7R are left free for the RTC driver
+#define PERSIST_SLOT_WORDS 6
+#define PERSIST_MAGIC 0xC5210000
+#define PERSIST_MAGIC_MASK 0xFFFF0000
+#define PERSIST_SEQUENCE_MASK 0x0000FFFF
+#define PERSIST_CHECK_SEED 0xA5A5A5A5
+
+static volatile uint32_t *slot_registers(int slot) {
+  return &RTC->BKP0R + PERSIST_FIRST_REGISTER + slot * PERSIST_SLOT_WORDS;
+}
+
+static uint32_t checksum(const uint32_t *words) {
+  uint32_t check = PERSIST_CHECK_SEED;
+  for (int i = 0; i < PERSIST_SLOT_WORDS - 1; i++) {
+    check = (check << 5 | check >> 27) ^ words[i]; // Rotate so swapped words do not cancel out
+  }
+  return check;
+}
+
+static int read_slot(int slot, uint32_t *words) {
+  volatile uint32_t *bkp = slot_registers(slot);
+  for (int i = 0; i < PERSIST_SLOT_WORDS; i++) {
+    words[i] = bkp[i];
+  }
+  return (words[0] & PERSIST_MAGIC_MASK) == PERSIST_MAGIC &&
+         words[PERSIST_SLOT_WORDS - 1] == checksum(words); // Slot holds a complete record
+}
+
+static void enable_backup_access(void) {
+  RCC->APB1ENR1 |= RCC_APB1ENR1_PWREN; // Clock the power controller
+  PWR->CR1 |= PWR_CR1_DBP; // Backup domain is write protected after reset
+}
+
+void persist_save(const TimerRecord *record) {
+  uint32_t slot_0[PERSIST_SLOT_WORDS];
+  uint32_t slot_1[PERSIST_SLOT_WORDS];
+  int valid_0 = read_slot(0, slot_0);
+  int valid_1 = read_slot(1, slot_1);
+  uint32_t sequence_0 = valid_0 ? slot_0[0] & PERSIST_SEQUENCE_MASK : 0;
+  uint32_t sequence_1 = valid_1 ? slot_1[0] & PERSIST_SEQUENCE_MASK : 0;
+
+  // Overwrite the older slot, keeping the newest record until this one is complete
+  int slot = (valid_0 && (!valid_1 || (uint16_t)(sequence_0 - sequence_1) < 0x8000)) ? 1 : 0;
+  uint32_t sequence = ((slot ? sequence_0 : sequence_1) + 1) & PERSIST_SEQUENCE_MASK;
+
+  uint32_t words[PERSIST_SLOT_WORDS];
+  words[0] = PERSIST_MAGIC | sequence;
+  words[1] = (record->mode & 0xFF) | (record->count_direction & 0xFF) << 8;
+  words[2] = record->duration;
+  words[3] = record->start_time;
+  words[4] = record->elapsed;
+  words[5] = checksum(words);
+
+  enable_backup_access();
+  volatile uint32_t *bkp = slot_registers(slot);
+  bkp[PERSIST_SLOT_WORDS - 1] = 0; // Invalidate first so a partial write never checks out
+  for (int i = 0; i < PERSIST_SLOT_WORDS; i++) {
+    bkp[i] = words[i];
+  }
+}
+
+int persist_restore(TimerRecord *record) {
+  uint32_t slot_0[PERSIST_SLOT_WORDS];
+  uint32_t slot_1[PERSIST_SLOT_WORDS];
+  int valid_0 = read_slot(0, slot_0);
+  int valid_1 = read_slot(1, slot_1);
+  if (!valid_0 && !valid_1) {
+    return 0; // Cold boot or nothing saved yet
+  }
+
+  uint32_t *words;
+  if (valid_0 && valid_1) { // Take the newer sequence number (wraps at 16 bits)
+    uint16_t difference = (slot_0[0] & PERSIST_SEQUENCE_MASK) - (slot_1[0] & PERSIST_SEQUENCE_MASK);
+    words = difference < 0x8000 ? slot_0 : slot_1;
+  } else {
+    words = valid_0 ? slot_0 : slot_1;
+  }
+
+  record->mode = words[1] & 0xFF;
+  record->count_direction = (words[1] >> 8) & 0xFF;
+  record->duration = words[2];
+  record->start_time = words[3];
+  record->elapsed = words[4];
+  return 1;
+}
+
+void persist_clear(void) {
+  enable_backup_access();
+  slot_registers(0)[0] = 0;
+  slot_registers(1)[0] = 0;
+}
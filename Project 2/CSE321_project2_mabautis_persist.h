@@ -0,0 +1,40 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: Keeps the timer state in the RTC backup registers so a running timer survives a reset
+ *
+ * Modules:
+ *
+ * Subroutines:
+ * void persist_save(const TimerRecord *record) - Writes the record into the older of the two backup register slots
+ * int persist_restore(TimerRecord *record) - Reads the newest valid record, returns 0 if there is none
+ * void persist_clear(void) - Invalidates both slots
+ *
+ * Assignment: Project 2
+ * Inputs:
+ * Outputs:
+ * Constraints:
+ *      Backup registers keep their value through a system reset but not through a power loss
+ *      Times are RTC seconds (time(NULL)), so the RTC has to keep running through the reset
+ * References:
+ *      STM32L4 Reference Manual, RTC backup registers and backup domain access -
+ * https://www.st.com/resource/en/reference_manual/rm0432-stm32l4-series-advanced-armbased-32bit-mcus-stmicroelectronics.pdf
+ */
+#ifndef CSE321_PROJECT2_MABAUTIS_PERSIST_H
+#define CSE321_PROJECT2_MABAUTIS_PERSIST_H
+
+#include <mbed.h>
+
+struct TimerRecord {
+  uint32_t mode;            // TimerMode when the record was written
+  uint32_t count_direction; // 0 -> Down, 1 -> Up
+  uint32_t duration;        // Total seconds entered by the user
+  uint32_t start_time;      // RTC seconds when counting started (pauses excluded)
+  uint32_t elapsed;         // Seconds counted when the record was written
+};
+
+void persist_save(const TimerRecord *record); // Writes the record into the older of the two backup register slots
+int persist_restore(TimerRecord *record); // Reads the newest valid record, returns 0 if there is none
+void persist_clear(void); // Invalidates both slots
+
+#endif
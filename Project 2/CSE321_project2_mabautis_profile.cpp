@@ -0,0 +1,121 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: CPU load profiler. ISRs, thread loops and queued events add the DWT cycles they
+ *               take to a fixed table, printed as a "top" style breakdown
+ *
+ * Modules:
+ *
+ * Subroutines:
+ * void profile_start(void) - Turns on the cycle counter and starts the first window
+ * int profile_slot(const char *name, int kind) - Adds a named slot to the table, returns its id (-1 -> table full)
+ * void profile_end(int slot, uint32_t start) - Adds the cycles since start to a slot
+ * void profile_print(void) - Prints every slot sorted by CPU time and starts a new window
+ * uint32_t cycles_to_tenth_us(uint64_t cycles) - Converts cycles to tenths of a us at SystemCoreClock
+ *
+ * Assignment: Project 2
+ * Inputs:
+ * Outputs:
+ *      USB serial (STDIO), one line per slot: kind, calls, CPU %, average and worst case us
+ * Constraints:
+ *      Slots are added at startup, before their code runs. Names must be string literals
+ *      Sections are timed start to end, so main loop and event figures include the ISRs that ran in
+ *      between. ISRs are also listed on their own
+ *      A window longer than one us_ticker wrap (~71 minutes) shows wrong percentages
+ *      One section must take less than 2^32 cycles (~35s at 120MHz)
+ * References:
+ *      ARMv7-M Architecture Reference Manual, DWT - https://developer.arm.com/documentation/ddi0403/latest
+ */
+#include "CSE321_project2_mabautis_profile.h"
+
+struct ProfileSlot {
+  const char *name;    // Printed name
+  int kind;            // ProfileKind
+  uint32_t calls;      // Sections ended this window
+  uint32_t max_cycles; // Longest section this window
+  uint64_t cycles;     // Total this window
+};
+
+static uint32_t cycles_to_tenth_us(uint64_t cycles); // Converts cycles to tenths of a us at SystemCoreClock
+
+static ProfileSlot slots[PROFILE_SLOTS];
+static int slot_count = 0;
+static uint32_t window_start_us = 0; // us_ticker time the window started
+
+static const char *const kind_names[PROFILE_KIND_COUNT] = {"isr", "loop", "event"};
+
+void profile_start(void) {
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk; // DWT is part of the trace block
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+  window_start_us = us_ticker_read();
+}
+
+int profile_slot(const char *name, int kind) {
+  if (slot_count == PROFILE_SLOTS) {
+    return -1; // Calls with slot -1 are ignored
+  }
+  slots[slot_count].name = name;
+  slots[slot_count].kind = kind;
+  return slot_count++;
+}
+
+void profile_end(int slot, uint32_t start) {
+  uint32_t cycles = DWT->CYCCNT - start; // Unsigned, correct across one counter wrap
+  if (slot < 0) {
+    return;
+  }
+  core_util_critical_section_enter(); // Slots are shared by ISRs and threads
+  ProfileSlot &s = slots[slot];
+  s.calls++;
+  s.cycles += cycles;
+  if (cycles > s.max_cycles) {
+    s.max_cycles = cycles;
+  }
+  core_util_critical_section_exit();
+}
+
+void profile_print(void) {
+  ProfileSlot copy[PROFILE_SLOTS];
+  core_util_critical_section_enter(); // Copy and clear together so no section is lost between them
+  uint32_t now = us_ticker_read();
+  uint32_t window_us = now - window_start_us;
+  window_start_us = now;
+  for (int i = 0; i < slot_count; i++) {
+    copy[i] = slots[i];
+    slots[i].calls = 0;
+    slots[i].cycles = 0;
+    slots[i].max_cycles = 0;
+  }
+  core_util_critical_section_exit();
+
+  // Busiest first, insertion sort of a few entries
+  for (int i = 1; i < slot_count; i++) {
+    ProfileSlot slot = copy[i];
+    int j = i;
+    for (; j > 0 && copy[j - 1].cycles < slot.cycles; j--) {
+      copy[j] = copy[j - 1];
+    }
+    copy[j] = slot;
+  }
+
+  uint64_t window_cycles = (uint64_t)window_us * (SystemCoreClock / 1000000);
+  uint64_t busy = 0;
+  printf("window %lu ms\n", (unsigned long)(window_us / 1000));
+  printf("name               kind      calls   cpu %%    avg us    max us\n");
+  for (int i = 0; i < slot_count; i++) {
+    const ProfileSlot &s = copy[i];
+    uint32_t hundredths = window_cycles ? s.cycles * 10000 / window_cycles : 0;
+    uint32_t avg = s.calls ? cycles_to_tenth_us(s.cycles / s.calls) : 0;
+    uint32_t max = cycles_to_tenth_us(s.max_cycles);
+    printf("%-18s %-6s %9lu %4lu.%02lu %7lu.%lu %7lu.%lu\n", s.name, kind_names[s.kind], (unsigned long)s.calls,
+           (unsigned long)(hundredths / 100), (unsigned long)(hundredths % 100), (unsigned long)(avg / 10),
+           (unsigned long)(avg % 10), (unsigned long)(max / 10), (unsigned long)(max % 10));
+    busy += s.cycles; // An ISR that interrupted a thread is counted twice, so "other" is a lower bound
+  }
+  uint32_t other = window_cycles > busy ? (window_cycles - busy) * 10000 / window_cycles : 0;
+  // Idle, kernel and unprofiled code
+  printf("%-18s %-6s %9s %4lu.%02lu\n", "other", "idle", "", (unsigned long)(other / 100), (unsigned long)(other % 100));
+}
+
+static uint32_t cycles_to_tenth_us(uint64_t cycles) { return cycles * 10 / (SystemCoreClock / 1000000); }
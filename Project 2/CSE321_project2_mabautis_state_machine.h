@@ -0,0 +1,146 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: Transition table for the timer modes and keypad input
+ *
+ * Modules:
+ *
+ * Subroutines:
+ * constexpr KeyClass classify_key(char key) - Maps a keypad character to the key class used to index the table
+ * constexpr Transition next_transition(int mode, int key_class) - Looks up the action and next mode for an input
+ * constexpr TimerMode action_target(int action, int mode) - Mode an action must leave the timer in
+ * constexpr bool transition_table_valid(void) - Checks every (mode, key class) cell of the table, used by a static_assert
+ *
+ * Assignment: Project 2
+ * Inputs:
+ * Outputs:
+ * Constraints:
+ *      Header has no mbed dependencies so the table can be checked on the host. The table is checked at compile time:
+ *      every cell must land in the mode its action implies, ignored inputs keep the mode, only D wakes MODE_OFF,
+ *      only MODE_TIMER pauses or expires and only MODE_PAUSED resumes
+ * References:
+ */
+#ifndef CSE321_PROJECT2_MABAUTIS_STATE_MACHINE_H
+#define CSE321_PROJECT2_MABAUTIS_STATE_MACHINE_H
+
+enum TimerMode {
+  MODE_OFF = 0,    // Display off, waiting for D
+  MODE_INPUT = 1,  // Entering time M:SS
+  MODE_TIMER = 2,  // Counting
+  MODE_PAUSED = 3, // Counting halted, time kept
+  MODE_COUNT
+};
+
+enum KeyClass {
+  KEY_DIGIT = 0, // '0' - '9'
+  KEY_A,
+  KEY_B,
+  KEY_C,
+  KEY_D,
+  KEY_OTHER,     // '*' and '#'
+  EVENT_EXPIRED, // Not a key: raised by timer() when the time runs out
+  KEY_CLASS_COUNT
+};
+
+enum TimerAction {
+  ACTION_NONE = 0,         // Input ignored in this mode
+  ACTION_POWER_ON,         // Backlight on and show the input prompt
+  ACTION_ENTER_DIGIT,      // Add a digit to the entered time
+  ACTION_START,            // Start counting
+  ACTION_TURN_OFF,         // Reset time and turn the display off
+  ACTION_TOGGLE_DIRECTION, // Switch between counting up and down
+  ACTION_RESET_INPUT,      // Clear the time and show the input prompt
+  ACTION_PAUSE,            // Halt counting
+  ACTION_RESUME,           // Continue counting
+  ACTION_EXPIRE            // Time reached, blink and turn off
+};
+
+struct Transition {
+  TimerAction action; // Work to do for the input
+  TimerMode next;     // Mode after the action
+};
+
+constexpr KeyClass classify_key(char key) {
+  return (key >= '0' && key <= '9') ? KEY_DIGIT
+         : key == 'A'               ? KEY_A
+         : key == 'B'               ? KEY_B
+         : key == 'C'               ? KEY_C
+         : key == 'D'               ? KEY_D
+                                    : KEY_OTHER;
+}
+
+// Indexed by [mode][key class]
+constexpr Transition transition_table[MODE_COUNT][KEY_CLASS_COUNT] = {
+    // MODE_OFF: only D powers the timer on
+    {{ACTION_NONE, MODE_OFF},
+     {ACTION_NONE, MODE_OFF},
+     {ACTION_NONE, MODE_OFF},
+     {ACTION_NONE, MODE_OFF},
+     {ACTION_POWER_ON, MODE_INPUT},
+     {ACTION_NONE, MODE_OFF},
+     {ACTION_NONE, MODE_OFF}},
+    // MODE_INPUT: digits, A to start, B to turn off
+    {{ACTION_ENTER_DIGIT, MODE_INPUT},
+     {ACTION_START, MODE_TIMER},
+     {ACTION_TURN_OFF, MODE_OFF},
+     {ACTION_NONE, MODE_INPUT},
+     {ACTION_NONE, MODE_INPUT},
+     {ACTION_NONE, MODE_INPUT},
+     {ACTION_NONE, MODE_INPUT}},
+    // MODE_TIMER: A pauses, B turns off, C switches direction, D re-enters time
+    {{ACTION_NONE, MODE_TIMER},
+     {ACTION_PAUSE, MODE_PAUSED},
+     {ACTION_TURN_OFF, MODE_OFF},
+     {ACTION_TOGGLE_DIRECTION, MODE_TIMER},
+     {ACTION_RESET_INPUT, MODE_INPUT},
+     {ACTION_NONE, MODE_TIMER},
+     {ACTION_EXPIRE, MODE_OFF}},
+    // MODE_PAUSED: A resumes, otherwise same as MODE_TIMER
+    {{ACTION_NONE, MODE_PAUSED},
+     {ACTION_RESUME, MODE_TIMER},
+     {ACTION_TURN_OFF, MODE_OFF},
+     {ACTION_TOGGLE_DIRECTION, MODE_PAUSED},
+     {ACTION_RESET_INPUT, MODE_INPUT},
+     {ACTION_NONE, MODE_PAUSED},
+     {ACTION_NONE, MODE_PAUSED}},
+};
+
+constexpr Transition next_transition(int mode, int key_class) {
+  return transition_table[mode][key_class];
+}
+
+constexpr TimerMode action_target(int action, int mode) {
+  return action == ACTION_POWER_ON || action == ACTION_ENTER_DIGIT || action == ACTION_RESET_INPUT ? MODE_INPUT
+         : action == ACTION_START || action == ACTION_RESUME                                      ? MODE_TIMER
+         : action == ACTION_PAUSE                                                                 ? MODE_PAUSED
+         : action == ACTION_TURN_OFF || action == ACTION_EXPIRE                                   ? MODE_OFF
+                                                                                                  : (TimerMode)mode;
+}
+
+constexpr bool transition_table_valid(void) {
+  for (int mode = 0; mode < MODE_COUNT; mode++) {
+    for (int key_class = 0; key_class < KEY_CLASS_COUNT; key_class++) {
+      Transition transition = next_transition(mode, key_class);
+      if (transition.next != action_target(transition.action, mode)) {
+        return false;
+      }
+      if (transition.action == ACTION_NONE) {
+        continue;
+      }
+      if ((mode == MODE_OFF && key_class != KEY_D) || (key_class == EVENT_EXPIRED && mode != MODE_TIMER) ||
+          (transition.action == ACTION_PAUSE && mode != MODE_TIMER) ||
+          (transition.action == ACTION_RESUME && mode != MODE_PAUSED)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static_assert(transition_table_valid(), "transition_table has a cell that breaks the timer mode rules");
+static_assert(next_transition(MODE_TIMER, KEY_A).action == ACTION_PAUSE, "A pauses a running timer");
+static_assert(next_transition(MODE_PAUSED, KEY_A).action == ACTION_RESUME, "A resumes a paused timer");
+static_assert(next_transition(MODE_PAUSED, EVENT_EXPIRED).action == ACTION_NONE, "a paused timer cannot expire");
+static_assert(next_transition(MODE_INPUT, KEY_A).action == ACTION_START, "A starts the entered time");
+
+#endif
@@ -47,6 +47,6 @@ void set_pin_mode(unsigned int pin, GPIO_TypeDef *port, unsigned int mode) {
 }
 
 void write_to_pin(unsigned int pin, GPIO_TypeDef *port, unsigned int value) {
-  // Writes logic high/low to pin
-  value ? port->ODR |= (0x1 << pin) : port->ODR &= ~(0x1 << pin);
+  // Writes logic high/low to pin. BSRR sets/resets the pin atomically so ISRs can share the port
+  port->BSRR = value ? (0x1 << pin) : (0x1 << (pin + 16));
 }
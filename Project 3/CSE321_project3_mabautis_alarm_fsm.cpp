@@ -0,0 +1,65 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: Table driven state machine for the alarm modes. Keypad, microphone, ultrasonic and
+ *               idle inputs are events that all go through alarm_dispatch
+ *
+ * Modules:
+ *
+ * Subroutines:
+ * void alarm_fsm_init(const StateInfo *states, void (*run_action)(int action, char key)) - Sets the state table and action runner, enters STATE_POWER_ON
+ * void alarm_dispatch(int event, char key) - Runs one event and any events raised by its actions
+ * void alarm_raise(int event) - Queues a follow-up event from inside an action (e.g. passcode checked)
+ * int alarm_state(void) - Current state (safe to read from an ISR)
+ *
+ * Assignment: Project 3
+ * Inputs:
+ * Outputs:
+ * Constraints:
+ *      alarm_dispatch is not reentrant, callers serialize it with alarm_lock
+ * References:
+ */
+#include "CSE321_project3_mabautis_alarm_fsm.h"
+
+#define NO_EVENT -1
+
+static const StateInfo *state_table = nullptr; // Entry/exit actions and prompts, indexed by state
+static void (*action_runner)(int action, char key) = nullptr; // Runs the table actions
+static volatile int state = STATE_POWER_ON; // Current state
+static int raised_event = NO_EVENT; // Follow-up event raised by an action
+
+void alarm_fsm_init(const StateInfo *states, void (*run_action)(int action, char key)) {
+  state_table = states;
+  action_runner = run_action;
+  state = STATE_POWER_ON;
+  if (state_table[state].entry) {
+    state_table[state].entry();
+  }
+}
+
+void alarm_raise(int event) { raised_event = event; }
+
+int alarm_state(void) { return state; }
+
+void alarm_dispatch(int event, char key) {
+  // An action raises at most one event and raised events carry no key, so the loop is bounded
+  // by the longest chain in the table (digit -> passcode checked -> new state)
+  while (event != NO_EVENT) {
+    AlarmTransition transition = alarm_table[state][event];
+    raised_event = NO_EVENT;
+    if (transition.action != ACTION_NONE) {
+      action_runner(transition.action, key);
+    }
+    if (transition.next != state) {
+      if (state_table[state].exit) {
+        state_table[state].exit();
+      }
+      state = transition.next;
+      if (state_table[state].entry) {
+        state_table[state].entry();
+      }
+    }
+    event = raised_event;
+    key = 0;
+  }
+}
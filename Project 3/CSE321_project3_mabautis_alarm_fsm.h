@@ -0,0 +1,131 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: Table driven state machine for the alarm modes. Keypad, microphone, ultrasonic and
+ *               idle inputs are events that all go through alarm_dispatch
+ *
+ * Modules:
+ *
+ * Subroutines:
+ * void alarm_fsm_init(const StateInfo *states, void (*run_action)(int action, char key)) - Sets the state table and action runner, enters STATE_POWER_ON
+ * void alarm_dispatch(int event, char key) - Runs one event and any events raised by its actions
+ * void alarm_raise(int event) - Queues a follow-up event from inside an action (e.g. passcode checked)
+ * int alarm_state(void) - Current state (safe to read from an ISR)
+ * constexpr AlarmEvent key_event(char key) - Maps a keypad character to its event
+ * constexpr bool alarm_table_valid(void) - Checks every state's row of the table, used by a static_assert
+ *
+ * Assignment: Project 3
+ * Inputs:
+ * Outputs:
+ * Constraints:
+ *      alarm_dispatch is not reentrant, callers serialize it with alarm_lock
+ *      The transition table has no mbed dependencies so it can be checked on the host. It is checked at compile
+ *      time: a correct passcode arms from unarmed and disarms from armed or triggered, a wrong one never changes
+ *      the state, sensor events only trigger from armed and the idle event never changes the state
+ * References:
+ */
+#ifndef CSE321_PROJECT3_MABAUTIS_ALARM_FSM_H
+#define CSE321_PROJECT3_MABAUTIS_ALARM_FSM_H
+
+enum AlarmState {
+  STATE_POWER_ON = 0,  // Passcode being defined
+  STATE_UNARMED = 1,   // Sensors do not trigger the system
+  STATE_ARMED = 2,     // Sensors trigger the system
+  STATE_TRIGGERED = 3, // Sensor tripped while armed
+  STATE_COUNT
+};
+
+enum AlarmEvent {
+  EVENT_DIGIT = 0,    // '0' - '9'
+  EVENT_KEY_A,        // Begin passcode entry
+  EVENT_KEY_OTHER,    // '*', '#', 'B', 'C', 'D'
+  EVENT_PASSCODE_SET, // Raised when the new passcode is complete
+  EVENT_PASSCODE_OK,  // Raised when an entered passcode matches
+  EVENT_PASSCODE_BAD, // Raised when an entered passcode does not match
+  EVENT_MICROPHONE,   // Loud sound confirmed
+  EVENT_ULTRASONIC,   // Object confirmed inside the trigger range
+  EVENT_CONTACT,      // Contact switch opened or PIR saw motion
+  EVENT_IDLE,         // No input for 10 seconds
+  EVENT_COUNT
+};
+
+enum AlarmAction {
+  ACTION_NONE = 0,     // Event only changes the state (or is ignored)
+  ACTION_SET_DIGIT,    // Add a digit to the passcode being defined
+  ACTION_START_ENTRY,  // Show the passcode prompt
+  ACTION_ENTRY_DIGIT,  // Add a digit to the passcode being entered
+  ACTION_REJECT,       // Tell the user the passcode was wrong
+  ACTION_IDLE_RESET    // Display off, drop a partial passcode, restore the state prompt
+};
+
+struct AlarmTransition {
+  AlarmAction action; // Work to do for the event
+  AlarmState next;    // State after the action
+};
+
+struct StateInfo {
+  const char *prompt;  // Idle prompt shown for the state
+  void (*entry)(void); // Run when the state is entered (nullptr -> nothing)
+  void (*exit)(void);  // Run when the state is left (nullptr -> nothing)
+};
+
+#define T(action, next) {ACTION_##action, STATE_##next}
+
+// Indexed by [state][event]. Every row lists the events in AlarmEvent order:
+// DIGIT, KEY_A, KEY_OTHER, PASSCODE_SET, PASSCODE_OK, PASSCODE_BAD, MICROPHONE, ULTRASONIC, CONTACT, IDLE
+constexpr AlarmTransition alarm_table[STATE_COUNT][EVENT_COUNT] = {
+    {T(SET_DIGIT, POWER_ON), T(NONE, POWER_ON), T(NONE, POWER_ON), T(NONE, UNARMED), T(NONE, POWER_ON),
+     T(NONE, POWER_ON), T(NONE, POWER_ON), T(NONE, POWER_ON), T(NONE, POWER_ON),
+     T(IDLE_RESET, POWER_ON)},
+    {T(ENTRY_DIGIT, UNARMED), T(START_ENTRY, UNARMED), T(NONE, UNARMED), T(NONE, UNARMED), T(NONE, ARMED),
+     T(REJECT, UNARMED), T(NONE, UNARMED), T(NONE, UNARMED), T(NONE, UNARMED), T(IDLE_RESET, UNARMED)},
+    {T(ENTRY_DIGIT, ARMED), T(START_ENTRY, ARMED), T(NONE, ARMED), T(NONE, ARMED), T(NONE, UNARMED),
+     T(REJECT, ARMED), T(NONE, TRIGGERED), T(NONE, TRIGGERED), T(NONE, TRIGGERED), T(IDLE_RESET, ARMED)},
+    {T(ENTRY_DIGIT, TRIGGERED), T(START_ENTRY, TRIGGERED), T(NONE, TRIGGERED), T(NONE, TRIGGERED), T(NONE, UNARMED),
+     T(REJECT, TRIGGERED), T(NONE, TRIGGERED), T(NONE, TRIGGERED), T(NONE, TRIGGERED),
+     T(IDLE_RESET, TRIGGERED)},
+};
+
+#undef T
+
+constexpr AlarmEvent key_event(char key) {
+  return (key >= '0' && key <= '9') ? EVENT_DIGIT : key == 'A' ? EVENT_KEY_A : EVENT_KEY_OTHER;
+}
+
+constexpr bool alarm_table_valid(void) {
+  for (int state = 0; state < STATE_COUNT; state++) {
+    const AlarmTransition *row = alarm_table[state];
+    if (row[EVENT_PASSCODE_BAD].next != state || row[EVENT_IDLE].next != state) {
+      return false; // A wrong passcode or the idle timeout never changes the state
+    }
+    for (int event = EVENT_MICROPHONE; event <= EVENT_CONTACT; event++) {
+      if (row[event].next != (state == STATE_ARMED ? STATE_TRIGGERED : state)) {
+        return false; // Sensors only trigger an armed system
+      }
+    }
+  }
+  return true;
+}
+
+static_assert(alarm_table_valid(), "alarm_table has a row that breaks the alarm state rules");
+static_assert(alarm_table[STATE_POWER_ON][EVENT_PASSCODE_OK].next == STATE_POWER_ON,
+              "no passcode to check before one is set");
+static_assert(alarm_table[STATE_UNARMED][EVENT_PASSCODE_OK].next == STATE_ARMED, "a correct passcode arms");
+static_assert(alarm_table[STATE_ARMED][EVENT_PASSCODE_OK].next == STATE_UNARMED, "a correct passcode disarms");
+static_assert(alarm_table[STATE_TRIGGERED][EVENT_PASSCODE_OK].next == STATE_UNARMED,
+              "a correct passcode silences the alarm");
+static_assert(alarm_table[STATE_POWER_ON][EVENT_PASSCODE_BAD].action == ACTION_NONE,
+              "no passcode to reject before one is set");
+static_assert(alarm_table[STATE_UNARMED][EVENT_PASSCODE_BAD].action == ACTION_REJECT &&
+                  alarm_table[STATE_ARMED][EVENT_PASSCODE_BAD].action == ACTION_REJECT &&
+                  alarm_table[STATE_TRIGGERED][EVENT_PASSCODE_BAD].action == ACTION_REJECT,
+              "a wrong passcode is rejected once one is set");
+static_assert(alarm_table[STATE_POWER_ON][EVENT_PASSCODE_SET].next == STATE_UNARMED,
+              "a new passcode leaves power on unarmed");
+
+void alarm_fsm_init(const StateInfo *states, void (*run_action)(int action, char key)); // Sets the state table and action runner, enters STATE_POWER_ON
+void alarm_dispatch(int event, char key); // Runs one event and any events raised by its actions
+void alarm_raise(int event); // Queues a follow-up event from inside an action (e.g. passcode checked)
+int alarm_state(void); // Current state (safe to read from an ISR)
+
+#endif
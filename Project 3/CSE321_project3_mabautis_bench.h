@@ -0,0 +1,40 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: Microbenchmark runner. Times every entry of a benchmark table with the DWT cycle
+ *               counter and prints one CSV row per entry
+ *
+ * Modules:
+ *
+ * Subroutines:
+ * void bench_run(const char *project, const Benchmark *benchmarks, int count) - Times every benchmark and prints the results as CSV
+ *
+ * Assignment: Project 3
+ * Inputs:
+ * Outputs:
+ *      USB serial (STDIO), "project,benchmark,iterations,min_cycles,avg_cycles,max_cycles,avg_us" then one row per benchmark
+ * Constraints:
+ *      Only built into the firmware when the bench option is set in mbed_app.json
+ *      Cycles exclude the setup call and the cost of reading the counter. Interrupts are left on, so
+ *      max_cycles includes any ISR that landed in a call; min_cycles is the figure to compare
+ *      One call must take less than 2^32 cycles (~35s at 120MHz)
+ * References:
+ *      ARMv7-M Architecture Reference Manual, DWT - https://developer.arm.com/documentation/ddi0403/latest
+ */
+#ifndef CSE321_PROJECT3_MABAUTIS_BENCH_H
+#define CSE321_PROJECT3_MABAUTIS_BENCH_H
+
+#ifndef MBED_CONF_APP_BENCH
+#define MBED_CONF_APP_BENCH 0 // 1 -> main runs the benchmarks instead of the alarm
+#endif
+
+struct Benchmark {
+  const char *name;          // Benchmark column of the CSV
+  int iterations;            // Timed calls
+  void (*setup)(int i);      // Untimed, runs before every call (nullptr -> nothing)
+  void (*run)(int i);        // Timed call, i counts from 0
+};
+
+void bench_run(const char *project, const Benchmark *benchmarks, int count); // Times every benchmark and prints the results as CSV
+
+#endif
@@ -0,0 +1,91 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: Serial command console. A low priority thread reads lines from the USB serial port
+ *               and runs the matching command from a table
+ *
+ * Modules:
+ *      CSE321_project3_mabautis_profile - CPU time of the commands run
+ *
+ * Subroutines:
+ * void console_start(const ConsoleCommand *commands, int count) - Starts the console thread with the command table
+ * void console_loop(void) - Console thread, reads a line and runs its command
+ * void print_help(void) - Lists the commands in the table
+ *
+ * Assignment: Project 3
+ * Inputs:
+ *      USB serial (STDIO), a command name and optional arguments ending with enter
+ * Outputs:
+ *      USB serial (STDIO)
+ * Constraints:
+ *      Needs platform.stdio-buffered-serial (mbed_app.json) so reading blocks instead of polling
+ *      Commands run on the console thread, they must take alarm_lock before touching the state machine, passcodes
+ *      or trip latency stats (as print_latency does), and keypad_lock before touching the keypad row
+ * References:
+ *      MBED BufferedSerial - https://os.mbed.com/docs/mbed-os/v6.15/apis/serial-uart-apis.html
+ */
+#include "CSE321_project3_mabautis_console.h"
+#include "CSE321_project3_mabautis_memory.h"
+#include "CSE321_project3_mabautis_profile.h"
+#include <mbed.h>
+
+static void console_loop(void); // Console thread, reads a line and runs its command
+static void print_help(void); // Lists the commands in the table
+
+static const ConsoleCommand *command_table = nullptr;
+static int command_count = 0;
+static int command_slot = -1; // Profiler slot of the commands run
+
+static Thread console_thread(osPriorityLow, CONSOLE_STACK_SIZE, nullptr, "console");
+
+void console_start(const ConsoleCommand *commands, int count) {
+  command_table = commands;
+  command_count = count;
+  command_slot = profile_slot("console", PROFILE_THREAD);
+  console_thread.start(&console_loop);
+}
+
+static void console_loop(void) {
+  char line[CONSOLE_LINE_LENGTH + 1];
+  int length = 0;
+  while (1) {
+    int c = getchar(); // Blocks the thread until a character arrives
+    if (c != '\r' && c != '\n') {
+      if (length < CONSOLE_LINE_LENGTH) {
+        line[length++] = c;
+      }
+      continue;
+    }
+    if (!length) {
+      continue; // Empty line or the \n of a \r\n pair
+    }
+    line[length] = '\0';
+    length = 0;
+    char *args = strchr(line, ' '); // Split the name from its arguments
+    if (args) {
+      *args++ = '\0';
+    } else {
+      args = line + strlen(line);
+    }
+    int found = 0;
+    uint32_t start = profile_begin();
+    for (int i = 0; i < command_count; i++) {
+      if (strcmp(line, command_table[i].name) == 0) {
+        command_table[i].run(args);
+        found = 1;
+        break;
+      }
+    }
+    profile_end(command_slot, start);
+    if (!found) {
+      print_help();
+    }
+  }
+}
+
+static void print_help(void) {
+  printf("Commands:\n");
+  for (int i = 0; i < command_count; i++) {
+    printf("  %-8s %s\n", command_table[i].name, command_table[i].help);
+  }
+}
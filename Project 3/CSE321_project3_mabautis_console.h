@@ -0,0 +1,37 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: Serial command console. A low priority thread reads lines from the USB serial port
+ *               and runs the matching command from a table
+ *
+ * Modules:
+ *
+ * Subroutines:
+ * void console_start(const ConsoleCommand *commands, int count) - Starts the console thread with the command table
+ *
+ * Assignment: Project 3
+ * Inputs:
+ *      USB serial (STDIO), a command name and optional arguments ending with enter
+ * Outputs:
+ *      USB serial (STDIO)
+ * Constraints:
+ *      Needs platform.stdio-buffered-serial (mbed_app.json) so reading blocks instead of polling
+ *      Commands run on the console thread, they must take alarm_lock before touching the state machine, passcodes
+ *      or trip latency stats (as print_latency does), and keypad_lock before touching the keypad row
+ * References:
+ *      MBED BufferedSerial - https://os.mbed.com/docs/mbed-os/v6.15/apis/serial-uart-apis.html
+ */
+#ifndef CSE321_PROJECT3_MABAUTIS_CONSOLE_H
+#define CSE321_PROJECT3_MABAUTIS_CONSOLE_H
+
+#define CONSOLE_LINE_LENGTH 32 // Longest command line
+
+struct ConsoleCommand {
+  const char *name; // Word typed to run the command
+  const char *help; // One line description printed by "help"
+  void (*run)(const char *args); // Gets the rest of the line after the name
+};
+
+void console_start(const ConsoleCommand *commands, int count); // Starts the console thread with the command table
+
+#endif
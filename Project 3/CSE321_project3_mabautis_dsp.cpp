@@ -0,0 +1,117 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: Block RMS and peak of ADC samples using the Cortex-M4 SIMD instructions
+ *
+ * Modules:
+ *
+ * Subroutines:
+ * void block_stats(const uint16_t *samples, uint32_t count, BlockStats *stats) - Computes mean, RMS and peak of a block
+ * void block_stats_c(const uint16_t *samples, uint32_t count, BlockStats *stats) - Same as block_stats in plain C, the reference for the SIMD path
+ * uint32_t isqrt(uint32_t value) - Integer square root
+ *
+ * Assignment: Project 3
+ * Inputs:
+ * Outputs:
+ * Constraints:
+ *      count must be even and samples must be 4 byte aligned (two samples are processed per 32-bit word)
+ *      Samples must be 12-bit ADC values (0-4095). The SIMD path works on signed halfwords and SMLAD adds two
+ *      squares per instruction, it is only exact while every |sample - mean| is under 23170
+ *      Uses SMLAD/SSUB16/USUB16/SEL when __ARM_FEATURE_DSP is set, block_stats_c otherwise (host builds). The
+ *      DC, square wave and sine vectors of CSE321_project3_mabautis_vectors check both against known answers
+ * References:
+ *      CMSIS SIMD intrinsics - https://arm-software.github.io/CMSIS_5/Core/html/group__intrinsic__SIMD__gr.html
+ */
+#include "CSE321_project3_mabautis_dsp.h"
+
+#if defined(__ARM_FEATURE_DSP) && __ARM_FEATURE_DSP
+#include "cmsis.h"
+#define DSP_SIMD 1
+#else
+#define DSP_SIMD 0
+#endif
+
+uint32_t isqrt(uint32_t value) {
+  uint32_t root = 0;
+  uint32_t bit = 1u << 30; // Highest power of four that fits
+  while (bit > value) {
+    bit >>= 2;
+  }
+  while (bit) { // Digit by digit method, one result bit per loop
+    if (value >= root + bit) {
+      value -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return root;
+}
+
+void block_stats(const uint16_t *samples, uint32_t count, BlockStats *stats) {
+#if DSP_SIMD
+  if (!count) {
+    stats->mean = stats->rms = stats->peak = 0;
+    return;
+  }
+  uint32_t sum = 0;
+  uint64_t square_sum = 0;
+  const uint32_t *pairs = (const uint32_t *)samples; // Two samples per word
+  uint32_t pair_count = count / 2;
+  uint32_t max_pair = 0x00000000;
+  uint32_t min_pair = 0xFFFFFFFF;
+
+  // Pass 1: sum and per-halfword min/max
+  for (uint32_t i = 0; i < pair_count; i++) {
+    uint32_t pair = pairs[i];
+    sum = __SMLAD(pair, 0x00010001, sum); // sum += low + high
+    __USUB16(pair, max_pair);             // GE flags set where pair >= max
+    max_pair = __SEL(pair, max_pair);
+    __USUB16(pair, min_pair);             // GE flags set where pair >= min
+    min_pair = __SEL(min_pair, pair);
+  }
+  uint32_t mean = sum / count;
+  uint32_t mean_pair = mean | mean << 16;
+
+  // Pass 2: sum of squares around the mean, two multiply-accumulates per instruction. One pair
+  // is at most 2 * 4095^2 which fits in 32 bits, the running total is kept in 64 bits.
+  for (uint32_t i = 0; i < pair_count; i++) {
+    uint32_t centered = __SSUB16(pairs[i], mean_pair); // Both halves minus the mean
+    square_sum += __SMLAD(centered, centered, 0);      // low^2 + high^2
+  }
+  uint32_t max = (max_pair & 0xFFFF) > (max_pair >> 16) ? (max_pair & 0xFFFF) : (max_pair >> 16);
+  uint32_t min = (min_pair & 0xFFFF) < (min_pair >> 16) ? (min_pair & 0xFFFF) : (min_pair >> 16);
+
+  stats->mean = mean;
+  stats->rms = isqrt((uint32_t)(square_sum / count));
+  stats->peak = (max - mean) > (mean - min) ? (max - mean) : (mean - min);
+#else
+  block_stats_c(samples, count, stats);
+#endif
+}
+
+void block_stats_c(const uint16_t *samples, uint32_t count, BlockStats *stats) {
+  if (!count) {
+    stats->mean = stats->rms = stats->peak = 0;
+    return;
+  }
+  uint32_t sum = 0;
+  uint32_t max = 0;
+  uint32_t min = 0xFFFF;
+  uint64_t square_sum = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    sum += samples[i];
+    max = samples[i] > max ? samples[i] : max;
+    min = samples[i] < min ? samples[i] : min;
+  }
+  uint32_t mean = sum / count;
+  for (uint32_t i = 0; i < count; i++) {
+    int32_t centered = (int32_t)samples[i] - (int32_t)mean;
+    square_sum += (uint32_t)(centered * centered);
+  }
+
+  stats->mean = mean;
+  stats->rms = isqrt((uint32_t)(square_sum / count));
+  stats->peak = (max - mean) > (mean - min) ? (max - mean) : (mean - min);
+}
@@ -0,0 +1,40 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: Block RMS and peak of ADC samples using the Cortex-M4 SIMD instructions
+ *
+ * Modules:
+ *
+ * Subroutines:
+ * void block_stats(const uint16_t *samples, uint32_t count, BlockStats *stats) - Computes mean, RMS and peak of a block
+ * void block_stats_c(const uint16_t *samples, uint32_t count, BlockStats *stats) - Same as block_stats in plain C, the reference for the SIMD path
+ * uint32_t isqrt(uint32_t value) - Integer square root
+ *
+ * Assignment: Project 3
+ * Inputs:
+ * Outputs:
+ * Constraints:
+ *      count must be even and samples must be 4 byte aligned (two samples are processed per 32-bit word)
+ *      Samples must be 12-bit ADC values (0-4095). The SIMD path works on signed halfwords and SMLAD adds two
+ *      squares per instruction, it is only exact while every |sample - mean| is under 23170
+ *      Uses SMLAD/SSUB16/USUB16/SEL when __ARM_FEATURE_DSP is set, block_stats_c otherwise (host builds). The
+ *      DC, square wave and sine vectors of CSE321_project3_mabautis_vectors check both against known answers
+ * References:
+ *      CMSIS SIMD intrinsics - https://arm-software.github.io/CMSIS_5/Core/html/group__intrinsic__SIMD__gr.html
+ */
+#ifndef CSE321_PROJECT3_MABAUTIS_DSP_H
+#define CSE321_PROJECT3_MABAUTIS_DSP_H
+
+#include <stdint.h>
+
+struct BlockStats {
+  uint32_t mean; // DC level (microphone bias) in ADC counts
+  uint32_t rms;  // RMS of the signal around the mean in ADC counts
+  uint32_t peak; // Largest distance from the mean in ADC counts
+};
+
+void block_stats(const uint16_t *samples, uint32_t count, BlockStats *stats); // Computes mean, RMS and peak of a block
+void block_stats_c(const uint16_t *samples, uint32_t count, BlockStats *stats); // Same as block_stats in plain C, the reference for the SIMD path
+uint32_t isqrt(uint32_t value); // Integer square root
+
+#endif
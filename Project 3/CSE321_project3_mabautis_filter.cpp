@@ -0,0 +1,96 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: Integer sensor filters - median/EMA for distances, edge rate windows and M of N confirmation
+ *
+ * Modules:
+ *
+ * Subroutines:
+ * void distance_filter_reset(DistanceFilter *filter) - Empties the ring buffer and EMA
+ * uint32_t distance_filter_push(DistanceFilter *filter, uint32_t distance) - Adds a reading and returns the median
+ * uint32_t distance_median(const DistanceFilter *filter) - Median of the readings in the ring buffer
+ * uint32_t distance_ema(const DistanceFilter *filter) - Exponential moving average of the readings
+ * void edge_rate_reset(EdgeRateFilter *filter) - Forgets every edge
+ * int edge_rate_push(EdgeRateFilter *filter, uint32_t now_ms) - Adds an edge, returns 1 if enough edges fell inside the window
+ * void confirm_reset(Confirmation *confirm) - Clears the hit history
+ * int confirm_push(Confirmation *confirm, int hit) - Adds a hit/miss, returns 1 when M of the last N were hits
+ *
+ * Assignment: Project 3
+ * Inputs:
+ * Outputs:
+ * Constraints:
+ *      Integer and fixed point only so every call is a few microseconds and safe in an ISR
+ * References:
+ */
+#include "CSE321_project3_mabautis_filter.h"
+
+void distance_filter_reset(DistanceFilter *filter) {
+  filter->head = 0;
+  filter->count = 0;
+  filter->ema_q8 = 0;
+}
+
+uint32_t distance_filter_push(DistanceFilter *filter, uint32_t distance) {
+  filter->samples[filter->head] = distance;
+  filter->head = (filter->head + 1) % FILTER_WINDOW;
+  if (filter->count < FILTER_WINDOW) {
+    filter->count++;
+  }
+
+  int32_t sample_q8 = (int32_t)(distance << 8);
+  if (filter->count == 1) {
+    filter->ema_q8 = sample_q8; // First reading seeds the average
+  } else {
+    filter->ema_q8 += (sample_q8 - filter->ema_q8) >> FILTER_EMA_SHIFT; // ema += (x - ema) / 2^shift
+  }
+  return distance_median(filter);
+}
+
+uint32_t distance_median(const DistanceFilter *filter) {
+  if (!filter->count) {
+    return 0;
+  }
+  uint32_t sorted[FILTER_WINDOW];
+  for (int i = 0; i < filter->count; i++) { // Insertion sort, at most FILTER_WINDOW readings
+    uint32_t value = filter->samples[i];
+    int j = i;
+    for (; j > 0 && sorted[j - 1] > value; j--) {
+      sorted[j] = sorted[j - 1];
+    }
+    sorted[j] = value;
+  }
+  return sorted[filter->count / 2];
+}
+
+uint32_t distance_ema(const DistanceFilter *filter) { return (filter->ema_q8 + 0x80) >> 8; } // Round Q8 to mm
+
+void edge_rate_reset(EdgeRateFilter *filter) {
+  filter->head = 0;
+  filter->count = 0;
+}
+
+int edge_rate_push(EdgeRateFilter *filter, uint32_t now_ms) {
+  filter->times[filter->head] = now_ms;
+  filter->head = (filter->head + 1) % filter->edges; // Only the last `edges` timestamps matter
+  if (filter->count < filter->edges) {
+    filter->count++;
+    if (filter->count < filter->edges) {
+      return 0;
+    }
+  }
+  uint32_t oldest = filter->times[filter->head]; // Slot about to be overwritten holds the oldest edge
+  return now_ms - oldest <= filter->window_ms; // Unsigned subtraction handles the ms counter wrapping
+}
+
+void confirm_reset(Confirmation *confirm) { confirm->history = 0; }
+
+int confirm_push(Confirmation *confirm, int hit) {
+  uint32_t mask = confirm->n >= 32 ? 0xFFFFFFFF : (1u << confirm->n) - 1;
+  confirm->history = ((confirm->history << 1) | (hit ? 1 : 0)) & mask;
+
+  int hits = 0;
+  for (uint32_t bits = confirm->history; bits; bits &= bits - 1) { // Count set bits
+    hits++;
+  }
+  return hits >= confirm->m;
+}
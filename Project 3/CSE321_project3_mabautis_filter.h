@@ -0,0 +1,69 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: Integer sensor filters - median/EMA for distances, edge rate windows and M of N confirmation
+ *
+ * Modules:
+ *
+ * Subroutines:
+ * void distance_filter_reset(DistanceFilter *filter) - Empties the ring buffer and EMA
+ * uint32_t distance_filter_push(DistanceFilter *filter, uint32_t distance) - Adds a reading and returns the median
+ * uint32_t distance_median(const DistanceFilter *filter) - Median of the readings in the ring buffer
+ * uint32_t distance_ema(const DistanceFilter *filter) - Exponential moving average of the readings
+ * void edge_rate_reset(EdgeRateFilter *filter) - Forgets every edge
+ * int edge_rate_push(EdgeRateFilter *filter, uint32_t now_ms) - Adds an edge, returns 1 if enough edges fell inside the window
+ * void confirm_reset(Confirmation *confirm) - Clears the hit history
+ * int confirm_push(Confirmation *confirm, int hit) - Adds a hit/miss, returns 1 when M of the last N were hits
+ *
+ * Assignment: Project 3
+ * Inputs:
+ * Outputs:
+ * Constraints:
+ *      Integer and fixed point only so every call is a few microseconds and safe in an ISR
+ *      Header has no mbed dependencies so the filters can be checked on the host, CSE321_project3_mabautis_vectors
+ *      checks them against known answers on the host and the board
+ * References:
+ */
+#ifndef CSE321_PROJECT3_MABAUTIS_FILTER_H
+#define CSE321_PROJECT3_MABAUTIS_FILTER_H
+
+#include <stdint.h>
+
+#define FILTER_WINDOW 5      // Readings kept per distance sensor (median of N)
+#define FILTER_EMA_SHIFT 2   // EMA weight of a new reading is 1 / 2^shift
+#define EDGE_WINDOW_MAX 8    // Most edges an edge rate filter can require
+#define CONFIRM_WINDOW_MAX 32 // Longest M of N history
+
+struct DistanceFilter {
+  uint32_t samples[FILTER_WINDOW]; // Ring buffer of readings in mm
+  uint8_t head;                    // Next slot to write
+  uint8_t count;                   // Readings in the buffer
+  int32_t ema_q8;                  // Moving average in mm, Q8 fixed point
+};
+
+struct EdgeRateFilter {
+  uint32_t times[EDGE_WINDOW_MAX]; // Ring buffer of edge timestamps in ms
+  uint8_t head;                    // Next slot to write
+  uint8_t count;                   // Edges in the buffer
+  uint8_t edges;                   // Edges needed inside the window (1 - EDGE_WINDOW_MAX)
+  uint32_t window_ms;              // Window length
+};
+
+struct Confirmation {
+  uint32_t history; // Last N results, newest in bit 0
+  uint8_t m;        // Hits needed
+  uint8_t n;        // Results considered
+};
+
+void distance_filter_reset(DistanceFilter *filter); // Empties the ring buffer and EMA
+uint32_t distance_filter_push(DistanceFilter *filter, uint32_t distance); // Adds a reading and returns the median
+uint32_t distance_median(const DistanceFilter *filter); // Median of the readings in the ring buffer
+uint32_t distance_ema(const DistanceFilter *filter); // Exponential moving average of the readings
+
+void edge_rate_reset(EdgeRateFilter *filter); // Forgets every edge
+int edge_rate_push(EdgeRateFilter *filter, uint32_t now_ms); // Adds an edge, returns 1 if enough edges fell inside the window
+
+void confirm_reset(Confirmation *confirm); // Clears the hit history
+int confirm_push(Confirmation *confirm, int hit); // Adds a hit/miss, returns 1 when M of the last N were hits
+
+#endif
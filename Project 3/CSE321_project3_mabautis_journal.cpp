@@ -0,0 +1,188 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: Timestamped alarm event journal. Records go into a RAM ring buffer and a low
+ *               priority thread writes them to the end of internal flash in batches
+ *
+ * Modules:
+ *      CSE321_project3_mabautis_profile - CPU time of the batch writes
+ *
+ * Subroutines:
+ * void journal_start(void) - Finds the newest record in flash and starts the writer thread
+ * void journal_log(int type, int source, int mode) - Adds a record to the RAM ring (ISR safe, no flash access)
+ * void journal_flush(void) - Asks the writer to write the records it has, even if a batch is not full
+ * int journal_dump(void (*print_record)(const JournalRecord *record)) - Passes every record, oldest first, to print_record
+ * uint32_t journal_dropped(void) - Records lost because the RAM ring was full
+ * void journal_writer(void) - Writer thread, moves batches from the RAM ring to flash
+ * void write_batch(void) - Programs up to one batch of records at the write slot
+ * void find_write_slot(void) - Scans the flash region for the slot after the newest record
+ *
+ * Assignment: Project 3
+ * Inputs:
+ * Outputs:
+ *      Last JOURNAL_FLASH_SECTORS sectors of internal flash
+ * Constraints:
+ *      The flash region is a circular log. The sector after the write slot is erased as soon as the
+ *      write slot reaches it, so there is always an erased gap in front of the newest record and the
+ *      scan at boot can find it. The oldest sector is lost on each wrap, spreading erases evenly
+ *      The region is at the end of bank 2, so programming it does not stall code running from bank 1
+ * References:
+ *      MBED FlashIAP - https://os.mbed.com/docs/mbed-os/v6.15/apis/flash-iap.html
+ *      MBED Thread flags - https://os.mbed.com/docs/mbed-os/v6.15/apis/thisthread.html
+ */
+#include "CSE321_project3_mabautis_journal.h"
+#include "CSE321_project3_mabautis_memory.h"
+#include "CSE321_project3_mabautis_profile.h"
+#include <mbed.h>
+
+#define JOURNAL_MARKER 0xA5 // Marks a written record
+#define FLAG_BATCH 1        // Thread flag: a full batch is waiting
+#define FLAG_FLUSH 2        // Thread flag: write whatever is waiting
+
+static void journal_writer(void); // Writer thread, moves batches from the RAM ring to flash
+static void write_batch(void); // Programs up to one batch of records at the write slot
+static void find_write_slot(void); // Scans the flash region for the slot after the newest record
+
+static JournalRecord ring[JOURNAL_RAM_RECORDS]; // Records not yet in flash
+static volatile uint32_t ring_head = 0; // Next free entry (free running, masked on use)
+static volatile uint32_t ring_tail = 0; // Oldest entry not yet in flash
+static volatile uint32_t dropped = 0; // Records lost to a full ring
+
+static FlashIAP flash;
+static uint32_t region_start = 0; // Address of the first slot
+static uint32_t sector_size = 0;
+static uint32_t slot_count = 0; // Records that fit in the region
+static uint32_t write_slot = 0; // Next slot to program
+static int flash_ready = 0; // Region found and writer running
+static int writer_slot = -1; // Profiler slot of the batch writes
+
+static Thread writer_thread(osPriorityLow, JOURNAL_STACK_SIZE, nullptr, "journal"); // Flash programming waits behind everything else
+
+void journal_start(void) {
+  if (flash.init() != 0) {
+    return; // Journal stays RAM only
+  }
+  uint32_t flash_end = flash.get_flash_start() + flash.get_flash_size();
+  sector_size = flash.get_sector_size(flash_end - 1);
+  if (flash.get_page_size() > sizeof(JournalRecord) || sizeof(JournalRecord) % flash.get_page_size()) {
+    return; // Records must be whole program units
+  }
+  region_start = flash_end - JOURNAL_FLASH_SECTORS * sector_size;
+  slot_count = JOURNAL_FLASH_SECTORS * sector_size / sizeof(JournalRecord);
+  find_write_slot();
+  flash_ready = 1;
+  writer_slot = profile_slot("journal", PROFILE_THREAD);
+  writer_thread.start(&journal_writer);
+}
+
+void journal_log(int type, int source, int mode) {
+  uint32_t now_ms = Kernel::Clock::now().time_since_epoch().count();
+  core_util_critical_section_enter(); // Callers are threads and ISRs
+  if (ring_head - ring_tail == JOURNAL_RAM_RECORDS) {
+    dropped++; // Keep the older records, they have not been written yet
+  } else {
+    JournalRecord &record = ring[ring_head & (JOURNAL_RAM_RECORDS - 1)];
+    record.time_ms = now_ms;
+    record.type = type;
+    record.source = source;
+    record.mode = mode;
+    record.marker = JOURNAL_MARKER;
+    ring_head++;
+  }
+  uint32_t waiting = ring_head - ring_tail;
+  core_util_critical_section_exit();
+  if (waiting == JOURNAL_BATCH_RECORDS && flash_ready) {
+    writer_thread.flags_set(FLAG_BATCH); // Only signal once per batch
+  }
+}
+
+void journal_flush(void) {
+  if (flash_ready) {
+    writer_thread.flags_set(FLAG_FLUSH);
+  }
+}
+
+uint32_t journal_dropped(void) { return dropped; }
+
+int journal_dump(void (*print_record)(const JournalRecord *record)) {
+  int count = 0;
+  if (flash_ready) {
+    // Flash is memory mapped, walk it directly starting at the erased gap in front of the newest record
+    const JournalRecord *slots = (const JournalRecord *)region_start;
+    for (uint32_t i = 0; i < slot_count; i++) {
+      const JournalRecord *record = &slots[(write_slot + i) % slot_count];
+      if (record->marker == JOURNAL_MARKER) {
+        print_record(record);
+        count++;
+      }
+    }
+  }
+  for (uint32_t i = ring_tail; i != ring_head; i++) { // Then the records still in RAM
+    JournalRecord record = ring[i & (JOURNAL_RAM_RECORDS - 1)];
+    print_record(&record);
+    count++;
+  }
+  return count;
+}
+
+static void journal_writer(void) {
+  while (1) {
+    // Full batches are written right away, partial ones when asked or after a quiet period
+    ThisThread::flags_wait_any_for(FLAG_BATCH | FLAG_FLUSH, std::chrono::milliseconds(JOURNAL_FLUSH_MS));
+    uint32_t start = profile_begin();
+    while (ring_head != ring_tail) {
+      write_batch();
+    }
+    profile_end(writer_slot, start);
+  }
+}
+
+static void write_batch(void) {
+  static JournalRecord batch[JOURNAL_BATCH_RECORDS]; // Program buffer, flash can not be written from the ring directly
+  uint32_t count = ring_head - ring_tail;
+  if (count > JOURNAL_BATCH_RECORDS) {
+    count = JOURNAL_BATCH_RECORDS;
+  }
+  uint32_t slots_per_sector = sector_size / sizeof(JournalRecord);
+  uint32_t sector_left = slots_per_sector - write_slot % slots_per_sector;
+  if (count > sector_left) {
+    count = sector_left; // A program call never crosses into the next sector
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    batch[i] = ring[(ring_tail + i) & (JOURNAL_RAM_RECORDS - 1)];
+  }
+  flash.program(batch, region_start + write_slot * sizeof(JournalRecord), count * sizeof(JournalRecord));
+  ring_tail += count; // Only the writer moves the tail, the slots are free once programmed
+
+  write_slot = (write_slot + count) % slot_count;
+  if (write_slot % slots_per_sector == 0) { // Reached the oldest sector, erase it to keep the gap
+    flash.erase(region_start + write_slot * sizeof(JournalRecord), sector_size);
+  }
+}
+
+static void find_write_slot(void) {
+  const JournalRecord *slots = (const JournalRecord *)region_start;
+  const uint8_t erased = flash.get_erase_value();
+  int written = 0;
+  int garbage = 0;
+  for (uint32_t i = 0; i < slot_count; i++) {
+    if (slots[i].marker == JOURNAL_MARKER) {
+      written++;
+    } else if (slots[i].marker != erased) {
+      garbage++;
+    }
+  }
+  if (garbage || written == (int)slot_count) { // Not a journal (first boot after other firmware), start clean
+    flash.erase(region_start, JOURNAL_FLASH_SECTORS * sector_size);
+    write_slot = 0;
+    return;
+  }
+  write_slot = 0;
+  for (uint32_t i = 0; i < slot_count; i++) { // Newest record is the one before the erased gap
+    uint32_t previous = (i + slot_count - 1) % slot_count;
+    if (slots[previous].marker == JOURNAL_MARKER && slots[i].marker != JOURNAL_MARKER) {
+      write_slot = i;
+      break;
+    }
+  }
+}
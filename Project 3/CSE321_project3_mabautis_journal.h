@@ -0,0 +1,58 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: Timestamped alarm event journal. Records go into a RAM ring buffer and a low
+ *               priority thread writes them to the end of internal flash in batches
+ *
+ * Modules:
+ *
+ * Subroutines:
+ * void journal_start(void) - Finds the newest record in flash and starts the writer thread
+ * void journal_log(int type, int source, int mode) - Adds a record to the RAM ring (ISR safe, no flash access)
+ * void journal_flush(void) - Asks the writer to write the records it has, even if a batch is not full
+ * int journal_dump(void (*print_record)(const JournalRecord *record)) - Passes every record, oldest first, to print_record
+ * uint32_t journal_dropped(void) - Records lost because the RAM ring was full
+ *
+ * Assignment: Project 3
+ * Inputs:
+ * Outputs:
+ *      Last JOURNAL_FLASH_SECTORS sectors of internal flash
+ * Constraints:
+ *      The flash program unit must divide sizeof(JournalRecord) (8 bytes on the STM32L4)
+ *      Timestamps are ms since boot, a JOURNAL_BOOT record separates boots
+ * References:
+ *      MBED FlashIAP - https://os.mbed.com/docs/mbed-os/v6.15/apis/flash-iap.html
+ */
+#ifndef CSE321_PROJECT3_MABAUTIS_JOURNAL_H
+#define CSE321_PROJECT3_MABAUTIS_JOURNAL_H
+
+#include <stdint.h>
+
+#define JOURNAL_RAM_RECORDS 64     // RAM ring size, power of two
+#define JOURNAL_BATCH_RECORDS 32   // Records written to flash in one program call (256 bytes)
+#define JOURNAL_FLASH_SECTORS 4    // Flash sectors the journal rotates through
+#define JOURNAL_FLUSH_MS 5000      // A partial batch is written after this long without a full one
+#define JOURNAL_SOURCE_ZONE 0x80   // Source bit for sensor zones, the low bits are the zone number
+
+enum JournalType {
+  JOURNAL_BOOT = 0,         // System started
+  JOURNAL_STATE = 1,        // Alarm state changed, mode is the new state
+  JOURNAL_PASSCODE_BAD = 2, // Wrong passcode entered
+  JOURNAL_TYPE_COUNT
+};
+
+struct JournalRecord {
+  uint32_t time_ms; // ms since boot
+  uint8_t type;     // JournalType
+  uint8_t source;   // Input that caused the record (AlarmEvent)
+  uint8_t mode;     // Alarm state after the record
+  uint8_t marker;   // JOURNAL_MARKER once written, erased flash reads 0xFF
+};
+
+void journal_start(void); // Finds the newest record in flash and starts the writer thread
+void journal_log(int type, int source, int mode); // Adds a record to the RAM ring (ISR safe, no flash access)
+void journal_flush(void); // Asks the writer to write the records it has, even if a batch is not full
+int journal_dump(void (*print_record)(const JournalRecord *record)); // Passes every record, oldest first, to print_record
+uint32_t journal_dropped(void); // Records lost because the RAM ring was full
+
+#endif
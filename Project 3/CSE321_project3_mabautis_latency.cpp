@@ -0,0 +1,93 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: Latency statistics (min/avg/max/percentile) kept in a fixed size log histogram
+ *
+ * Modules:
+ *
+ * Subroutines:
+ * void latency_reset(LatencyStats *stats) - Forgets every sample
+ * void latency_add(LatencyStats *stats, uint32_t us) - Adds one latency sample
+ * uint32_t latency_avg(const LatencyStats *stats) - Mean of the samples in us
+ * uint32_t latency_percentile(const LatencyStats *stats, uint32_t percent) - Upper bound of the given percentile in us
+ * int bucket_of(uint32_t us) - Histogram bucket of a sample
+ * uint32_t bucket_top(int bucket) - Largest sample that falls in a bucket
+ *
+ * Assignment: Project 3
+ * Inputs:
+ * Outputs:
+ * Constraints:
+ *      Percentiles come from histogram buckets 1/8 of a power of two wide, so they are rounded up by at most 12.5%
+ *      Samples over LATENCY_MAX_US land in the last bucket (max_us is still exact)
+ * References:
+ */
+#include "CSE321_project3_mabautis_latency.h"
+
+// Samples under 8us get a bucket each. Above that every power of two is split into 8 buckets:
+// bucket = 8 + 8 * (log2(us) - 3) + next 3 bits of us
+static int bucket_of(uint32_t us) {
+  if (us < LATENCY_SUB_BUCKETS) {
+    return us;
+  }
+  int exponent = 31 - __builtin_clz(us);
+  int bucket = LATENCY_SUB_BUCKETS * (exponent - 2) + ((us >> (exponent - 3)) & (LATENCY_SUB_BUCKETS - 1));
+  return bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1;
+}
+
+static uint32_t bucket_top(int bucket) {
+  if (bucket < LATENCY_SUB_BUCKETS) {
+    return bucket;
+  }
+  int exponent = bucket / LATENCY_SUB_BUCKETS + 2;
+  uint32_t step = 1u << (exponent - 3);
+  return (1u << exponent) + (bucket % LATENCY_SUB_BUCKETS + 1) * step - 1;
+}
+
+void latency_reset(LatencyStats *stats) {
+  stats->count = 0;
+  stats->min_us = UINT32_MAX;
+  stats->max_us = 0;
+  stats->total_us = 0;
+  for (int i = 0; i < LATENCY_BUCKETS; i++) {
+    stats->buckets[i] = 0;
+  }
+}
+
+void latency_add(LatencyStats *stats, uint32_t us) {
+  uint16_t &bucket = stats->buckets[bucket_of(us)];
+  if (bucket == UINT16_MAX) {
+    return; // Saturated, keep the histogram consistent with count
+  }
+  bucket++;
+  stats->count++;
+  stats->total_us += us;
+  if (us < stats->min_us) {
+    stats->min_us = us;
+  }
+  if (us > stats->max_us) {
+    stats->max_us = us;
+  }
+}
+
+uint32_t latency_avg(const LatencyStats *stats) {
+  return stats->count ? stats->total_us / stats->count : 0;
+}
+
+uint32_t latency_percentile(const LatencyStats *stats, uint32_t percent) {
+  if (!stats->count) {
+    return 0;
+  }
+  uint32_t needed = (stats->count * (uint64_t)percent + 99) / 100; // Samples at or under the percentile
+  uint32_t seen = 0;
+  for (int i = 0; i < LATENCY_BUCKETS; i++) {
+    seen += stats->buckets[i];
+    if (seen >= needed) {
+      if (i == LATENCY_BUCKETS - 1) {
+        return stats->max_us; // Overflow bucket has no upper bound of its own
+      }
+      uint32_t top = bucket_top(i);
+      return top < stats->max_us ? top : stats->max_us; // Never report more than was seen
+    }
+  }
+  return stats->max_us;
+}
@@ -0,0 +1,45 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: Latency statistics (min/avg/max/percentile) kept in a fixed size log histogram
+ *
+ * Modules:
+ *
+ * Subroutines:
+ * void latency_reset(LatencyStats *stats) - Forgets every sample
+ * void latency_add(LatencyStats *stats, uint32_t us) - Adds one latency sample
+ * uint32_t latency_avg(const LatencyStats *stats) - Mean of the samples in us
+ * uint32_t latency_percentile(const LatencyStats *stats, uint32_t percent) - Upper bound of the given percentile in us
+ *
+ * Assignment: Project 3
+ * Inputs:
+ * Outputs:
+ * Constraints:
+ *      Percentiles come from histogram buckets 1/8 of a power of two wide, so they are rounded up by at most 12.5%
+ *      Samples over LATENCY_MAX_US land in the last bucket (max_us is still exact)
+ *      Header has no mbed dependencies so host tools can use the statistics without the emulator
+ * References:
+ */
+#ifndef CSE321_PROJECT3_MABAUTIS_LATENCY_H
+#define CSE321_PROJECT3_MABAUTIS_LATENCY_H
+
+#include <stdint.h>
+
+#define LATENCY_SUB_BUCKETS 8 // Buckets per power of two
+#define LATENCY_BUCKETS 128   // Covers 0 - LATENCY_MAX_US
+#define LATENCY_MAX_US 262143 // Largest sample with its own bucket (~262ms)
+
+struct LatencyStats {
+  uint32_t count;                      // Samples added
+  uint32_t min_us;                     // Smallest sample
+  uint32_t max_us;                     // Largest sample
+  uint64_t total_us;                   // Sum of samples for the mean
+  uint16_t buckets[LATENCY_BUCKETS];   // Log histogram of the samples
+};
+
+void latency_reset(LatencyStats *stats); // Forgets every sample
+void latency_add(LatencyStats *stats, uint32_t us); // Adds one latency sample
+uint32_t latency_avg(const LatencyStats *stats); // Mean of the samples in us
+uint32_t latency_percentile(const LatencyStats *stats, uint32_t percent); // Upper bound of the given percentile in us
+
+#endif
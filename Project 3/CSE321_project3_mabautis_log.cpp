@@ -0,0 +1,116 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: Deferred logging. A log call stores its format string pointer and arguments in a
+ *               lock-free RAM ring and a low priority thread formats and prints them later
+ *
+ * Modules:
+ *      CSE321_project3_mabautis_memory - Formatter thread stack size
+ *      CSE321_project3_mabautis_profile - CPU time of the formatter
+ *
+ * Subroutines:
+ * void log_start(void) - Starts the formatter thread
+ * void log_push(int level, const char *format, const uintptr_t *args, int count) - Adds a message to the ring (ISR safe)
+ * uint32_t log_dropped(void) - Messages lost because the ring was full
+ * void log_formatter(void) - Formatter thread, prints every published message then sleeps LOG_PERIOD_MS
+ * void print_record(const LogRecord *record) - Formats one message into a line and prints it
+ *
+ * Assignment: Project 3
+ * Inputs:
+ * Outputs:
+ *      stdout, one "<s.ms since boot> <E|W|I|D> <message>" line per message (us ticker, wraps after ~71 minutes)
+ * Constraints:
+ *      log_push never blocks or locks: a producer claims an entry by moving ring_head with a compare
+ *      and swap, fills it, then publishes it by writing its sequence number. ISRs that preempt a
+ *      producer claim the next entry, the formatter stops at an entry that is claimed but not yet
+ *      published and picks it up on its next pass
+ *      A full ring drops the new message, the count is printed by the formatter
+ *      The formatter polls instead of being signalled so a log call stays a few dozen cycles
+ * References:
+ *      Bounded MPMC queue - https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+ *      MBED atomics - https://os.mbed.com/docs/mbed-os/v6.15/mbed-os-api-doxy/mbed__atomic_8h.html
+ */
+#include "CSE321_project3_mabautis_log.h"
+#include "CSE321_project3_mabautis_memory.h"
+#include "CSE321_project3_mabautis_profile.h"
+#include <cstdio>
+#include <mbed.h>
+
+struct LogRecord {
+  const char *format;       // printf format, only the pointer is kept
+  uintptr_t args[LOG_ARGS]; // Arguments as printf words
+  uint32_t time_us;         // us_ticker_read() when the message was logged
+  uint32_t level;           // LOG_LEVEL_*
+  uint32_t sequence;        // Claiming head + 1 once the entry is filled, the formatter waits for it
+};
+
+static void log_formatter(void); // Formatter thread, prints every published message then sleeps LOG_PERIOD_MS
+static void print_record(const LogRecord *record); // Formats one message into a line and prints it
+
+static LogRecord ring[LOG_RECORDS]; // Messages not yet printed
+static volatile uint32_t ring_head = 0; // Next entry to claim (free running, masked on use)
+static volatile uint32_t ring_tail = 0; // Oldest entry not yet printed, only the formatter moves it
+static volatile uint32_t dropped = 0; // Messages lost to a full ring
+static uint32_t dropped_reported = 0; // Dropped count already printed
+static const char level_letters[] = "-EWID"; // Indexed by level
+static int formatter_slot = -1; // Profiler slot of the formatter
+
+static Thread formatter_thread(osPriorityLow, LOG_STACK_SIZE, nullptr, "log"); // Behind every other thread
+
+void log_start(void) {
+  formatter_slot = profile_slot("log", PROFILE_THREAD);
+  formatter_thread.start(&log_formatter);
+}
+
+void log_push(int level, const char *format, const uintptr_t *args, int count) {
+  uint32_t now = us_ticker_read();
+  uint32_t head = core_util_atomic_load_u32(&ring_head);
+  do {
+    if (head - core_util_atomic_load_u32(&ring_tail) >= LOG_RECORDS) {
+      core_util_atomic_incr_u32(&dropped, 1); // Keep the older messages, they have not been printed yet
+      return;
+    }
+  } while (!core_util_atomic_cas_u32(&ring_head, &head, head + 1)); // A failed swap reloads head
+  LogRecord &record = ring[head & (LOG_RECORDS - 1)];
+  record.format = format;
+  for (int i = 0; i < count; i++) {
+    record.args[i] = args[i];
+  }
+  record.time_us = now;
+  record.level = level;
+  core_util_atomic_store_u32(&record.sequence, head + 1); // Published, the barrier orders the stores above
+}
+
+uint32_t log_dropped(void) { return dropped; }
+
+static void log_formatter(void) {
+  while (1) {
+    uint32_t start = profile_begin();
+    uint32_t tail = ring_tail;
+    while (tail != core_util_atomic_load_u32(&ring_head)) {
+      LogRecord &entry = ring[tail & (LOG_RECORDS - 1)];
+      if (core_util_atomic_load_u32(&entry.sequence) != tail + 1) {
+        break; // Claimed but not filled yet, the producer was preempted
+      }
+      LogRecord record = entry;
+      core_util_atomic_store_u32(&ring_tail, ++tail); // Free the entry before the slow printf
+      print_record(&record);
+    }
+    uint32_t lost = dropped - dropped_reported;
+    if (lost) {
+      dropped_reported += lost;
+      printf("%lu log messages dropped\n", (unsigned long)lost);
+    }
+    profile_end(formatter_slot, start);
+    ThisThread::sleep_for(std::chrono::milliseconds(LOG_PERIOD_MS));
+  }
+}
+
+static void print_record(const LogRecord *record) {
+  char line[LOG_LINE_BYTES];
+  int length = snprintf(line, sizeof(line), "%lu.%03lu %c ", (unsigned long)(record->time_us / 1000000),
+                        (unsigned long)(record->time_us / 1000 % 1000), level_letters[record->level]);
+  snprintf(line + length, sizeof(line) - length, record->format, record->args[0], record->args[1], record->args[2],
+           record->args[3]); // Unused words are ignored by printf
+  puts(line); // One call, so other threads' output can not land inside the line
+}
@@ -0,0 +1,86 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: Deferred logging. A log call stores its format string pointer and arguments in a
+ *               lock-free RAM ring and a low priority thread formats and prints them later
+ *
+ * Modules:
+ *
+ * Subroutines:
+ * LOG_ERROR(format, ...), LOG_WARN(format, ...), LOG_INFO(format, ...), LOG_DEBUG(format, ...) - Log
+ * at a level, compiled out (arguments not evaluated) above MBED_CONF_APP_LOG_LEVEL
+ * void log_start(void) - Starts the formatter thread
+ * void log_write(int level, const char *format, Args... args) - Logs without the level check (ISR safe)
+ * void log_push(int level, const char *format, const uintptr_t *args, int count) - Adds a message to the ring (ISR safe)
+ * uint32_t log_dropped(void) - Messages lost because the ring was full
+ *
+ * Assignment: Project 3
+ * Inputs:
+ * Outputs:
+ *      stdout, one "<s.ms since boot> <E|W|I|D> <message>" line per message (us ticker, wraps after ~71 minutes)
+ * Constraints:
+ *      The format and every %s argument must be string literals or other strings that outlive the
+ *      message, only their pointers are stored
+ *      At most LOG_ARGS integer, char or pointer arguments. Floating point does not compile
+ *      Messages longer than LOG_LINE_BYTES are cut
+ * References:
+ *      Bounded MPMC queue - https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+ */
+#ifndef CSE321_PROJECT3_MABAUTIS_LOG_H
+#define CSE321_PROJECT3_MABAUTIS_LOG_H
+
+#include <stdint.h>
+#include <type_traits>
+
+#define LOG_LEVEL_OFF 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef MBED_CONF_APP_LOG_LEVEL
+#define MBED_CONF_APP_LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+#define LOG_RECORDS 64     // RAM ring size, power of two
+#define LOG_ARGS 4         // Arguments stored per message
+#define LOG_PERIOD_MS 20   // Formatter wake up period
+#define LOG_LINE_BYTES 96  // Longest printed line
+
+#if MBED_CONF_APP_LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) log_write(LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) ((void)0)
+#endif
+#if MBED_CONF_APP_LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(...) log_write(LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define LOG_WARN(...) ((void)0)
+#endif
+#if MBED_CONF_APP_LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(...) log_write(LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define LOG_INFO(...) ((void)0)
+#endif
+#if MBED_CONF_APP_LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) log_write(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) ((void)0)
+#endif
+
+void log_start(void); // Starts the formatter thread
+void log_push(int level, const char *format, const uintptr_t *args, int count); // Adds a message to the ring (ISR safe)
+uint32_t log_dropped(void); // Messages lost because the ring was full
+
+template <typename T> inline uintptr_t log_arg(T value) {
+  static_assert(!std::is_floating_point<T>::value, "log arguments are integers, chars and pointers");
+  return (uintptr_t)value; // Passed to printf as one word, like the int or pointer it was
+}
+
+template <typename... Args> inline void log_write(int level, const char *format, Args... args) {
+  static_assert(sizeof...(Args) <= LOG_ARGS, "too many log arguments");
+  const uintptr_t values[LOG_ARGS + 1] = {log_arg(args)...}; // +1 so a message without arguments has an array
+  log_push(level, format, values, sizeof...(Args));
+}
+
+#endif
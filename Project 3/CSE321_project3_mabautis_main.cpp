@@ -8,25 +8,83 @@
  * the RCC and GPIO pins and code to write to MODER
  *      CSE321_project2_mabautis_lcd1602 - Contains intiialization and operation
  * code for a 1602 LCD
+ *      CSE321_project3_mabautis_siren - TIM4 PWM + DMA siren and strobe with
+ * escalating phases
+ *      CSE321_project3_mabautis_sensors - Zone registry and scheduler shared by
+ * every sensor
+ *      CSE321_project3_mabautis_ultrasonic - HC-SR04 zone driver, measures the
+ * echo pulse width and converts it to a distance
+ *      CSE321_project3_mabautis_filter - Integer sensor filters used to confirm
+ * a sensor trip over several readings
+ *      CSE321_project3_mabautis_mic_adc - Samples the microphone with ADC1 + DMA
+ * and reports block loudness
+ *      CSE321_project3_mabautis_alarm_fsm - Table driven state machine for the
+ * alarm modes
+ *      CSE321_project3_mabautis_journal - Timestamped event journal kept in a
+ * RAM ring and written to flash in batches
+ *      CSE321_project3_mabautis_console - Runs serial commands from a table
+ *      CSE321_project3_mabautis_latency - Min/avg/max/percentile latency
+ * statistics
+ *      CSE321_project3_mabautis_passcode - Fixed capacity passcode with a
+ * constant time compare
+ *      CSE321_project3_mabautis_memory - Stack, heap and queue usage report and
+ * stack sizes from measured peaks
+ *      CSE321_project3_mabautis_queues - High priority alarm queue and low
+ * priority UI queue
+ *      CSE321_project3_mabautis_trace - RAM ring of timestamped inputs for
+ * replay on the host
+ *      CSE321_project3_mabautis_bench - Times a benchmark table with the DWT
+ * cycle counter and prints CSV
+ *      CSE321_project3_mabautis_profile - DWT cycles, calls and worst case of
+ * every ISR, thread loop and queued event
+ *      CSE321_project3_mabautis_telemetry - Binary records of keys, state
+ * changes and trips sent COBS framed on USART3
+ *      CSE321_project3_mabautis_log - Deferred log messages with compile time
+ * levels, formatted by a low priority thread
+ *      CSE321_project3_mabautis_vectors - Known-answer vectors run by the
+ * benchmark build before the benchmarks
  *
  * Subroutines:
  * isr_col(void) - Rising edge Interrupt Service Routine for column pins [PF_14, PE_11, PE_9, PF_13]
  * isr_falling_edge(void) - Falling edge Interrupt Service Routine for column pins [PF_14, PE_11, PE_9, PF_13]
- * isr_microphone(void) - Rising edge ISR for micrphone PD_7
- * isr_ultrasonic(void) - Rising edge ISR for ultrasonic sensor echo pin PD_5
- * isr_ultrasonic_falling_edge(void) - Falling edge ISR for ultrasonic echo pin 
- * ultrasonic_handler(void) - Handler after timeout is reached to see if object is within specified range
- * trigger_ultrasonic_sensor(void) - Send 10us pulse to ultrasonic trigger pin
- * microphone_handler(void) - Handles switching to triggered mode if sound is detected
+ * zone_trip_isr(int zone) - Called by the zone registry from interrupt context when an armed zone trips
+ * zone_tripped(int zone, uint32_t trip_us) - Sends the tripped zone's sensor event to the state machine and records the queue and lock latency
  * row_handler(void) - Thread callback that handles the powering of rows on the matrix keypad
- * key_handler(void) - Thread callback that handles key presses based on current system mode
- * power_on_mode(void) - Initial power on state where passcode is defined
- * unarmed_mode(void) - Unarmed state where sensors do not trigger the system
- * armed_mode(void) - Armed state (after entering passcode in unarmed mode) where sensors trigger the system
- * triggered_mode(void) - State when a sensor is tripped in the armed state
- * trigger_mode_transition(void) - Used to call blocking code from ultrasonic ISR when motion detected
+ * select_row(int row) - Powers one keypad row and turns the others off, one write_to_pin per row pin
+ * key_handler(void) - Thread callback that debounces key presses and sends them to the state machine
  * idle_timeout_handler(void) - Timeout handler after 10 seconds has passed without system input
- * set_display_off(void) - Calls blocking code from idle timeout to set the display off and reset LCD text
+ * set_display_off(void) - Sends the idle event to the state machine from the UI queue
+ * dispatch_event(int event, char key) - Runs an event through the state machine under the alarm lock and records its latency
+ * alarm_lock_take(void) - Takes alarm_lock, the outermost take starts timing the hold
+ * alarm_lock_give(void) - Gives alarm_lock back, the outermost give records the hold time
+ * run_action(int action, char key) - Runs the action of a state machine transition
+ * show_prompt(void) - Posts a redraw of the current state's prompt to the UI queue
+ * show_message(const char *line_0, const char *line_1, int duration_ms) - Posts a message to the UI queue, the prompt comes back after the duration
+ * show_entry_prompt(void) - Posts the passcode entry prompt to the UI queue
+ * show_digit(void) - Posts a passcode star to the UI queue
+ * set_backlight(int on) - Posts a backlight change to the UI queue
+ * lcd_start(void) - First UI queue event, initializes the LCD while the sensors and keypad are already running
+ * draw_prompt(void), draw_message(...), draw_entry_prompt(void), draw_digit(void), draw_backlight(int on) - UI queue handlers that write the LCD
+ * cancel_message(void) - Drops the pending prompt restore when something else takes over the LCD
+ * restore_prompt(void) - UI queue timer callback that puts the prompt back after a message
+ * enter_power_on(void), enter_unarmed(void), enter_armed(void), enter_triggered(void) - State entry actions
+ * exit_triggered(void) - State exit action that silences the alarm
+ * sensors_follow_state(void) - Sets the ping rate and clears sensor confirmations for the new state
+ * print_journal(const char *args) - Console command that dumps the event journal
+ * print_zones(const char *args) - Console command that lists the zones
+ * print_latency(const char *args) - Console command that prints the trip latency of each stage ("latency reset" clears it)
+ * print_memory(const char *args) - Console command that prints stack, heap and queue usage
+ * print_trace(const char *args) - Console command that dumps, starts or stops the input trace
+ * print_profile(const char *args) - Console command that prints the CPU time of every profiled ISR, thread and event
+ * print_boot(const char *args) - Console command that prints when each boot stage finished
+ * set_zone(const char *args) - Console command that arms or bypasses a zone ("zone 1 off")
+ * set_range(const char *args) - Console command that prints or sets the sonar trigger distance ("range 300")
+ * set_mic(const char *args) - Console command that prints the microphone level or sets its loud threshold ("mic 500")
+ * print_journal_record(const JournalRecord *record) - Prints one journal record
+ * print_trace_record(uint64_t time_us, const TraceRecord *record) - Prints one trace record in the replay format
+ * start_alarm_outputs(void) - Starts the siren and strobe at the entry phase
+ * stop_alarm_outputs(void) - Stops the siren and strobe
+ * bench_*(int i) - Benchmark build only, the timed calls and setups of the benchmark table
  *
  * Assignment: Project 3
  *
@@ -35,9 +93,10 @@
  * Microphone - Used to determine nearby sounds
  * 4x4 Matrix Keypad - Prvoides user input to system
  * Outputs:
- * LEDs - Used to indicate when the system is in the triggered state
- * Active Buzzer - Used to provide auditory indication when the system is in the triggered state
+ * LEDs - Used to indicate when the system is in the triggered state (PD_15, TIM4_CH4)
+ * Active Buzzer - Used to provide auditory indication when the system is in the triggered state (PD_14, TIM4_CH3)
  * 1602 LCD - Provides visual prompts for users
+ * Telemetry - Binary record stream for a USB-UART adapter (PB_10, USART3 TX, 921600 baud)
  *
  * Constraints:
  *
@@ -54,9 +113,26 @@
 #include "mbed_thread.h"
 #include <CSE321_project3_mabautis_lcd1602.h>
 #include <CSE321_project3_mabautis_stm_methods.h>
+#include <CSE321_project3_mabautis_siren.h>
+#include <CSE321_project3_mabautis_sensors.h>
+#include <CSE321_project3_mabautis_ultrasonic.h>
+#include <CSE321_project3_mabautis_filter.h>
+#include <CSE321_project3_mabautis_mic_adc.h>
+#include <CSE321_project3_mabautis_alarm_fsm.h>
+#include <CSE321_project3_mabautis_journal.h>
+#include <CSE321_project3_mabautis_console.h>
+#include <CSE321_project3_mabautis_latency.h>
+#include <CSE321_project3_mabautis_passcode.h>
+#include <CSE321_project3_mabautis_memory.h>
+#include <CSE321_project3_mabautis_queues.h>
+#include <CSE321_project3_mabautis_trace.h>
+#include <CSE321_project3_mabautis_bench.h>
+#include <CSE321_project3_mabautis_profile.h>
+#include <CSE321_project3_mabautis_telemetry.h>
+#include <CSE321_project3_mabautis_log.h>
+#include <CSE321_project3_mabautis_vectors.h>
 #include <cstdio>
 #include <mbed.h>
-#include <string>
 #include <time.h>
 
 void isr_col(void); // Rising edge Interrupt Service Routine for column pins
@@ -64,38 +140,89 @@ void isr_col(void); // Rising edge Interrupt Service Routine for column pins
 void isr_falling_edge(void); // Falling edge Interrupt Service Routine for
                              // column pins [PF_14, PE_11, PE_9, PF_13]
 
-void isr_microphone(void); // Rising edge ISR for micrphone PD_7
-
-void isr_ultrasonic(void); // Rising edge ISR for ultrasonic sensor echo pin PD_5
-void isr_ultrasonic_falling_edge(void); // Falling edge ISR for ultrasonic echo pin 
-
-void ultrasonic_handler(void); // Handler after timeout is reached to see if object is within specified range
-void trigger_ultrasonic_sensor(void); // Send 10us pulse to ultrasonic trigger pin
-
-void microphone_handler(void); // Handles switching to triggered mode if sound is detected
+void zone_trip_isr(int zone); // Called by the zone registry from interrupt context when an armed zone trips
+void zone_tripped(int zone, uint32_t trip_us); // Sends the tripped zone's sensor event to the state machine and records the queue and lock latency
 
 void row_handler(void); // Thread callback that handles the powering of rows on the matrix keypad
-void key_handler(void); // Thread callback that handles key presses based on current system mode
-
-void power_on_mode(void); // Initial power on state where passcode is defined
-void unarmed_mode(void); // Unarmed state where sensors do not trigger the system
-void armed_mode(void); // Armed state (after entering passcode in unarmed mode) where sensors trigger the system
-void triggered_mode(void); // State when a sensor is tripped in the armed state
-void trigger_mode_transition(void); // Used to call blocking code from ultrasonic ISR when motion detected
+void key_handler(void); // Thread callback that debounces key presses and sends them to the state machine
+void select_row(int row); // Powers one keypad row and turns the others off, one write_to_pin per row pin
 
 void idle_timeout_handler(void); // Timeout handler after 10 seconds has passed without system input
-void set_display_off(void); // Calls blocking code from idle timeout to set the display off and reset LCD text
+void set_display_off(void); // Sends the idle event to the state machine from the UI queue
+
+void dispatch_event(int event, char key); // Runs an event through the state machine under the alarm lock and records its latency
+void alarm_lock_take(void); // Takes alarm_lock, the outermost take starts timing the hold
+void alarm_lock_give(void); // Gives alarm_lock back, the outermost give records the hold time
+void run_action(int action, char key); // Runs the action of a state machine transition
+
+// Display requests, safe from any thread. The LCD is only written by the UI queue handlers below
+void show_prompt(void); // Posts a redraw of the current state's prompt to the UI queue
+void show_message(const char *line_0, const char *line_1, int duration_ms); // Posts a message to the UI queue, the prompt comes back after the duration
+void show_entry_prompt(void); // Posts the passcode entry prompt to the UI queue
+void show_digit(void); // Posts a passcode star to the UI queue
+void set_backlight(int on); // Posts a backlight change to the UI queue
+
+// UI queue handlers
+void lcd_start(void); // Initializes the LCD, queued before any draw so prompts posted during the init wait for it
+void draw_prompt(void); // Clears the LCD and prints the prompt of the current state
+void draw_message(const char *line_0, const char *line_1, int duration_ms); // Prints a message and starts the prompt restore timer
+void draw_entry_prompt(void); // Prints the passcode entry prompt
+void draw_digit(void); // Prints a passcode star
+void draw_backlight(int on); // Turns the LCD backlight on or off
+void cancel_message(void); // Drops the pending prompt restore when something else takes over the LCD
+void restore_prompt(void); // UI queue timer callback that puts the prompt back after a message
+
+// State entry and exit actions
+void enter_power_on(void);
+void enter_unarmed(void);
+void enter_armed(void);
+void enter_triggered(void);
+void exit_triggered(void);
+void sensors_follow_state(void); // Sets the ping rate and clears sensor confirmations for the new state
+
+void print_journal(const char *args); // Console command that dumps the event journal
+void print_zones(const char *args); // Console command that lists the zones
+void print_latency(const char *args); // Console command that prints the trip latency of each stage ("latency reset" clears it)
+void print_memory(const char *args); // Console command that prints stack, heap and queue usage
+void print_trace(const char *args); // Console command that dumps, starts or stops the input trace ("trace start")
+void print_profile(const char *args); // Console command that prints the CPU time of every profiled ISR, thread and event
+void print_boot(const char *args); // Console command that prints when each boot stage finished
+void set_zone(const char *args); // Console command that arms or bypasses a zone ("zone 1 off")
+void set_range(const char *args); // Console command that prints or sets the sonar trigger distance ("range 300")
+void set_mic(const char *args); // Console command that prints the microphone level or sets its loud threshold ("mic 500")
+void print_journal_record(const JournalRecord *record); // Prints one journal record
+void print_trace_record(uint64_t time_us, const TraceRecord *record); // Prints one trace record in the replay format
+
+void start_alarm_outputs(void); // Starts the siren and strobe at the entry phase
+void stop_alarm_outputs(void); // Stops the siren and strobe
+
+#if MBED_CONF_APP_BENCH
+void bench_lcd_print(int i); // Prints a full 16 character line
+void bench_lcd_clear(int i);
+void bench_lcd_set_cursor(int i); // Moves the cursor across both rows
+void bench_home_cursor(int i); // Setup, every print starts at the left of row 0
+void bench_keypad_scan(int i); // Powers each row in turn and reads the four columns
+void bench_rows_write_to_pin(int i); // One row change the way row_handler does it
+void bench_rows_bsrr(int i); // Same row change as one BSRR write per port
+void bench_telemetry_log(int i); // One telemetry record into the ring, the sender is not running
+void bench_log_write(int i); // One log message with two arguments into the ring, the formatter is not running
+void bench_enter_passcode(int start_entry); // Sends the passcode keys through dispatch_event, with A first if start_entry
+void bench_enter_state(int state); // Boots the state machine again and walks it to a state, draws included
+void bench_power_on(int i), bench_unarmed(int i), bench_armed(int i), bench_triggered(int i); // Setups for each mode
+void bench_set_passcode(int i); // Timed power on passcode entry
+void bench_passcode_entry(int i); // Timed A + passcode entry in the other modes
+#endif
 
 const uint32_t TIMEOUT_MS = 5000; // Watchdog timeout before triggering system reset
+const int INCORRECT_MESSAGE_MS = 2000; // Time the incorrect passcode message stays up
+const int KEYPAD_POLL_MS = 1; // Row and key threads sleep this long per loop, spinning starved every lower priority thread
 
 int key_pressed = 0; // Determines if key is pressed (toggled by keypad ISRs)
 int debounced = 0; // Determines if a key press is valid after debouncing it
 int display_on = 1; // Flag to determine LCD state
-volatile int echo_on = 0; // Determines if the echo pin is high or low (can change while thread is going to access it)
 
-string password = "****"; // Passcode entered on system boot
-string password_entered = "****"; // Passcode entered when attempting to switch between system modes
-int password_position = 0; // Flag to determine which digit is being entered
+Passcode password; // Passcode entered on system boot
+Passcode password_entered; // Passcode entered when attempting to switch between system modes
 int entering_password = 0; // Flag to determine if a passcode is being entered
 
 CSE321_LCD LCD(16, 2, LCD_5x8DOTS, PB_9, PB_8); // Initialize LCD
@@ -107,46 +234,164 @@ InterruptIn col_1(PE_11, PullDown);
 InterruptIn col_2(PE_9, PullDown);
 InterruptIn col_3(PF_13, PullDown);
 
-InterruptIn microphone(PD_7, PullDown); // Initialize microphone Dout as an interrupt
-InterruptIn ultrasonic_echo(PD_5, PullDown); // Initialize ultrasonic sensor echo as an interrupt
-
-DigitalOut ultrasonic_trigger(PD_6); // Set ultrasonic trigger as a digit output
-DigitalOut active_buzzer(PD_4); // Set active buzzer as a digit output
-DigitalOut microphone_enable(PF_12); // Set pin going to microphone AND Gate as a digit output to enable and disable the mic interrupt pin
-DigitalOut alarm_leds(PD_15); // Set LEDs as a digital output
-
-Thread row_thread; // Declare thread handling keypad rows
-Thread key_thread; // Declare thread maintaining system modes
-
-Mutex resource_lock; // Declare mutex to maintain thread sychronization and protect against race conditions
-
-EventQueue queue; // Initialize EventQueue to queue blocking code from ISR
+// Siren steps while triggered {period, buzzer on, strobe on} in ms. The siren escalates on its own
+const SirenStep entry_steps[] = {{1000, 100, 500}}; // Chirp once a second, slow LED pulse
+const SirenStep alarm_steps[] = {{400, 200, 50}, {300, 150, 50}, {200, 100, 50}, {150, 75, 50}, {100, 50, 50}}; // Beeps sweep faster, strobe on every beep
+const SirenStep alert_steps[] = {{100, 100, 30}}; // Buzzer held on, 10Hz strobe
+const SirenPhase alarm_phases[] = {
+    {entry_steps, 1, 10000},         // Entry: 10s to enter the passcode
+    {alarm_steps, 5, 60000},         // Alarm: full siren for a minute
+    {alert_steps, 1, SIREN_FOREVER}, // Alert: until disarmed
+};
+
+// Sensor zones, one line per sensor. PIR and contact inputs use &contact_sensor
+const Zone zones[] = {
+    {"Ultrasonic", &ultrasonic_sensor, PD_5, PD_6}, // Echo, trigger
+    {"Microphone", &microphone_sensor, NC, NC},     // ADC1 on PC_4
+};
+const int zone_events[SENSOR_KIND_COUNT] = {EVENT_ULTRASONIC, EVENT_MICROPHONE, EVENT_CONTACT}; // Alarm event for each sensor kind
+int tripped_zone = 0; // Last zone that tripped, shown while triggered
+
+// Trip latency, every stage is measured from the sensor ISR that confirmed the trip
+enum TripStage {
+  TRIP_QUEUE = 0,   // Queue handler started
+  TRIP_LOCK = 1,    // alarm_lock taken (only held while an event is dispatched)
+  TRIP_SIREN = 2,   // Siren timer started, buzzer and strobe on
+  TRIP_DISPLAY = 3, // "Triggered" frame written to the LCD
+  TRIP_STAGES
+};
+const char *const trip_stage_names[TRIP_STAGES] = {"queue", "lock", "siren", "display"};
+LatencyStats trip_latency[TRIP_STAGES]; // Written by the alarm queue and draw_prompt on main, reset and read by the console, always under alarm_lock
+uint32_t trip_us = 0; // Time the trip being handled was confirmed
+volatile int trip_draw_pending = 0; // Set when the siren starts, cleared when the UI queue draws the "Triggered" frame
+
+// Boot stages in the order they come up. The LCD init sleeps over a second, so it runs last on the UI queue
+enum BootStage {
+  BOOT_SENSORS = 0,  // Zone interrupts enabled and the sensor scheduler ticking (first sense)
+  BOOT_KEYPAD = 1,   // Keypad interrupts and threads running
+  BOOT_WATCHDOG = 2, // Watchdog started
+  BOOT_LCD = 3,      // LCD initialized, queued prompts drawn after this
+  BOOT_STAGES
+};
+const char *const boot_stage_names[BOOT_STAGES] = {"sensors", "keypad", "watchdog", "lcd"};
+uint32_t boot_us[BOOT_STAGES]; // us_ticker_read() when each stage finished, the ticker starts at reset
+
+Thread row_thread(osPriorityNormal, ROW_STACK_SIZE, nullptr, "row"); // Declare thread handling keypad rows
+Thread key_thread(osPriorityNormal, KEY_STACK_SIZE, nullptr, "key"); // Declare thread maintaining system modes
+
+Mutex keypad_lock; // Row and key threads, the row must not change while a key is being read
+Mutex alarm_lock; // State machine, passcodes and alarm outputs. Never held across an LCD write or a sleep
+int alarm_lock_depth = 0; // Recursive takes by the owner, only the owner touches it
+uint32_t alarm_lock_taken_us = 0; // When the owner's outermost take got the lock
+uint32_t alarm_lock_hold_max_us = 0; // Longest alarm_lock hold by any thread since boot or latency reset
 
 Timeout idle_timeout; // Timeout to disable LCD backlight after 10 seconds
-Timeout ultrasonic_timeout; // Timeout to check if ultrasonic echo is still active to determine object distance 
 
-Ticker ultrasonic_ticker; // Ticker to trigger ultrasonic sensor pulses
+int message_event = 0; // UI queue id of the pending prompt restore (0 -> no message up), only used on the UI queue
 
 char keypad[4][4] = {{'1', '2', '3', 'A'},
                      {'4', '5', '6', 'B'},
                      {'7', '8', '9', 'C'},
                      {'*', '0', '#', 'D'}}; // Enumerate keypad matrix
 
-int mode = 0; // 0 -> Power On Mode (Define Code), 1 -> Unarmed, 2 -> Armed, 3
-              // -> Triggered
+// Prompt, entry and exit action of each state, indexed by AlarmState
+const StateInfo states[STATE_COUNT] = {
+    {"Set Passcode: ", &enter_power_on, nullptr},
+    {"Unarmed", &enter_unarmed, nullptr},
+    {"Armed", &enter_armed, nullptr},
+    {"Triggered", &enter_triggered, &exit_triggered},
+};
+
+uint32_t dispatch_last_us = 0; // Time taken by the last event dispatch
+uint32_t dispatch_max_us = 0; // Longest event dispatch since boot
+
+// Names used when printing the journal
+const char *const state_names[STATE_COUNT] = {"power on", "unarmed", "armed", "triggered"};
+const char *const source_names[EVENT_COUNT] = {"keypad", "keypad", "keypad", "keypad", "keypad",
+                                               "keypad", "microphone", "ultrasonic", "contact", "idle"};
+const char *const kind_names[SENSOR_KIND_COUNT] = {"ultrasonic", "microphone", "contact"};
+const char *const journal_type_names[JOURNAL_TYPE_COUNT] = {"boot", "state", "bad passcode"};
+const char *const trace_source_names[TRACE_SOURCE_COUNT] = {"key", "sonar", "mic"}; // Words of the replay format
+
+// Serial console commands
+const ConsoleCommand commands[] = {
+    {"journal", "Dump the alarm event journal", &print_journal},
+    {"zones", "List the sensor zones", &print_zones},
+    {"latency", "Trip to siren latency per stage: latency [reset]", &print_latency},
+    {"memory", "Thread stack peaks, heap and event queue usage", &print_memory},
+    {"zone", "Arm or bypass a zone: zone <n> on|off", &set_zone},
+    {"range", "Sonar trigger distance: range [mm]", &set_range},
+    {"mic", "Microphone level and loud threshold: mic [rms]", &set_mic},
+    {"trace", "Input trace for host replay: trace [start|stop]", &print_trace},
+    {"top", "CPU time per ISR, thread loop and event since the last top", &print_profile},
+    {"boot", "Time after reset each boot stage finished", &print_boot},
+};
+
+// Handlers in this file with a profiler slot
+enum ProfiledHandler {
+  PROFILE_ISR_COL = 0,
+  PROFILE_ISR_FALLING_EDGE,
+  PROFILE_IDLE_TIMEOUT,
+  PROFILE_ROW_LOOP,
+  PROFILE_KEY_LOOP,
+  PROFILE_ZONE_TRIPPED,
+  PROFILE_DRAW_PROMPT,
+  PROFILE_DRAW_MESSAGE,
+  PROFILE_DRAW_ENTRY_PROMPT,
+  PROFILE_DRAW_DIGIT,
+  PROFILE_DRAW_BACKLIGHT,
+  PROFILED_HANDLERS
+};
+const char *const profiled_names[PROFILED_HANDLERS] = {"isr_col", "isr_falling_edge", "idle_timeout", "row", "key",
+                                                       "zone_tripped", "draw_prompt", "draw_message",
+                                                       "draw_entry_prompt", "draw_digit", "draw_backlight"};
+const int profiled_kinds[PROFILED_HANDLERS] = {PROFILE_ISR, PROFILE_ISR, PROFILE_ISR, PROFILE_THREAD, PROFILE_THREAD,
+                                               PROFILE_EVENT, PROFILE_EVENT, PROFILE_EVENT,
+                                               PROFILE_EVENT, PROFILE_EVENT, PROFILE_EVENT};
+int profile_slots[PROFILED_HANDLERS]; // Slot of each handler in the profiler table
 
 int row = 0; // Current keypad row to power
 
+#if MBED_CONF_APP_BENCH
+// Hot paths timed by the benchmark build (mbed_app.json "bench"), printed as CSV
+const Benchmark benchmarks[] = {
+    {"lcd_print_16", 100, &bench_home_cursor, &bench_lcd_print},
+    {"lcd_clear", 20, nullptr, &bench_lcd_clear},
+    {"lcd_set_cursor", 100, nullptr, &bench_lcd_set_cursor},
+    {"keypad_scan", 1000, nullptr, &bench_keypad_scan},
+    {"rows_write_to_pin", 1000, nullptr, &bench_rows_write_to_pin},
+    {"rows_bsrr", 1000, nullptr, &bench_rows_bsrr},
+    {"telemetry_log", 200, nullptr, &bench_telemetry_log}, // Fewer than TELEMETRY_RECORDS, so no drops
+    {"log_write", 50, nullptr, &bench_log_write}, // Fewer than LOG_RECORDS, so no drops
+    {"passcode_power_on", 20, &bench_power_on, &bench_set_passcode},
+    {"passcode_unarmed", 20, &bench_unarmed, &bench_passcode_entry},
+    {"passcode_armed", 20, &bench_armed, &bench_passcode_entry},
+    {"passcode_triggered", 20, &bench_triggered, &bench_passcode_entry},
+};
+
+// One BSRR value per port for each row: set the row's pin, reset the other row pins (PA_3, PC_0, PC_3, PC_1)
+const uint32_t row_bsrr_a[4] = {1u << 3, 1u << (3 + 16), 1u << (3 + 16), 1u << (3 + 16)};
+const uint32_t row_bsrr_c[4] = {(1u << 0 | 1u << 3 | 1u << 1) << 16, 1u << 0 | (1u << 3 | 1u << 1) << 16,
+                                1u << 3 | (1u << 0 | 1u << 1) << 16, 1u << 1 | (1u << 0 | 1u << 3) << 16};
+#endif
+
 int main() {
+  profile_start(); // Cycle counter on before any profiled code runs
+  for (int i = 0; i < PROFILED_HANDLERS; i++) {
+    profile_slots[i] = profile_slot(profiled_names[i], profiled_kinds[i]);
+  }
+  queues_start(); // Before anything is posted, starts the alarm thread
+
     // Enable interrupts
   col_0.enable_irq();
   col_1.enable_irq();
   col_2.enable_irq();
   col_3.enable_irq();
   
-  // Enable clock control register for GPIO A & C
+  // Enable clock control register for GPIO A, C & D
   enable_rcc('a');
   enable_rcc('c');
+  enable_rcc('d');
 
   // Declare GPIOA pin 3 as an output
   set_pin_mode(3, GPIOA, 1);
@@ -157,9 +402,29 @@ int main() {
   // Declare GPIOC pin 1 as an output
   set_pin_mode(1, GPIOC, 1);
 
-  LCD.begin(); // Initialize LCD
-  LCD.print("Set Passcode: "); // Print prompt
-  LCD.setCursor(0, 1); // Set cursor to next row
+  siren_init(); // Buzzer (PD_14) and alarm LEDs (PD_15) on TIM4, off until triggered
+
+  for (int i = 0; i < TRIP_STAGES; i++) {
+    latency_reset(&trip_latency[i]);
+  }
+#if MBED_CONF_APP_BENCH
+  vectors_run(); // Known answers first, a failed vector makes the numbers that follow suspect
+  LCD.begin();
+  bench_run("project3", benchmarks, sizeof(benchmarks) / sizeof(benchmarks[0])); // Before the journal starts so bench events never reach flash
+  return 0; // Benchmark build, no threads or watchdog
+#endif
+  trace_start(); // Inputs are recorded from boot, the ring keeps the newest TRACE_RECORDS
+  journal_start(); // Find the end of the journal in flash before anything is logged
+  journal_log(JOURNAL_BOOT, 0, STATE_POWER_ON);
+  telemetry_start(); // Binary records on USART3 (PB_10) from here on
+  log_start();
+  LOG_INFO("boot, passcode length %d", PASSCODE_LENGTH);
+
+  ui_queue.call(&lcd_start); // First UI event, main runs it once everything below is sensing
+  alarm_fsm_init(states, &run_action); // Enter power on mode and post its prompt, drawn after lcd_start
+
+  sensors_start(zones, sizeof(zones) / sizeof(zones[0]), &zone_trip_isr); // Every zone on one scheduler, polled at the rate for the current mode
+  boot_us[BOOT_SENSORS] = us_ticker_read();
 
   // Declare interrupts for rising edge of each column of keypad
   col_0.rise(&isr_col);
@@ -167,11 +432,6 @@ int main() {
   col_2.rise(&isr_col);
   col_3.rise(&isr_col);
 
-  microphone.rise(&isr_microphone); // Set microphone rising edge ISR
-
-  ultrasonic_echo.rise(&isr_ultrasonic); // Set ultrasonic sensor rising edge ISR
-  ultrasonic_echo.fall(&isr_ultrasonic_falling_edge); // Set ultrasonic sensor falling edge ISR
-
   // Declare interrupts for falling edge of each column of keypad
   col_0.fall(&isr_falling_edge);
   col_1.fall(&isr_falling_edge);
@@ -179,322 +439,549 @@ int main() {
   col_3.fall(&isr_falling_edge);
 
   idle_timeout.attach(&idle_timeout_handler, 10s); // Attach timeout to handle when system has not received user input
-  
-  ultrasonic_ticker.attach(&trigger_ultrasonic_sensor, 500ms); // Attach ticker to trigger ultrasonic sensor pulses
 
   row_thread.start(row_handler); // Start thread to handle keypad row powering
   key_thread.start(key_handler); // Start thread to handle system mode functions
+  boot_us[BOOT_KEYPAD] = us_ticker_read();
 
   Watchdog &watchdog = Watchdog::get_instance(); // Initialize watchdog 
   watchdog.start(TIMEOUT_MS); // Start watchdog with specified timeout
+  boot_us[BOOT_WATCHDOG] = us_ticker_read();
 
-  queue.dispatch_forever(); // Use main thread to handle any blocking code sent from ISR to the queue
+  console_start(commands, sizeof(commands) / sizeof(commands[0])); // Serial commands
+
+  ui_queue.dispatch_forever(); // Main thread draws the LCD, the alarm thread preempts it for security work
 }
 
-void isr_col(void) { key_pressed = 1; } // Set flag to handle in debounce ticker
+void isr_col(void) {
+  uint32_t start = profile_begin();
+  key_pressed = 1; // Set flag to handle in debounce ticker
+  trace_key(row, col_0.read() ? 0 : col_1.read() ? 1 : col_2.read() ? 2 : col_3.read() ? 3 : -1, 1);
+  profile_end(profile_slots[PROFILE_ISR_COL], start);
+}
 
 void isr_falling_edge(void) { // Set flag to indicate key no longer pressed
+  uint32_t start = profile_begin();
   key_pressed = 0;
   debounced = 0;
+  trace_key(row, -1, 0);
+  profile_end(profile_slots[PROFILE_ISR_FALLING_EDGE], start);
 }
 
-void isr_microphone(void) { 
-  microphone_enable = 0; // Disable mic input to prevent ISR overflow
-  queue.call(&microphone_handler); // Send ISR blocking code to Queue
+void zone_trip_isr(int zone) {
+  telemetry_log(TELEMETRY_TRIP, zone, zones[zone].sensor->kind);
+  LOG_DEBUG("zone %d (%s) tripped", zone, zones[zone].name);
+  alarm_queue.call(&zone_tripped, zone, us_ticker_read()); // Security work goes on the alarm queue
 }
 
-void isr_ultrasonic(void) {
-  echo_on = 1; // Set echo flag
-  ultrasonic_timeout.attach(&ultrasonic_handler, 888us); // Set timeout to check detected object distance
-}
-
-void isr_ultrasonic_falling_edge(void) { echo_on = 0; } // Set echo flag
-
-void microphone_handler() {
-  resource_lock.lock(); // Lock system resources before modifying flags
-  if (mode == 2) { // If armed, reset flags and enter triggered mode
-    mode = 3;
-    alarm_leds = 1;
-    password_position = 0;
-    entering_password = 0;
-    active_buzzer = 1;
-    LCD.clear();
-    LCD.print("Triggered");
-  }
-  else { // Reenable microphone
-      microphone_enable = 1;
-  }
-  resource_lock.unlock(); // Unlock system resources after modifying flags
-}
-
-void ultrasonic_handler() {
-  if (mode == 2 && !echo_on) { // If armed and within triggering distance, handle in queue for blocking code
-    queue.call(&trigger_mode_transition);
-  }
-}
-
-void trigger_mode_transition() {
-    // Reset flags, enable alarm outputs, and enter triggered mode
-  mode = 3;
-  alarm_leds = 1;
-  password_position = 0;
-  entering_password = 0;
-  microphone_enable = 0;
-  active_buzzer = 1;
-  LCD.clear();
-  LCD.print("Triggered");
+void zone_tripped(int zone, uint32_t tripped_us) {
+  uint32_t start = profile_begin();
+  uint32_t queued_us = us_ticker_read() - tripped_us;
+  alarm_lock_take(); // Recursive, dispatch_event takes it again
+  latency_add(&trip_latency[TRIP_QUEUE], queued_us);
+  latency_add(&trip_latency[TRIP_LOCK], us_ticker_read() - tripped_us);
+  trip_us = tripped_us;
+  tripped_zone = zone;
+  dispatch_event(zone_events[zones[zone].sensor->kind], 0); // Triggers the system if armed
+  alarm_lock_give();
+  profile_end(profile_slots[PROFILE_ZONE_TRIPPED], start);
 }
 
 void key_handler() {
   while (1) {
-    resource_lock.lock(); // Lock system resources before modifying flags
+    uint32_t start = profile_begin();
+    keypad_lock.lock(); // Hold the row while the key is debounced and read
     if (key_pressed) { // Check keypress
       if (!debounced) { // Debounce key if not already handled
+        profile_end(profile_slots[PROFILE_KEY_LOOP], start); // The debounce sleep is not CPU time
         thread_sleep_for(10); // Debounce time is 10ms
+        start = profile_begin();
         if (key_pressed) { // If key is still pressed, it is a valid press
           debounced = 1;
           if (!display_on) { // Turn display on if the system was in idle state
             display_on = 1;
-            LCD.backlight();
+            set_backlight(1);
           }
           idle_timeout.detach(); // Reset idle timeout
           idle_timeout.attach(&idle_timeout_handler, 10s);
-          switch (mode) { // Handle the keypress based on current system mode
-          case 0:
-            power_on_mode();
-            break;
-          case 1:
-            unarmed_mode();
-            break;
-          case 2:
-            armed_mode();
-            break;
-          case 3:
-            triggered_mode();
-            break;
+          // Read the columns once to find the pressed key, the state machine decides what it means
+          int col = col_0.read() ? 0 : col_1.read() ? 1 : col_2.read() ? 2 : col_3.read() ? 3 : -1;
+          if (col >= 0) {
+            char key = keypad[row][col];
+            telemetry_log(TELEMETRY_KEY, 0, key >= '0' && key <= '9' ? '*' : key); // Digits masked, like the LCD
+            dispatch_event(key_event(key), key);
           }
         }
       }
     }
-    resource_lock.unlock(); // Unlock system resources after modifying flags
+    keypad_lock.unlock(); // Unlock system resources after modifying flags
+    profile_end(profile_slots[PROFILE_KEY_LOOP], start);
+    thread_sleep_for(KEYPAD_POLL_MS); // Let the low priority console and journal threads run
   }
 }
 
 void row_handler() {
   while (1) {
-    resource_lock.lock(); // Lock system resources before modifying flags
+    uint32_t start = profile_begin();
+    keypad_lock.lock(); // Lock system resources before modifying flags
     if (!key_pressed) {
       row++;    // Increment row
       row %= 4; // Keep row between 0 and 3
-      switch (row) {
-      case 0: // Turn off other rows, turn on row 0
-        write_to_pin(0, GPIOC, 0);
-        write_to_pin(3, GPIOC, 0);
-        write_to_pin(1, GPIOC, 0);
-        write_to_pin(3, GPIOA, 1);
-        break;
-      case 1: // Turn off other rows, turn on row 1
-        write_to_pin(3, GPIOA, 0);
-        write_to_pin(3, GPIOC, 0);
-        write_to_pin(1, GPIOC, 0);
-        write_to_pin(0, GPIOC, 1);
-        break;
-      case 2: // Turn off other rows, turn on row 2
-        write_to_pin(3, GPIOA, 0);
-        write_to_pin(0, GPIOC, 0);
-        write_to_pin(1, GPIOC, 0);
-        write_to_pin(3, GPIOC, 1);
-        break;
-      case 3: // Turn off other rows, turn on row 3
-        write_to_pin(3, GPIOA, 0);
-        write_to_pin(0, GPIOC, 0);
-        write_to_pin(3, GPIOC, 0);
-        write_to_pin(1, GPIOC, 1);
-        break;
-      }
+      select_row(row);
     }
-    resource_lock.unlock(); // Unlock system resources after modifying flags
+    keypad_lock.unlock(); // Unlock system resources after modifying flags
     Watchdog::get_instance().kick(); // Reset watchdog timer since user input is still working correctly and not blocked
+    profile_end(profile_slots[PROFILE_ROW_LOOP], start);
+    thread_sleep_for(KEYPAD_POLL_MS); // One row per tick, a full scan every 4ms
+  }
+}
+
+void select_row(int row) {
+  switch (row) {
+  case 0: // Turn off other rows, turn on row 0
+    write_to_pin(0, GPIOC, 0);
+    write_to_pin(3, GPIOC, 0);
+    write_to_pin(1, GPIOC, 0);
+    write_to_pin(3, GPIOA, 1);
+    break;
+  case 1: // Turn off other rows, turn on row 1
+    write_to_pin(3, GPIOA, 0);
+    write_to_pin(3, GPIOC, 0);
+    write_to_pin(1, GPIOC, 0);
+    write_to_pin(0, GPIOC, 1);
+    break;
+  case 2: // Turn off other rows, turn on row 2
+    write_to_pin(3, GPIOA, 0);
+    write_to_pin(0, GPIOC, 0);
+    write_to_pin(1, GPIOC, 0);
+    write_to_pin(3, GPIOC, 1);
+    break;
+  case 3: // Turn off other rows, turn on row 3
+    write_to_pin(3, GPIOA, 0);
+    write_to_pin(0, GPIOC, 0);
+    write_to_pin(3, GPIOC, 0);
+    write_to_pin(1, GPIOC, 1);
+    break;
   }
 }
 
-void power_on_mode() {
-  if (col_0.read() && keypad[row][0] != '*') { // Check if column powered and if number pressed
-    password[password_position] = keypad[row][0];
-  } else if (col_1.read()) { // Check if column powered
-    password[password_position] = keypad[row][1];
-  } else if (col_2.read() && keypad[row][2] != '#') { // Check if column powered and if number pressed
-    password[password_position] = keypad[row][2];
+void idle_timeout_handler() { // Handler acivated if system has idled without user input for 10s
+  uint32_t start = profile_begin();
+  if (display_on) {
+    display_on = 0;
+    ui_queue.call(&set_display_off); // Idle is display housekeeping, it goes on the UI queue
   }
-  if ((col_0.read() && keypad[row][0] != '*') || col_1.read() ||
-      (col_2.read() && keypad[row][2] != '#')) { // If valid number pressed, set password, update position, and update LCD
-    password_position++;
-    LCD.print("*");
-    if (password_position == 4) {
-      password_position = 0;
-      mode = 1;
-      LCD.clear();
-      LCD.print("Unarmed");
+  profile_end(profile_slots[PROFILE_IDLE_TIMEOUT], start);
+}
+
+void set_display_off() { dispatch_event(EVENT_IDLE, 0); } // Display off and idle prompt for the current state
+
+void dispatch_event(int event, char key) {
+  alarm_lock_take(); // Events from the keypad thread and both queues are serialized
+  uint32_t start = us_ticker_read();
+  int before = alarm_state();
+  alarm_dispatch(event, key);
+  if (alarm_state() != before) {
+    int source = event;
+    if (event == EVENT_MICROPHONE || event == EVENT_ULTRASONIC || event == EVENT_CONTACT) {
+      source = JOURNAL_SOURCE_ZONE | tripped_zone; // Record the zone, not just the sensor kind
     }
+    journal_log(JOURNAL_STATE, source, alarm_state()); // RAM only, flash is written by the journal thread
+    telemetry_log(TELEMETRY_STATE, source, alarm_state());
+    LOG_INFO("%s -> %s (%s)", state_names[before], state_names[alarm_state()],
+             source & JOURNAL_SOURCE_ZONE ? zones[tripped_zone].name : source_names[event]);
   }
+  dispatch_last_us = us_ticker_read() - start;
+  if (dispatch_last_us > dispatch_max_us) {
+    dispatch_max_us = dispatch_last_us; // LCD writes are on the UI queue, so this is short
+  }
+  alarm_lock_give();
 }
 
-void unarmed_mode() {
-  if (col_0.read() && keypad[row][0] != '*' && entering_password) { // Check if column powered and if number pressed if entering password
-    password_entered[password_position] = keypad[row][0];
-  } else if (col_1.read() && entering_password) { // Check if column powered and if number pressed if entering password
-    password_entered[password_position] = keypad[row][1];
+void alarm_lock_take(void) {
+  alarm_lock.lock();
+  if (alarm_lock_depth++ == 0) {
+    alarm_lock_taken_us = us_ticker_read();
+  }
+}
 
-  } else if (col_2.read() && keypad[row][2] != '#' && entering_password) { // Check if column powered and if number pressed if entering password
-    password_entered[password_position] = keypad[row][2];
-  } else if (col_3.read() && keypad[row][3] == 'A' && !entering_password) { // Check if column powered and if A pressed if NOT entering password
-    entering_password = 1;
-    LCD.clear();
-    LCD.print("Enter Passcode: ");
-    LCD.setCursor(0, 1);
+void alarm_lock_give(void) {
+  if (--alarm_lock_depth == 0) {
+    uint32_t held_us = us_ticker_read() - alarm_lock_taken_us;
+    if (held_us > alarm_lock_hold_max_us) {
+      alarm_lock_hold_max_us = held_us;
+    }
   }
-  if ((col_0.read() && keypad[row][0] != '*' && entering_password) ||
-      (col_1.read() && entering_password) ||
-      (col_2.read() && keypad[row][2] != '#' && entering_password)) { // Check for valid number press and then update flags
-    password_position++;
-    LCD.print("*");
-    if (password_position == 4) { // If password entered, compare between actual password
-      password_position = 0;
-      entering_password = 0;
-      if (password_entered == password) { // If correct password -> armed mode else stay in unarmed mode
-        mode = 2;
-        microphone_enable = 1;
-        LCD.clear();
-        LCD.print("Armed");
-      } else {
-        LCD.clear();
-        LCD.print("Incorrect");
-        LCD.setCursor(0, 1);
-        LCD.print("Passcode");
-        thread_sleep_for(2000);
-        LCD.clear();
-        LCD.print("Unarmed");
+  alarm_lock.unlock();
+}
+
+void run_action(int action, char key) {
+  switch (action) {
+  case ACTION_SET_DIGIT: // Define passcode in power on mode
+    show_digit();
+    if (passcode_push(&password, key)) {
+      alarm_raise(EVENT_PASSCODE_SET);
+    }
+    break;
+
+  case ACTION_START_ENTRY: // A pressed, ask for the passcode
+    if (!entering_password) {
+      entering_password = 1;
+      show_entry_prompt();
+    }
+    break;
+
+  case ACTION_ENTRY_DIGIT: // Digits only count after A was pressed
+    if (entering_password) {
+      show_digit();
+      if (passcode_push(&password_entered, key)) { // If password entered, compare between actual password
+        entering_password = 0;
+        int match = passcode_equal(&password_entered, &password);
+        passcode_clear(&password_entered); // Do not keep the attempt in RAM
+        alarm_raise(match ? EVENT_PASSCODE_OK : EVENT_PASSCODE_BAD);
       }
     }
+    break;
+
+  case ACTION_REJECT: // Keypad and sensors keep running while the message is up
+    journal_log(JOURNAL_PASSCODE_BAD, EVENT_DIGIT, alarm_state());
+    LOG_WARN("incorrect passcode while %s", state_names[alarm_state()]);
+    show_message("Incorrect", "Passcode", INCORRECT_MESSAGE_MS);
+    break;
+
+  case ACTION_IDLE_RESET:
+    set_backlight(0); // Turn off LCD backlight since system is idling
+    journal_flush(); // Quiet time, write any partial batch
+    passcode_clear(&password_entered); // Reset password flags
+    entering_password = 0;
+    show_prompt(); // Reset prompt to idle prompt
+    break;
   }
 }
 
-void armed_mode() {
-  if (col_0.read() && keypad[row][0] != '*' && entering_password) { // Check if column powered and if number pressed if entering password
-    password_entered[password_position] = keypad[row][0];
-  } else if (col_1.read() && entering_password) { // Check if column powered and if number pressed if entering password
-    password_entered[password_position] = keypad[row][1];
+void show_prompt() { ui_queue.call(&draw_prompt); }
 
-  } else if (col_2.read() && keypad[row][2] != '#' && entering_password) { // Check if column powered and if number pressed if entering password
-    password_entered[password_position] = keypad[row][2];
-  } else if (col_3.read() && keypad[row][3] == 'A' && !entering_password) { // Check if column powered and if A pressed if NOT entering password
-    entering_password = 1;
-    LCD.clear();
-    LCD.print("Enter Passcode: ");
-    LCD.setCursor(0, 1);
+void show_message(const char *line_0, const char *line_1, int duration_ms) {
+  ui_queue.call(&draw_message, line_0, line_1, duration_ms); // Lines must be string literals, they are drawn later
+}
+
+void show_entry_prompt() { ui_queue.call(&draw_entry_prompt); }
+
+void show_digit() { ui_queue.call(&draw_digit); }
+
+void set_backlight(int on) { ui_queue.call(&draw_backlight, on); }
+
+void lcd_start() {
+  LCD.begin(); // Sleeps over a second, the alarm thread, ISRs and keypad keep running meanwhile
+  boot_us[BOOT_LCD] = us_ticker_read();
+  LOG_INFO("sensing %lu us after reset, LCD ready after %lu ms", boot_us[BOOT_SENSORS], boot_us[BOOT_LCD] / 1000);
+}
+
+void draw_prompt() {
+  uint32_t start = profile_begin();
+  cancel_message(); // The prompt is already back
+  LCD.clear();
+  LCD.print(states[alarm_state()].prompt); // Drawn for the state at draw time, so queued redraws show the newest state
+  LCD.setCursor(0, 1); // Passcode digits go on the next row
+  if (alarm_state() == STATE_TRIGGERED) {
+    LCD.print(zones[tripped_zone].name); // Which sensor tripped
+    if (trip_draw_pending) {
+      alarm_lock_take(); // Stats are shared with the alarm thread
+      latency_add(&trip_latency[TRIP_DISPLAY], us_ticker_read() - trip_us);
+      trip_draw_pending = 0;
+      alarm_lock_give();
+    }
   }
-  if ((col_0.read() && keypad[row][0] != '*' && entering_password) ||
-      (col_1.read() && entering_password) ||
-      (col_2.read() && keypad[row][2] != '#' && entering_password)) {  // Check for valid number press and then update flags
-    password_position++;
-    LCD.print("*");
-    if (password_position == 4) { // If password entered, compare between actual password
-      password_position = 0;
-      entering_password = 0;
-      if (password_entered == password) { // If correct password -> unarmed mode else stay in armed mode
-        mode = 1;
-        LCD.clear();
-        LCD.print("Unarmed");
-      } else {
-        LCD.clear();
-        LCD.print("Incorrect");
-        LCD.setCursor(0, 1);
-        LCD.print("Passcode");
-        thread_sleep_for(2000);
-        LCD.clear();
-        LCD.print("Armed");
-      }
+  profile_end(profile_slots[PROFILE_DRAW_PROMPT], start);
+}
+
+void draw_message(const char *line_0, const char *line_1, int duration_ms) {
+  uint32_t start = profile_begin();
+  cancel_message(); // A new message restarts the timer
+  LCD.clear();
+  LCD.print(line_0);
+  LCD.setCursor(0, 1);
+  LCD.print(line_1);
+  message_event = ui_queue.call_in(std::chrono::milliseconds(duration_ms), &restore_prompt);
+  profile_end(profile_slots[PROFILE_DRAW_MESSAGE], start);
+}
+
+void draw_entry_prompt() {
+  uint32_t start = profile_begin();
+  cancel_message(); // Entry replaces a message that is still up
+  LCD.clear();
+  LCD.print("Enter Passcode: ");
+  LCD.setCursor(0, 1);
+  profile_end(profile_slots[PROFILE_DRAW_ENTRY_PROMPT], start);
+}
+
+void draw_digit() {
+  uint32_t start = profile_begin();
+  LCD.print("*");
+  profile_end(profile_slots[PROFILE_DRAW_DIGIT], start);
+}
+
+void draw_backlight(int on) {
+  uint32_t start = profile_begin();
+  if (on) {
+    LCD.backlight();
+  } else {
+    LCD.noBacklight();
+  }
+  profile_end(profile_slots[PROFILE_DRAW_BACKLIGHT], start);
+}
+
+void cancel_message() {
+  if (message_event) {
+    ui_queue.cancel(message_event);
+    message_event = 0;
+  }
+}
+
+void restore_prompt() {
+  message_event = 0; // Timer fired, cancels run on this same queue so there is no race
+  draw_prompt();
+}
+
+void print_journal(const char *args) {
+  int count = journal_dump(&print_journal_record);
+  printf("%d records, %lu dropped\n", count, (unsigned long)journal_dropped());
+}
+
+void print_journal_record(const JournalRecord *record) {
+  const char *source = "?";
+  int zone = record->source & ~JOURNAL_SOURCE_ZONE;
+  if (record->source & JOURNAL_SOURCE_ZONE) {
+    source = zone < zone_count() ? zones[zone].name : "?"; // Zone table may have changed since the record was written
+  } else if (record->source < EVENT_COUNT) {
+    source = source_names[record->source];
+  }
+  printf("%10lu ms  %-12s %-12s %s\n", (unsigned long)record->time_ms,
+         record->type < JOURNAL_TYPE_COUNT ? journal_type_names[record->type] : "?", source,
+         record->mode < STATE_COUNT ? state_names[record->mode] : "?");
+}
+
+void print_zones(const char *args) {
+  for (int i = 0; i < zone_count(); i++) {
+    printf("%d  %-12s %-10s %-6s", i, zones[i].name, kind_names[zones[i].sensor->kind], zone_armed(i) ? "armed" : "bypass");
+    if (zones[i].sensor->kind == SENSOR_ULTRASONIC) {
+      printf(" %lu mm", (unsigned long)distance_mm(i));
     }
+    printf("\n");
   }
 }
 
-void triggered_mode() {
-  if (col_0.read() && keypad[row][0] != '*' && entering_password) { // Check if column powered and if number pressed if entering password
-    password_entered[password_position] = keypad[row][0];
-  } else if (col_1.read() && entering_password) { // Check if column powered and if number pressed if entering password
-    password_entered[password_position] = keypad[row][1];
+void set_zone(const char *args) {
+  int zone = 0;
+  char setting[5] = ""; // One longer than "off" so "offline" does not match
+  if (sscanf(args, "%d %4s", &zone, setting) != 2 || zone < 0 || zone >= zone_count() ||
+      (strcmp(setting, "on") != 0 && strcmp(setting, "off") != 0)) {
+    printf("zone <n> on|off\n"); // A typo must not bypass a zone
+    return;
+  }
+  zone_set_armed(zone, strcmp(setting, "on") == 0);
+  print_zones("");
+}
 
-  } else if (col_2.read() && keypad[row][2] != '#' && entering_password) { // Check if column powered and if number pressed if entering password
-    password_entered[password_position] = keypad[row][2];
-  } else if (col_3.read() && keypad[row][3] == 'A' && !entering_password) { // Check if column powered and if A pressed if NOT entering password
-    entering_password = 1;
-    LCD.clear();
-    LCD.print("Enter Passcode: ");
-    LCD.setCursor(0, 1);
+void set_range(const char *args) {
+  if (*args) {
+    unsigned long mm = 0;
+    char extra = 0;
+    if (sscanf(args, "%lu %c", &mm, &extra) != 1 || mm < ULTRASONIC_MIN_RANGE_MM || mm > ULTRASONIC_MAX_RANGE_MM) {
+      printf("range <%d-%d mm>\n", ULTRASONIC_MIN_RANGE_MM, ULTRASONIC_MAX_RANGE_MM);
+      return;
+    }
+    set_trigger_range_mm(mm); // One word, the sonar ISR reads it on its next echo
   }
-  if ((col_0.read() && keypad[row][0] != '*' && entering_password) ||
-      (col_1.read() && entering_password) ||
-      (col_2.read() && keypad[row][2] != '#' && entering_password)) {  // Check for valid number press and then update flags
-    password_position++;
-    LCD.print("*");
-    if (password_position == 4) { // If password entered, compare between actual password
-      password_position = 0;
-      entering_password = 0;
-      if (password_entered == password) {  // If correct password -> unarmed mode else stay in triggered mode
-        mode = 1;
-        LCD.clear();
-        LCD.print("Unarmed");
-        active_buzzer = 0;
-        alarm_leds = 0;
-      } else {
-        LCD.clear();
-        LCD.print("Incorrect");
-        LCD.setCursor(0, 1);
-        LCD.print("Passcode");
-        thread_sleep_for(2000);
-        LCD.clear();
-        LCD.print("Triggered");
-      }
+  printf("sonar trigger range %lu mm\n", (unsigned long)trigger_range_mm());
+}
+
+void set_mic(const char *args) {
+  if (*args) {
+    unsigned long rms = 0;
+    char extra = 0;
+    if (sscanf(args, "%lu %c", &rms, &extra) != 1 || rms < 1 || rms > MIC_MAX_THRESHOLD_RMS) {
+      printf("mic <1-%d rms>\n", MIC_MAX_THRESHOLD_RMS); // 0 would make every block loud
+      return;
     }
+    set_mic_threshold(rms); // One word, the DMA interrupt reads it on its next block
   }
+  printf("mic threshold %lu rms, last block %lu rms, peak %lu\n", (unsigned long)mic_threshold(),
+         (unsigned long)mic_level_rms(), (unsigned long)mic_level_peak());
 }
 
-void idle_timeout_handler() { // Handler acivated if system has idled without user input for 10s
-  if (display_on) {
-    display_on = 0;
-    queue.call(&set_display_off); // Queue LCD blocking code from ISR
+void print_latency(const char *args) {
+  if (strcmp(args, "reset") == 0) {
+    alarm_lock_take(); // Stats are written by the alarm and UI queues while they hold the lock
+    for (int i = 0; i < TRIP_STAGES; i++) {
+      latency_reset(&trip_latency[i]);
+    }
+    dispatch_max_us = 0;
+    alarm_lock_hold_max_us = 0;
+    alarm_lock_give();
+  }
+  uint32_t max_us[TRIP_STAGES];
+  uint32_t trips = 0;
+  printf("stage      count    min us    avg us    p99 us    max us\n");
+  for (int i = 0; i < TRIP_STAGES; i++) {
+    LatencyStats stats;
+    alarm_lock_take(); // Copy under the lock, print without it so the trip path never waits on the UART
+    stats = trip_latency[i];
+    alarm_lock_give();
+    printf("%-8s %7lu %9lu %9lu %9lu %9lu\n", trip_stage_names[i], (unsigned long)stats.count,
+           (unsigned long)(stats.count ? stats.min_us : 0), (unsigned long)latency_avg(&stats),
+           (unsigned long)latency_percentile(&stats, 99), (unsigned long)stats.max_us);
+    max_us[i] = stats.max_us;
+    if (i == TRIP_SIREN) {
+      trips = stats.count;
+    }
+  }
+  uint32_t hold_max_us = alarm_lock_hold_max_us; // Read after the copies, so it covers them
+  printf("slowest dispatch %lu us, longest alarm_lock hold %lu us\n", (unsigned long)dispatch_max_us,
+         (unsigned long)hold_max_us);
+  if (trips) {
+    // A trip waits for the queue, then for one other holder of alarm_lock, then holds it itself up to the siren
+    uint32_t bound_us = max_us[TRIP_QUEUE] + 2 * hold_max_us;
+    printf("siren bound %lu us (queue max + 2 x longest hold), siren max %lu us: %s\n", (unsigned long)bound_us,
+           (unsigned long)max_us[TRIP_SIREN], max_us[TRIP_SIREN] <= bound_us ? "within bound" : "OVER BOUND");
   }
 }
 
-void set_display_off() {
-  LCD.noBacklight();  // Turn off LCD backlight since system is idling
-  LCD.clear();
-  password_position = 0; // Reset password flags
-  entering_password = 0;
-  switch (mode) { // Reset prompt to idle prompt
-  case 0:
-    LCD.print("Set Passcode: ");
-    LCD.setCursor(0, 1);
-    break;
-  case 1:
-    LCD.print("Unarmed");
-    break;
-  case 2:
-    LCD.print("Armed");
-    break;
-  case 3:
-    LCD.print("Triggered");
-    break;
+void print_memory(const char *args) { memory_print(); }
+
+void print_profile(const char *args) { profile_print(); }
+
+void print_boot(const char *args) {
+  printf("stage       us after reset\n");
+  for (int i = 0; i < BOOT_STAGES; i++) {
+    if (boot_us[i]) {
+      printf("%-10s %10lu\n", boot_stage_names[i], (unsigned long)boot_us[i]);
+    } else {
+      printf("%-10s    running\n", boot_stage_names[i]); // Only the LCD can still be starting
+    }
+  }
+}
+
+void print_trace(const char *args) {
+  if (strcmp(args, "start") == 0) {
+    trace_start();
+  } else if (strcmp(args, "stop") == 0) {
+    trace_stop();
+  } else {
+    int count = trace_dump(&print_trace_record);
+    printf("# %d records, %lu lost, %s\n", count, (unsigned long)trace_lost(), trace_recording() ? "recording" : "stopped");
+  }
+}
+
+void print_trace_record(uint64_t time_us, const TraceRecord *record) {
+  if (record->source == TRACE_KEY) {
+    printf("%llu key %d %d %d\n", (unsigned long long)time_us, record->channel / 4, record->channel % 4, record->value);
+  } else if (record->source < TRACE_SOURCE_COUNT) {
+    printf("%llu %s %d %d\n", (unsigned long long)time_us, trace_source_names[record->source], record->channel, record->value);
   }
 }
 
-void trigger_ultrasonic_sensor() {
-  if (!echo_on) { // Wait for previous trigger to finish
-    ultrasonic_trigger = 1; // Activate pulse
-    wait_us(10); // Wait for specified time
-    ultrasonic_trigger = 0; // Deactivate trigger pulse
-    if (mode == 3) {
-      alarm_leds = !alarm_leds; // Toggle alarm LEDs if in triggered mode
+void enter_power_on() { show_prompt(); }
+
+void enter_unarmed() {
+  sensors_follow_state();
+  show_prompt();
+}
+
+void enter_armed() {
+  sensors_follow_state();
+  show_prompt();
+}
+
+void enter_triggered() {
+  sensors_follow_state();
+  passcode_clear(&password_entered); // Drop a partial passcode
+  entering_password = 0;
+  start_alarm_outputs();
+  latency_add(&trip_latency[TRIP_SIREN], us_ticker_read() - trip_us);
+  trip_draw_pending = 1; // draw_prompt records the display stage
+  show_prompt();
+}
+
+void exit_triggered() { stop_alarm_outputs(); }
+
+void sensors_follow_state() {
+  sensors_set_mode(alarm_state(), alarm_state() == STATE_ARMED); // Poll rates follow the mode, detections from the last mode do not count
+}
+
+void start_alarm_outputs() {
+  siren_start(alarm_phases, sizeof(alarm_phases) / sizeof(alarm_phases[0])); // Timer and DMA run it, no CPU per beep
+}
+
+void stop_alarm_outputs() {
+  siren_stop();
+}
+
+#if MBED_CONF_APP_BENCH
+void bench_lcd_print(int i) { LCD.print("0123456789ABCDEF"); }
+
+void bench_lcd_clear(int i) { LCD.clear(); }
+
+void bench_lcd_set_cursor(int i) { LCD.setCursor(i % 16, i / 16 % 2); }
+
+void bench_home_cursor(int i) { LCD.setCursor(0, 0); }
+
+void bench_keypad_scan(int i) {
+  for (int scan_row = 0; scan_row < 4; scan_row++) {
+    select_row(scan_row);
+    if (col_0.read() | col_1.read() | col_2.read() | col_3.read()) {
+      break; // A key is held, the real scan stops on its row
     }
   }
 }
+
+void bench_rows_write_to_pin(int i) { select_row(i % 4); }
+
+void bench_rows_bsrr(int i) {
+  GPIOA->BSRR = row_bsrr_a[i % 4];
+  GPIOC->BSRR = row_bsrr_c[i % 4];
+}
+
+void bench_telemetry_log(int i) { telemetry_log(TELEMETRY_DISTANCE, 0, i); }
+
+void bench_log_write(int i) { log_write(LOG_LEVEL_INFO, "bench %d of %s", i, "log_write"); } // Timed whatever the log level
+
+void bench_enter_passcode(int start_entry) {
+  if (start_entry) {
+    dispatch_event(key_event('A'), 'A');
+  }
+  for (int digit = 0; digit < PASSCODE_LENGTH; digit++) {
+    char key = '1' + digit;
+    dispatch_event(key_event(key), key);
+  }
+}
+
+void bench_enter_state(int state) {
+  passcode_clear(&password);
+  passcode_clear(&password_entered);
+  entering_password = 0;
+  alarm_fsm_init(states, &run_action);
+  if (state >= STATE_UNARMED) {
+    bench_enter_passcode(0); // Define the passcode
+  }
+  if (state >= STATE_ARMED) {
+    bench_enter_passcode(1); // Arm
+  }
+  if (state == STATE_TRIGGERED) {
+    dispatch_event(EVENT_ULTRASONIC, 0);
+  }
+  ui_queue.dispatch_once(); // Draw now, so the timed calls do not wait on a full UI queue
+}
+
+void bench_power_on(int i) { bench_enter_state(STATE_POWER_ON); }
+
+void bench_unarmed(int i) { bench_enter_state(STATE_UNARMED); }
+
+void bench_armed(int i) { bench_enter_state(STATE_ARMED); }
+
+void bench_triggered(int i) { bench_enter_state(STATE_TRIGGERED); }
+
+void bench_set_passcode(int i) { bench_enter_passcode(0); }
+
+void bench_passcode_entry(int i) { bench_enter_passcode(1); }
+#endif
@@ -0,0 +1,78 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: RAM usage report (thread stack high-water marks, heap peak, EventQueue buffer
+ *               high-water) and the thread stack sizes built from measured peaks
+ *
+ * Modules:
+ *
+ * Subroutines:
+ * void memory_watch_queue(const char *name, unsigned char *buffer, uint32_t size) - Fills an EventQueue buffer with a pattern so its high-water can be read
+ * uint32_t memory_queue_peak(int queue) - Most bytes of a watched EventQueue buffer used since boot
+ * void memory_print(void) - Prints every thread's stack peak, the heap and the EventQueue buffer
+ *
+ * Assignment: Project 3
+ * Inputs:
+ * Outputs:
+ *      USB serial (STDIO)
+ * Constraints:
+ *      Stack peaks come from the RTX stack watermark, the kernel fills each stack with a pattern
+ *      when the thread starts and the peak is the deepest byte that no longer holds it
+ *      The queue buffer is handed out from its start, so its high-water is the last byte that no
+ *      longer holds the fill pattern. An event whose last bytes equal the pattern reads a few bytes low
+ * References:
+ *      MBED Memory statistics - https://os.mbed.com/docs/mbed-os/v6.15/apis/mbed-statistics.html
+ */
+#include "CSE321_project3_mabautis_memory.h"
+
+#define QUEUE_FILL 0xCD // Pattern of queue buffer bytes never handed out
+
+struct WatchedQueue {
+  const char *name;      // Shown in the report
+  unsigned char *buffer; // Buffer given to the EventQueue
+  uint32_t size;         // Buffer size in bytes
+};
+
+static WatchedQueue queues[MEMORY_QUEUES_MAX];
+static int queue_count = 0;
+
+void memory_watch_queue(const char *name, unsigned char *buffer, uint32_t size) {
+  if (queue_count == MEMORY_QUEUES_MAX) {
+    return;
+  }
+  for (uint32_t i = 0; i < size; i++) {
+    buffer[i] = QUEUE_FILL;
+  }
+  queues[queue_count++] = {name, buffer, size};
+}
+
+uint32_t memory_queue_peak(int queue) {
+  const WatchedQueue &watched = queues[queue];
+  uint32_t used = watched.size;
+  while (used && watched.buffer[used - 1] == QUEUE_FILL) {
+    used--;
+  }
+  return used;
+}
+
+void memory_print(void) {
+  static mbed_stats_stack_t stacks[MEMORY_THREADS_MAX]; // Too large for the console stack
+  size_t count = mbed_stats_stack_get_each(stacks, MEMORY_THREADS_MAX);
+  printf("thread         peak   size  sized\n");
+  for (size_t i = 0; i < count; i++) {
+    const char *name = osThreadGetName((osThreadId_t)stacks[i].thread_id);
+    printf("%-12s %6lu %6lu %6lu\n", name ? name : "?", (unsigned long)stacks[i].max_size,
+           (unsigned long)stacks[i].reserved_size, (unsigned long)STACK_FROM_PEAK(stacks[i].max_size, 0));
+  }
+  printf("sized = peak + %d%% + %d bytes, set <thread>-stack-peak in mbed_app.json to use it\n",
+         MBED_CONF_APP_STACK_MARGIN, STACK_MARGIN_BYTES);
+
+  mbed_stats_heap_t heap;
+  mbed_stats_heap_get(&heap);
+  printf("heap %lu bytes now, %lu peak, %lu reserved, %lu failed allocations\n", (unsigned long)heap.current_size,
+         (unsigned long)heap.max_size, (unsigned long)heap.reserved_size, (unsigned long)heap.alloc_fail_cnt);
+  for (int i = 0; i < queue_count; i++) {
+    printf("%s queue %lu of %lu bytes peak\n", queues[i].name, (unsigned long)memory_queue_peak(i),
+           (unsigned long)queues[i].size);
+  }
+}
@@ -0,0 +1,77 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: RAM usage report (thread stack high-water marks, heap peak, EventQueue buffer
+ *               high-water) and the thread stack sizes built from measured peaks
+ *
+ * Modules:
+ *
+ * Subroutines:
+ * void memory_watch_queue(const char *name, unsigned char *buffer, uint32_t size) - Fills an EventQueue buffer with a pattern so its high-water can be read
+ * uint32_t memory_queue_peak(int queue) - Most bytes of a watched EventQueue buffer used since boot
+ * void memory_print(void) - Prints every thread's stack peak, the heap and the EventQueue buffer
+ *
+ * Assignment: Project 3
+ * Inputs:
+ * Outputs:
+ *      USB serial (STDIO)
+ * Constraints:
+ *      Needs platform.stack-stats-enabled and platform.heap-stats-enabled (mbed_app.json)
+ *      memory_watch_queue must run before anything is posted to the queue, at most MEMORY_QUEUES_MAX queues
+ *      A *-stack-peak option of 0 keeps the thread's default stack size
+ * References:
+ *      MBED Memory statistics - https://os.mbed.com/docs/mbed-os/v6.15/apis/mbed-statistics.html
+ */
+#ifndef CSE321_PROJECT3_MABAUTIS_MEMORY_H
+#define CSE321_PROJECT3_MABAUTIS_MEMORY_H
+
+#include <mbed.h>
+#include <stdint.h>
+
+#define MEMORY_THREADS_MAX 12  // Threads the report can list
+#define MEMORY_QUEUES_MAX 4    // EventQueue buffers the report can watch
+#define STACK_MARGIN_BYTES 256 // Always added on top of the percentage (FPU context frame is 200 bytes)
+
+// Measured peaks from the memory command, set in mbed_app.json (0 -> default size)
+#ifndef MBED_CONF_APP_ROW_STACK_PEAK
+#define MBED_CONF_APP_ROW_STACK_PEAK 0
+#endif
+#ifndef MBED_CONF_APP_KEY_STACK_PEAK
+#define MBED_CONF_APP_KEY_STACK_PEAK 0
+#endif
+#ifndef MBED_CONF_APP_ALARM_STACK_PEAK
+#define MBED_CONF_APP_ALARM_STACK_PEAK 0
+#endif
+#ifndef MBED_CONF_APP_CONSOLE_STACK_PEAK
+#define MBED_CONF_APP_CONSOLE_STACK_PEAK 0
+#endif
+#ifndef MBED_CONF_APP_JOURNAL_STACK_PEAK
+#define MBED_CONF_APP_JOURNAL_STACK_PEAK 0
+#endif
+#ifndef MBED_CONF_APP_TELEMETRY_STACK_PEAK
+#define MBED_CONF_APP_TELEMETRY_STACK_PEAK 0
+#endif
+#ifndef MBED_CONF_APP_LOG_STACK_PEAK
+#define MBED_CONF_APP_LOG_STACK_PEAK 0
+#endif
+#ifndef MBED_CONF_APP_STACK_MARGIN
+#define MBED_CONF_APP_STACK_MARGIN 25
+#endif
+
+// Peak plus the margin, rounded up to the 8 byte stack alignment
+#define STACK_FROM_PEAK(peak, fallback)                                                                      \
+  ((peak) ? (((peak) * (100 + MBED_CONF_APP_STACK_MARGIN) / 100 + STACK_MARGIN_BYTES + 7) & ~7u) : (fallback))
+
+#define ROW_STACK_SIZE STACK_FROM_PEAK(MBED_CONF_APP_ROW_STACK_PEAK, OS_STACK_SIZE)
+#define KEY_STACK_SIZE STACK_FROM_PEAK(MBED_CONF_APP_KEY_STACK_PEAK, OS_STACK_SIZE)
+#define ALARM_STACK_SIZE STACK_FROM_PEAK(MBED_CONF_APP_ALARM_STACK_PEAK, OS_STACK_SIZE)
+#define CONSOLE_STACK_SIZE STACK_FROM_PEAK(MBED_CONF_APP_CONSOLE_STACK_PEAK, 2048) // printf needs the larger stack
+#define JOURNAL_STACK_SIZE STACK_FROM_PEAK(MBED_CONF_APP_JOURNAL_STACK_PEAK, 1024)
+#define TELEMETRY_STACK_SIZE STACK_FROM_PEAK(MBED_CONF_APP_TELEMETRY_STACK_PEAK, 1024)
+#define LOG_STACK_SIZE STACK_FROM_PEAK(MBED_CONF_APP_LOG_STACK_PEAK, 2048) // snprintf
+
+void memory_watch_queue(const char *name, unsigned char *buffer, uint32_t size); // Fills an EventQueue buffer with a pattern so its high-water can be read
+uint32_t memory_queue_peak(int queue); // Most bytes of a watched EventQueue buffer used since boot
+void memory_print(void); // Prints every thread's stack peak, the heap and the EventQueue buffer
+
+#endif
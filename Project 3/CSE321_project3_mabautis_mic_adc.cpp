@@ -0,0 +1,166 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: Samples the microphone analog output with ADC1 + DMA and reports block loudness
+ *
+ * Modules:
+ *      CSE321_project3_mabautis_dsp - Block RMS and peak computation
+ *      CSE321_project3_mabautis_trace - Records block levels for host replay
+ *      CSE321_project3_mabautis_profile - CPU time of the DMA interrupt
+ *      CSE321_project3_mabautis_telemetry - Sends every block level
+ *
+ * Subroutines:
+ * void mic_adc_start(void (*loud_block)(void)) - Starts timer triggered sampling into the double buffer
+ * void set_mic_threshold(uint32_t rms) - Sets the RMS level (ADC counts) that counts as a loud block
+ * uint32_t mic_threshold(void) - RMS level that counts as a loud block
+ * uint32_t mic_level_rms(void) - RMS of the last block in ADC counts
+ * uint32_t mic_level_peak(void) - Peak of the last block in ADC counts
+ * void mic_dma_irq(void) - DMA half/full transfer ISR that processes the block the DMA just finished
+ *
+ * Assignment: Project 3
+ * Inputs:
+ *      Microphone analog output - PC_4 (ADC1_IN13)
+ * Outputs:
+ * Constraints:
+ *      TIM6 and DMA1 channel 1 are reserved for the microphone
+ *      loud_block is called from the DMA interrupt, it must not block
+ * References:
+ *      STM32L4+ HAL ADC/DMA driver - https://www.st.com/resource/en/user_manual/um1884-description-of-stm32l4l4-hal-and-lowlayer-drivers-stmicroelectronics.pdf
+ *      STM32L4+ Reference Manual, ADC and DMAMUX - https://www.st.com/resource/en/reference_manual/rm0432-stm32l4-series-advanced-armbased-32bit-mcus-stmicroelectronics.pdf
+ */
+#include "CSE321_project3_mabautis_mic_adc.h"
+#include "CSE321_project3_mabautis_dsp.h"
+#include "CSE321_project3_mabautis_trace.h"
+#include "CSE321_project3_mabautis_profile.h"
+#include "CSE321_project3_mabautis_telemetry.h"
+#include <mbed.h>
+
+static void mic_dma_irq(void); // DMA half/full transfer ISR that processes the block the DMA just finished
+static void process_block(const uint16_t *block); // Computes block stats and reports loud blocks
+
+static ADC_HandleTypeDef mic_adc; // ADC1 on PC_4
+static DMA_HandleTypeDef mic_dma; // DMA1 channel 1, circular over both buffers
+static TIM_HandleTypeDef mic_timer; // TIM6 paces the conversions
+
+// Double buffer: the DMA fills one half while the other half is processed
+alignas(4) static uint16_t samples[2 * MIC_BLOCK_SAMPLES];
+
+static void (*loud_callback)(void) = nullptr; // Called for every block over the threshold
+static volatile uint32_t threshold = MIC_DEFAULT_THRESHOLD_RMS;
+static volatile uint32_t level_rms = 0;
+static volatile uint32_t level_peak = 0;
+static int irq_slot = -1; // Profiler slot of mic_dma_irq
+
+void mic_adc_start(void (*loud_block)(void)) {
+  loud_callback = loud_block;
+  irq_slot = profile_slot("mic_dma_irq", PROFILE_ISR);
+
+  // PC_4 as analog input
+  __HAL_RCC_GPIOC_CLK_ENABLE();
+  GPIO_InitTypeDef pin = {0};
+  pin.Pin = GPIO_PIN_4;
+  pin.Mode = GPIO_MODE_ANALOG;
+  pin.Pull = GPIO_NOPULL;
+  HAL_GPIO_Init(GPIOC, &pin);
+
+  // TIM6 update event -> TRGO starts each conversion
+  __HAL_RCC_TIM6_CLK_ENABLE();
+  mic_timer.Instance = TIM6;
+  mic_timer.Init.Prescaler = SystemCoreClock / 1000000 - 1; // 1MHz timer clock
+  mic_timer.Init.CounterMode = TIM_COUNTERMODE_UP;
+  mic_timer.Init.Period = 1000000 / MIC_SAMPLE_RATE_HZ - 1;
+  mic_timer.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_ENABLE;
+  HAL_TIM_Base_Init(&mic_timer);
+  TIM_MasterConfigTypeDef master = {0};
+  master.MasterOutputTrigger = TIM_TRGO_UPDATE;
+  master.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
+  HAL_TIMEx_MasterConfigSynchronization(&mic_timer, &master);
+
+  // DMA1 channel 1 routed to ADC1 through the DMAMUX, circular over the double buffer
+  __HAL_RCC_DMAMUX1_CLK_ENABLE();
+  __HAL_RCC_DMA1_CLK_ENABLE();
+  mic_dma.Instance = DMA1_Channel1;
+  mic_dma.Init.Request = DMA_REQUEST_ADC1;
+  mic_dma.Init.Direction = DMA_PERIPH_TO_MEMORY;
+  mic_dma.Init.PeriphInc = DMA_PINC_DISABLE;
+  mic_dma.Init.MemInc = DMA_MINC_ENABLE;
+  mic_dma.Init.PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD;
+  mic_dma.Init.MemDataAlignment = DMA_MDATAALIGN_HALFWORD;
+  mic_dma.Init.Mode = DMA_CIRCULAR;
+  mic_dma.Init.Priority = DMA_PRIORITY_HIGH;
+  HAL_DMA_Init(&mic_dma);
+  __HAL_LINKDMA(&mic_adc, DMA_Handle, mic_dma);
+
+  // ADC1, one conversion per TIM6 trigger, every conversion requests a DMA transfer
+  __HAL_RCC_ADC_CLK_ENABLE();
+  __HAL_RCC_ADC_CONFIG(RCC_ADCCLKSOURCE_SYSCLK);
+  mic_adc.Instance = ADC1;
+  mic_adc.Init.ClockPrescaler = ADC_CLOCK_ASYNC_DIV4;
+  mic_adc.Init.Resolution = ADC_RESOLUTION_12B;
+  mic_adc.Init.DataAlign = ADC_DATAALIGN_RIGHT;
+  mic_adc.Init.ScanConvMode = ADC_SCAN_DISABLE;
+  mic_adc.Init.EOCSelection = ADC_EOC_SINGLE_CONV;
+  mic_adc.Init.LowPowerAutoWait = DISABLE;
+  mic_adc.Init.ContinuousConvMode = DISABLE;
+  mic_adc.Init.NbrOfConversion = 1;
+  mic_adc.Init.DiscontinuousConvMode = DISABLE;
+  mic_adc.Init.ExternalTrigConv = ADC_EXTERNALTRIG_T6_TRGO;
+  mic_adc.Init.ExternalTrigConvEdge = ADC_EXTERNALTRIGCONVEDGE_RISING;
+  mic_adc.Init.DMAContinuousRequests = ENABLE;
+  mic_adc.Init.Overrun = ADC_OVR_DATA_OVERWRITTEN;
+  mic_adc.Init.OversamplingMode = DISABLE;
+  HAL_ADC_Init(&mic_adc);
+
+  ADC_ChannelConfTypeDef channel = {0};
+  channel.Channel = ADC_CHANNEL_13;
+  channel.Rank = ADC_REGULAR_RANK_1;
+  channel.SamplingTime = ADC_SAMPLETIME_47CYCLES_5;
+  channel.SingleDiff = ADC_SINGLE_ENDED;
+  channel.OffsetNumber = ADC_OFFSET_NONE;
+  HAL_ADC_ConfigChannel(&mic_adc, &channel);
+  HAL_ADCEx_Calibration_Start(&mic_adc, ADC_SINGLE_ENDED);
+
+  // Half and full transfer interrupts, one per block. No per-sample interrupts
+  NVIC_SetVector(DMA1_Channel1_IRQn, (uint32_t)&mic_dma_irq);
+  NVIC_EnableIRQ(DMA1_Channel1_IRQn);
+
+  HAL_ADC_Start_DMA(&mic_adc, (uint32_t *)samples, 2 * MIC_BLOCK_SAMPLES);
+  HAL_TIM_Base_Start(&mic_timer);
+}
+
+static void mic_dma_irq(void) {
+  uint32_t start = profile_begin();
+  uint32_t flags = DMA1->ISR;
+  if (flags & DMA_ISR_HTIF1) { // First half full, DMA is now writing the second half
+    DMA1->IFCR = DMA_IFCR_CHTIF1;
+    process_block(&samples[0]);
+  }
+  if (flags & DMA_ISR_TCIF1) { // Second half full, DMA wrapped to the first half
+    DMA1->IFCR = DMA_IFCR_CTCIF1;
+    process_block(&samples[MIC_BLOCK_SAMPLES]);
+  }
+  if (flags & DMA_ISR_TEIF1) {
+    DMA1->IFCR = DMA_IFCR_CTEIF1;
+  }
+  profile_end(irq_slot, start);
+}
+
+static void process_block(const uint16_t *block) {
+  BlockStats stats;
+  block_stats(block, MIC_BLOCK_SAMPLES, &stats);
+  level_rms = stats.rms;
+  level_peak = stats.peak;
+  trace_level(TRACE_MIC, 0, stats.rms);
+  telemetry_log(TELEMETRY_MIC, 0, stats.rms);
+  if (stats.rms >= threshold && loud_callback) {
+    loud_callback();
+  }
+}
+
+void set_mic_threshold(uint32_t rms) { threshold = rms; }
+
+uint32_t mic_threshold(void) { return threshold; }
+
+uint32_t mic_level_rms(void) { return level_rms; }
+
+uint32_t mic_level_peak(void) { return level_peak; }
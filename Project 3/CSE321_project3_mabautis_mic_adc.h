@@ -0,0 +1,44 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: Samples the microphone analog output with ADC1 + DMA and reports block loudness
+ *
+ * Modules:
+ *      CSE321_project3_mabautis_dsp - Block RMS and peak computation
+ *
+ * Subroutines:
+ * void mic_adc_start(void (*loud_block)(void)) - Starts timer triggered sampling into the double buffer
+ * void set_mic_threshold(uint32_t rms) - Sets the RMS level (ADC counts) that counts as a loud block
+ * uint32_t mic_threshold(void) - RMS level that counts as a loud block
+ * uint32_t mic_level_rms(void) - RMS of the last block in ADC counts
+ * uint32_t mic_level_peak(void) - Peak of the last block in ADC counts
+ * void mic_dma_irq(void) - DMA half/full transfer ISR that processes the block the DMA just finished
+ *
+ * Assignment: Project 3
+ * Inputs:
+ *      Microphone analog output - PC_4 (ADC1_IN13)
+ * Outputs:
+ * Constraints:
+ *      TIM6 and DMA1 channel 1 are reserved for the microphone
+ *      loud_block is called from the DMA interrupt, it must not block
+ * References:
+ *      STM32L4+ HAL ADC/DMA driver - https://www.st.com/resource/en/user_manual/um1884-description-of-stm32l4l4-hal-and-lowlayer-drivers-stmicroelectronics.pdf
+ *      STM32L4+ Reference Manual, ADC and DMAMUX - https://www.st.com/resource/en/reference_manual/rm0432-stm32l4-series-advanced-armbased-32bit-mcus-stmicroelectronics.pdf
+ */
+#ifndef CSE321_PROJECT3_MABAUTIS_MIC_ADC_H
+#define CSE321_PROJECT3_MABAUTIS_MIC_ADC_H
+
+#include <stdint.h>
+
+#define MIC_SAMPLE_RATE_HZ 8000     // ADC conversions per second (TIM6 trigger)
+#define MIC_BLOCK_SAMPLES 256       // Samples per block, one interrupt per block (32ms)
+#define MIC_DEFAULT_THRESHOLD_RMS 300 // Default loud block level in ADC counts
+#define MIC_MAX_THRESHOLD_RMS 4095    // Full scale of the 12 bit ADC
+
+void mic_adc_start(void (*loud_block)(void)); // Starts timer triggered sampling into the double buffer
+void set_mic_threshold(uint32_t rms); // Sets the RMS level (ADC counts) that counts as a loud block
+uint32_t mic_threshold(void); // RMS level that counts as a loud block
+uint32_t mic_level_rms(void); // RMS of the last block in ADC counts
+uint32_t mic_level_peak(void); // Peak of the last block in ADC counts
+
+#endif
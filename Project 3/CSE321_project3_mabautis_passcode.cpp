@@ -0,0 +1,48 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: Fixed capacity passcode storage. Digits live in a static array inside the struct,
+ *               so defining, entering and checking a passcode never touches the heap
+ *
+ * Modules:
+ *
+ * Subroutines:
+ * void passcode_clear(Passcode *code) - Empties the passcode and zeroes every digit slot
+ * int passcode_push(Passcode *code, char digit) - Appends a digit, returns 1 once PASSCODE_LENGTH digits are in
+ * int passcode_length(const Passcode *code) - Digits entered so far
+ * int passcode_equal(const Passcode *a, const Passcode *b) - Returns 1 if both passcodes match, in constant time
+ *
+ * Assignment: Project 3
+ * Inputs:
+ * Outputs:
+ * Constraints:
+ *      passcode_equal always reads all PASSCODE_MAX slots, so its time does not depend on where the codes differ
+ * References:
+ */
+#include "CSE321_project3_mabautis_passcode.h"
+
+void passcode_clear(Passcode *code) {
+  volatile char *digits = code->digits; // Volatile so the wipe is not optimized away
+  for (int i = 0; i < PASSCODE_MAX; i++) {
+    digits[i] = 0;
+  }
+  code->length = 0;
+}
+
+int passcode_push(Passcode *code, char digit) {
+  if (code->length < PASSCODE_LENGTH) {
+    code->digits[code->length++] = digit;
+  }
+  return code->length == PASSCODE_LENGTH;
+}
+
+int passcode_length(const Passcode *code) { return code->length; }
+
+int passcode_equal(const Passcode *a, const Passcode *b) {
+  // OR every difference together instead of returning at the first mismatch
+  uint8_t difference = a->length ^ b->length;
+  for (int i = 0; i < PASSCODE_MAX; i++) {
+    difference |= a->digits[i] ^ b->digits[i];
+  }
+  return difference == 0;
+}
@@ -0,0 +1,52 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: Fixed capacity passcode storage. Digits live in a static array inside the struct,
+ *               so defining, entering and checking a passcode never touches the heap
+ *
+ * Modules:
+ *
+ * Subroutines:
+ * void passcode_clear(Passcode *code) - Empties the passcode and zeroes every digit slot
+ * int passcode_push(Passcode *code, char digit) - Appends a digit, returns 1 once PASSCODE_LENGTH digits are in
+ * int passcode_length(const Passcode *code) - Digits entered so far
+ * int passcode_equal(const Passcode *a, const Passcode *b) - Returns 1 if both passcodes match, in constant time
+ *
+ * Assignment: Project 3
+ * Inputs:
+ * Outputs:
+ * Constraints:
+ *      PASSCODE_LENGTH is set at build time with the passcode-length option in mbed_app.json (4 to 8 digits)
+ *      passcode_equal always reads all PASSCODE_MAX slots, so its time does not depend on where the codes differ
+ *      Header has no mbed dependencies so host tools can use the passcode without the emulator
+ * References:
+ */
+#ifndef CSE321_PROJECT3_MABAUTIS_PASSCODE_H
+#define CSE321_PROJECT3_MABAUTIS_PASSCODE_H
+
+#include <stdint.h>
+
+#define PASSCODE_MIN 4 // Shortest supported passcode
+#define PASSCODE_MAX 8 // Digit slots in every Passcode
+
+#ifndef PASSCODE_LENGTH
+#ifdef MBED_CONF_APP_PASSCODE_LENGTH
+#define PASSCODE_LENGTH MBED_CONF_APP_PASSCODE_LENGTH // mbed_app.json "passcode-length"
+#else
+#define PASSCODE_LENGTH 4
+#endif
+#endif
+
+static_assert(PASSCODE_LENGTH >= PASSCODE_MIN && PASSCODE_LENGTH <= PASSCODE_MAX, "passcode-length must be 4 to 8");
+
+struct Passcode {
+  char digits[PASSCODE_MAX]; // Entered digits, unused slots are 0
+  uint8_t length;            // Digits entered so far
+};
+
+void passcode_clear(Passcode *code); // Empties the passcode and zeroes every digit slot
+int passcode_push(Passcode *code, char digit); // Appends a digit, returns 1 once PASSCODE_LENGTH digits are in
+int passcode_length(const Passcode *code); // Digits entered so far
+int passcode_equal(const Passcode *a, const Passcode *b); // Returns 1 if both passcodes match, in constant time
+
+#endif
@@ -0,0 +1,51 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: CPU load profiler. ISRs, thread loops and queued events add the DWT cycles they
+ *               take to a fixed table, printed as a "top" style breakdown
+ *
+ * Modules:
+ *
+ * Subroutines:
+ * void profile_start(void) - Turns on the cycle counter and starts the first window
+ * int profile_slot(const char *name, int kind) - Adds a named slot to the table, returns its id (-1 -> table full)
+ * uint32_t profile_begin(void) - Cycle count at the start of a profiled section
+ * void profile_end(int slot, uint32_t start) - Adds the cycles since start to a slot
+ * void profile_print(void) - Prints every slot sorted by CPU time and starts a new window
+ *
+ * Assignment: Project 3
+ * Inputs:
+ * Outputs:
+ *      USB serial (STDIO), one line per slot: kind, calls, CPU %, average and worst case us
+ * Constraints:
+ *      Slots are added at startup, before their code runs. Names must be string literals
+ *      Sections are timed start to end, so thread and event figures include the ISRs and higher
+ *      priority threads that ran in between. ISRs are also listed on their own
+ *      A window longer than one us_ticker wrap (~71 minutes) shows wrong percentages
+ *      One section must take less than 2^32 cycles (~35s at 120MHz)
+ * References:
+ *      ARMv7-M Architecture Reference Manual, DWT - https://developer.arm.com/documentation/ddi0403/latest
+ */
+#ifndef CSE321_PROJECT3_MABAUTIS_PROFILE_H
+#define CSE321_PROJECT3_MABAUTIS_PROFILE_H
+
+#include <mbed.h>
+#include <stdint.h>
+
+#define PROFILE_SLOTS 24 // Profiled ISRs, threads and events
+
+enum ProfileKind {
+  PROFILE_ISR = 0,    // Interrupt handler
+  PROFILE_THREAD = 1, // One pass of a thread loop, sleeps excluded
+  PROFILE_EVENT = 2,  // Event queue handler
+  PROFILE_KIND_COUNT
+};
+
+void profile_start(void); // Turns on the cycle counter and starts the first window
+int profile_slot(const char *name, int kind); // Adds a named slot to the table, returns its id (-1 -> table full)
+void profile_end(int slot, uint32_t start); // Adds the cycles since start to a slot
+void profile_print(void); // Prints every slot sorted by CPU time and starts a new window
+
+inline uint32_t profile_begin(void) { return DWT->CYCCNT; } // Cycle count at the start of a profiled section
+
+#endif
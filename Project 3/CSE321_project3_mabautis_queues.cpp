@@ -0,0 +1,36 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: Priority separated event queues. Security work runs on a high priority alarm
+ *               thread and display work on main, so a trip never waits behind an LCD redraw
+ *
+ * Modules:
+ *      CSE321_project3_mabautis_memory - Watches both queue buffers and sizes the alarm thread stack
+ *
+ * Subroutines:
+ * void queues_start(void) - Watches both queue buffers and starts the alarm thread
+ *
+ * Assignment: Project 3
+ * Inputs:
+ * Outputs:
+ * Constraints:
+ *      See the routing rules in the header
+ * References:
+ *      MBED EventQueue - https://os.mbed.com/docs/mbed-os/v6.15/apis/eventqueue.html
+ */
+#include "CSE321_project3_mabautis_queues.h"
+#include "CSE321_project3_mabautis_memory.h"
+
+static unsigned char alarm_buffer[EVENTS_QUEUE_SIZE]; // Event storage, watched by the memory report
+static unsigned char ui_buffer[EVENTS_QUEUE_SIZE];
+
+EventQueue alarm_queue(sizeof(alarm_buffer), alarm_buffer);
+EventQueue ui_queue(sizeof(ui_buffer), ui_buffer);
+
+static Thread alarm_thread(ALARM_PRIORITY, ALARM_STACK_SIZE, nullptr, "alarm");
+
+void queues_start(void) {
+  memory_watch_queue("alarm", alarm_buffer, sizeof(alarm_buffer));
+  memory_watch_queue("ui", ui_buffer, sizeof(ui_buffer));
+  alarm_thread.start(callback(&alarm_queue, &EventQueue::dispatch_forever));
+}
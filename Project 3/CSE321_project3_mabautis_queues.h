@@ -0,0 +1,41 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: Priority separated event queues. Security work runs on a high priority alarm
+ *               thread and display work on main, so a trip never waits behind an LCD redraw
+ *
+ * Modules:
+ *      CSE321_project3_mabautis_memory - Watches both queue buffers and sizes the alarm thread stack
+ *
+ * Subroutines:
+ * void queues_start(void) - Watches both queue buffers and starts the alarm thread
+ *
+ * Assignment: Project 3
+ * Inputs:
+ * Outputs:
+ * Constraints:
+ *      Routing, post work with alarm_queue.call / ui_queue.call:
+ *        alarm_queue - Sensor trips and anything else that must change the alarm state right away.
+ *                      Handlers take alarm_lock, run the state machine and start or stop the outputs.
+ *                      They never write the LCD, sleep or print
+ *        ui_queue    - Every LCD write (prompts, messages, passcode stars, backlight), the idle
+ *                      timeout and message timers. Handlers may take alarm_lock for a short read
+ *      State machine actions run on whichever thread dispatched the event, so they post their LCD
+ *      work to ui_queue instead of drawing. The LCD is only ever written from the main thread
+ *      queues_start must run before anything is posted (the memory report fills the buffers)
+ * References:
+ *      MBED EventQueue - https://os.mbed.com/docs/mbed-os/v6.15/apis/eventqueue.html
+ */
+#ifndef CSE321_PROJECT3_MABAUTIS_QUEUES_H
+#define CSE321_PROJECT3_MABAUTIS_QUEUES_H
+
+#include <mbed.h>
+
+#define ALARM_PRIORITY osPriorityAboveNormal // Above the keypad threads and main (osPriorityNormal)
+
+extern EventQueue alarm_queue; // Security work, dispatched by the alarm thread
+extern EventQueue ui_queue;    // Display work, dispatched by main
+
+void queues_start(void); // Watches both queue buffers and starts the alarm thread
+
+#endif
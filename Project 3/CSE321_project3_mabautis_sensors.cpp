@@ -0,0 +1,198 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: Sensor zone registry. Zones are declared in a table, each with a Sensor driver, and
+ *               one scheduler ticker and one pin interrupt handler serve every zone
+ *
+ * Modules:
+ *      CSE321_project3_mabautis_filter - Per zone confirmation filters
+ *      CSE321_project3_mabautis_mic_adc - Microphone sampling used by the microphone driver
+ *      CSE321_project3_mabautis_profile - CPU time of the zone interrupt and scheduler tick
+ *
+ * Subroutines:
+ * void sensors_start(const Zone *zones, int count, void (*on_trip)(int zone)) - Starts every zone in the table and the scheduler
+ * void sensors_set_mode(int mode, int armed) - Sets the system mode used for poll rates and whether trips are reported
+ * int sensors_mode(void) - System mode used for poll rates
+ * int sensors_armed(void) - Returns 1 if trips are reported (system armed)
+ * void zone_set_armed(int zone, int armed) - Arms or bypasses one zone
+ * int zone_armed(int zone) - Returns 1 if the zone can trip the alarm
+ * void zone_trip(int zone) - Called by drivers when a zone confirms a detection (ISR safe)
+ * void zone_poll_in(int zone, uint32_t ms) - Brings the zone's next poll forward
+ * int zone_count(void) - Number of zones in the table
+ * const Zone *zone_info(int zone) - Table entry of a zone
+ * ZoneState *zone_state(int zone) - Runtime state of a zone, for drivers
+ * void zone_irq(uint32_t zone, gpio_irq_event event) - Pin interrupt shared by every zone input
+ * void scheduler_tick(void) - Ticker ISR that polls the zones that are due
+ *
+ * Assignment: Project 3
+ * Inputs:
+ *      Every zone input pin (sonar echo, contact, PIR) and the microphone
+ * Outputs:
+ *      Sonar trigger pins
+ * Constraints:
+ *      At most ZONE_MAX zones. The microphone driver supports one zone (ADC1 on PC_4)
+ *      on_trip is called from interrupt context, it must not block
+ *      Poll periods are rounded up to SENSOR_TICK_MS
+ * References:
+ *      MBED GPIO HAL - https://os.mbed.com/docs/mbed-os/v6.15/mbed-os-api-doxy/group__hal__gpio.html
+ */
+#include "CSE321_project3_mabautis_sensors.h"
+#include "CSE321_project3_mabautis_mic_adc.h"
+#include "CSE321_project3_mabautis_profile.h"
+
+static void zone_irq(uint32_t zone, gpio_irq_event event); // Pin interrupt shared by every zone input
+static void scheduler_tick(void); // Ticker ISR that polls the zones that are due
+
+static const Zone *zone_table = nullptr;
+static int zones = 0;
+static ZoneState states[ZONE_MAX];
+static void (*trip_callback)(int zone) = nullptr;
+static volatile int system_mode = 0; // Mode used to pick poll rates
+static volatile int system_armed = 0; // Trips are only reported while the system is armed
+
+static Ticker scheduler_ticker; // Single ticker for every polled zone
+static int irq_slot = -1; // Profiler slot of zone_irq
+static int tick_slot = -1; // Profiler slot of scheduler_tick
+
+static uint16_t ms_to_ticks(uint32_t ms) {
+  return (ms + SENSOR_TICK_MS - 1) / SENSOR_TICK_MS; // 0 stays 0 (not scheduled)
+}
+
+void sensors_start(const Zone *table, int count, void (*on_trip)(int zone)) {
+  zone_table = table;
+  zones = count > ZONE_MAX ? ZONE_MAX : count;
+  trip_callback = on_trip;
+  irq_slot = profile_slot("zone_irq", PROFILE_ISR);
+  tick_slot = profile_slot("sensor_tick", PROFILE_ISR);
+  for (int i = 0; i < zones; i++) {
+    const Sensor *sensor = zone_table[i].sensor;
+    states[i].armed = 1; // Every zone starts armed
+    sensor->start(i);
+    if (sensor->edge && zone_table[i].input != NC) {
+      gpio_t input; // Only needed to set the pull, the interrupt reports the edge direction
+      gpio_init_in_ex(&input, zone_table[i].input, PullDown);
+      gpio_irq_init(&states[i].irq, zone_table[i].input, &zone_irq, i);
+      gpio_irq_set(&states[i].irq, IRQ_RISE, 1);
+      gpio_irq_set(&states[i].irq, IRQ_FALL, 1);
+      gpio_irq_enable(&states[i].irq);
+    }
+  }
+  sensors_set_mode(system_mode, system_armed);
+  scheduler_ticker.attach(&scheduler_tick, std::chrono::milliseconds(SENSOR_TICK_MS));
+}
+
+void sensors_set_mode(int mode, int armed) {
+  core_util_critical_section_enter(); // Countdowns are also changed by the scheduler and drivers
+  system_mode = mode;
+  system_armed = armed;
+  for (int i = 0; i < zones; i++) {
+    const Sensor *sensor = zone_table[i].sensor;
+    states[i].burst_left = 0;
+    if (sensor->reset) {
+      sensor->reset(i); // Detections from the last mode do not count
+    }
+    states[i].countdown = (sensor->poll && sensor->period_ms) ? ms_to_ticks(sensor->period_ms(i)) : 0;
+  }
+  core_util_critical_section_exit();
+}
+
+int sensors_mode(void) { return system_mode; }
+
+int sensors_armed(void) { return system_armed; }
+
+void zone_set_armed(int zone, int armed) {
+  if (zone >= 0 && zone < zones) {
+    states[zone].armed = armed;
+  }
+}
+
+int zone_armed(int zone) { return zone >= 0 && zone < zones && states[zone].armed; }
+
+void zone_trip(int zone) {
+  if (system_armed && states[zone].armed && trip_callback) {
+    trip_callback(zone);
+  }
+}
+
+void zone_poll_in(int zone, uint32_t ms) {
+  uint16_t ticks = ms_to_ticks(ms);
+  core_util_critical_section_enter();
+  if (!states[zone].countdown || ticks < states[zone].countdown) {
+    states[zone].countdown = ticks;
+  }
+  core_util_critical_section_exit();
+}
+
+int zone_count(void) { return zones; }
+
+const Zone *zone_info(int zone) { return &zone_table[zone]; }
+
+ZoneState *zone_state(int zone) { return &states[zone]; }
+
+static void zone_irq(uint32_t zone, gpio_irq_event event) {
+  uint32_t start = profile_begin();
+  if (event != IRQ_NONE) {
+    zone_table[zone].sensor->edge(zone, event == IRQ_RISE);
+  }
+  profile_end(irq_slot, start);
+}
+
+static void scheduler_tick(void) {
+  uint32_t start = profile_begin();
+  for (int i = 0; i < zones; i++) {
+    ZoneState &state = states[i];
+    if (!state.countdown || --state.countdown) {
+      continue; // Not scheduled or not due yet
+    }
+    const Sensor *sensor = zone_table[i].sensor;
+    if (!sensor->poll(i)) {
+      state.countdown = 1; // Busy (another sonar's echo in flight), retry next tick
+      continue;
+    }
+    state.countdown = ms_to_ticks(sensor->period_ms(i));
+  }
+  profile_end(tick_slot, start);
+}
+
+// Microphone driver: the DMA interrupt reports loud blocks, several in a window trip the zone
+
+static int mic_zone = -1; // Zone using the ADC microphone
+
+static void mic_loud_block(void) {
+  uint32_t now_ms = Kernel::Clock::now().time_since_epoch().count();
+  if (edge_rate_push(&states[mic_zone].filter.rate, now_ms)) {
+    zone_trip(mic_zone);
+  }
+}
+
+static void mic_start(int zone) {
+  if (mic_zone >= 0) {
+    return; // Only one ADC microphone channel
+  }
+  mic_zone = zone;
+  EdgeRateFilter &rate = states[zone].filter.rate;
+  rate.edges = MIC_CONFIRM_BLOCKS;
+  rate.window_ms = MIC_CONFIRM_WINDOW_MS;
+  edge_rate_reset(&rate);
+  mic_adc_start(&mic_loud_block);
+}
+
+static void mic_reset(int zone) {
+  if (zone == mic_zone) {
+    edge_rate_reset(&states[zone].filter.rate);
+  }
+}
+
+const Sensor microphone_sensor = {SENSOR_MICROPHONE, &mic_start, nullptr, nullptr, nullptr, &mic_reset};
+
+// Contact and PIR driver: the output goes high on an open door or motion
+
+static void contact_start(int zone) {}
+
+static void contact_edge(int zone, int rising) {
+  if (rising) {
+    zone_trip(zone);
+  }
+}
+
+const Sensor contact_sensor = {SENSOR_CONTACT, &contact_start, &contact_edge, nullptr, nullptr, nullptr};
@@ -0,0 +1,107 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: Sensor zone registry. Zones are declared in a table, each with a Sensor driver, and
+ *               one scheduler ticker and one pin interrupt handler serve every zone
+ *
+ * Modules:
+ *      CSE321_project3_mabautis_filter - Per zone confirmation filters
+ *      CSE321_project3_mabautis_mic_adc - Microphone sampling used by the microphone driver
+ *
+ * Subroutines:
+ * void sensors_start(const Zone *zones, int count, void (*on_trip)(int zone)) - Starts every zone in the table and the scheduler
+ * void sensors_set_mode(int mode, int armed) - Sets the system mode used for poll rates and whether trips are reported
+ * int sensors_mode(void) - System mode used for poll rates
+ * int sensors_armed(void) - Returns 1 if trips are reported (system armed)
+ * void zone_set_armed(int zone, int armed) - Arms or bypasses one zone
+ * int zone_armed(int zone) - Returns 1 if the zone can trip the alarm
+ * void zone_trip(int zone) - Called by drivers when a zone confirms a detection (ISR safe)
+ * void zone_poll_in(int zone, uint32_t ms) - Brings the zone's next poll forward
+ * int zone_count(void) - Number of zones in the table
+ * const Zone *zone_info(int zone) - Table entry of a zone
+ * ZoneState *zone_state(int zone) - Runtime state of a zone, for drivers
+ *
+ * Assignment: Project 3
+ * Inputs:
+ *      Every zone input pin (sonar echo, contact, PIR) and the microphone
+ * Outputs:
+ *      Sonar trigger pins
+ * Constraints:
+ *      At most ZONE_MAX zones. The microphone driver supports one zone (ADC1 on PC_4)
+ *      on_trip is called from interrupt context, it must not block
+ *      Poll periods are rounded up to SENSOR_TICK_MS
+ * References:
+ *      MBED GPIO HAL - https://os.mbed.com/docs/mbed-os/v6.15/mbed-os-api-doxy/group__hal__gpio.html
+ */
+#ifndef CSE321_PROJECT3_MABAUTIS_SENSORS_H
+#define CSE321_PROJECT3_MABAUTIS_SENSORS_H
+
+#include <mbed.h>
+#include <stdint.h>
+#include "CSE321_project3_mabautis_filter.h"
+
+#define ZONE_MAX 8        // Zones the registry can hold
+#define SENSOR_TICK_MS 10 // Scheduler resolution
+
+// Microphone trips need several loud blocks (32ms each) within a window
+#define MIC_CONFIRM_BLOCKS 3
+#define MIC_CONFIRM_WINDOW_MS 200
+
+enum SensorKind {
+  SENSOR_ULTRASONIC = 0, // HC-SR04, polled by the scheduler, echo timed on the input pin
+  SENSOR_MICROPHONE = 1, // ADC + DMA, loud blocks reported from the DMA interrupt
+  SENSOR_CONTACT = 2,    // Contact switch or PIR output, trips on a rising edge
+  SENSOR_KIND_COUNT
+};
+
+// Interface every sensor driver implements. Unused hooks are nullptr
+struct Sensor {
+  int kind;                                 // SensorKind
+  void (*start)(int zone);                  // Sets up the zone's outputs and filters
+  void (*edge)(int zone, int rising);       // Input pin changed (nullptr -> input pin not used)
+  uint32_t (*period_ms)(int zone);          // Time to the next poll in the current mode (0 -> not polled)
+  int (*poll)(int zone);                    // Runs when the zone is due, returns 0 to retry on the next tick
+  void (*reset)(int zone);                  // Forgets partial detections when the mode changes
+};
+
+// Registry entry, declared in a const table by the application
+struct Zone {
+  const char *name;     // Shown on the LCD when the zone trips
+  const Sensor *sensor; // Driver for the zone's sensor
+  PinName input;        // Echo, contact or PIR pin (NC -> none)
+  PinName output;       // Sonar trigger pin (NC -> none)
+};
+
+// Runtime state of a zone, the only per sensor RAM
+struct ZoneState {
+  gpio_irq_t irq;        // Input pin interrupt
+  gpio_t output;         // Trigger pin
+  uint32_t edge_us;      // Time of the last rising edge
+  uint16_t last_mm;      // Last sonar reading
+  uint16_t countdown;    // Scheduler ticks to the next poll (0 -> not scheduled)
+  uint8_t armed;         // Zone can trip the alarm
+  uint8_t burst_left;    // Sonar pings left at the burst rate
+  Confirmation confirm;  // Sonar M of N hits
+  union {
+    DistanceFilter distance; // Sonar median and EMA
+    EdgeRateFilter rate;     // Microphone loud block rate
+  } filter;
+};
+
+extern const Sensor microphone_sensor; // Driver for the ADC microphone
+extern const Sensor contact_sensor;    // Driver for contact switches and PIR outputs
+
+void sensors_start(const Zone *zones, int count, void (*on_trip)(int zone)); // Starts every zone in the table and the scheduler
+void sensors_set_mode(int mode, int armed); // Sets the system mode used for poll rates and whether trips are reported
+int sensors_mode(void); // System mode used for poll rates
+int sensors_armed(void); // Returns 1 if trips are reported (system armed)
+
+void zone_set_armed(int zone, int armed); // Arms or bypasses one zone
+int zone_armed(int zone); // Returns 1 if the zone can trip the alarm
+void zone_trip(int zone); // Called by drivers when a zone confirms a detection (ISR safe)
+void zone_poll_in(int zone, uint32_t ms); // Brings the zone's next poll forward
+int zone_count(void); // Number of zones in the table
+const Zone *zone_info(int zone); // Table entry of a zone
+ZoneState *zone_state(int zone); // Runtime state of a zone, for drivers
+
+#endif
@@ -0,0 +1,165 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: Siren and strobe engine. TIM4 drives the buzzer and the alarm LEDs as two PWM
+ *               channels and DMA reloads each step from a table, so a running pattern costs no CPU
+ *
+ * Modules:
+ *      CSE321_project3_mabautis_profile - CPU time of the phase escalation ISR
+ *
+ * Subroutines:
+ * void siren_init(void) - Sets up TIM4, its output pins and the step DMA, outputs off
+ * void siren_start(const SirenPhase *phases, int count) - Plays the phases in order, the last one until stopped
+ * void siren_stop(void) - Stops the siren and drives both outputs low
+ * int siren_phase(void) - Index of the phase playing (-1 -> stopped)
+ * void play_phase(int phase) - Loads a phase's steps into the timer and restarts the DMA
+ * void next_phase(void) - Timeout ISR that escalates to the next phase
+ * void outputs_off(void) - Stops the timer and forces both outputs low
+ *
+ * Assignment: Project 3
+ * Inputs:
+ * Outputs:
+ *      Active buzzer - PD_14 (TIM4_CH3)
+ *      Alarm LEDs - PD_15 (TIM4_CH4)
+ * Constraints:
+ *      Each step is one timer period in PWM mode 1: ARR is the period and CCR3/CCR4 the on times.
+ *      On every update event the timer asks the DMA for a burst that writes the next step's ARR,
+ *      RCR, CCR1, CCR2, CCR3 and CCR4 (TIM4 ignores RCR, CH1/CH2 are not connected). The registers
+ *      are preloaded, so the burst during step k is the step that plays at k + 1
+ * References:
+ *      STM32L4+ Reference Manual, TIM2/3/4/5 DMA burst mode - https://www.st.com/resource/en/reference_manual/rm0432-stm32l4-series-advanced-armbased-32bit-mcus-stmicroelectronics.pdf
+ *      MBED Timeout - https://os.mbed.com/docs/mbed-os/v6.15/apis/timeout.html
+ */
+#include "CSE321_project3_mabautis_siren.h"
+#include "CSE321_project3_mabautis_profile.h"
+#include <mbed.h>
+
+#define SIREN_TIMER_HZ 10000 // TIM4 counts in 0.1ms
+#define BURST_WORDS 6        // ARR, RCR, CCR1, CCR2, CCR3, CCR4
+
+static void play_phase(int phase); // Loads a phase's steps into the timer and restarts the DMA
+static void next_phase(void); // Timeout ISR that escalates to the next phase
+static void outputs_off(void); // Stops the timer and forces both outputs low
+
+static DMA_HandleTypeDef siren_dma; // DMA1 channel 2 on the TIM4 update request
+static uint32_t burst[SIREN_STEPS_MAX][BURST_WORDS]; // Register image of the playing phase, read by the DMA
+
+static const SirenPhase *phase_table = nullptr;
+static int phase_count = 0;
+static volatile int current_phase = -1;
+
+static Timeout phase_timeout; // Escalates to the next phase
+static int phase_slot = -1; // Profiler slot of next_phase
+
+static uint32_t ms_to_counts(uint32_t ms) { return ms * (SIREN_TIMER_HZ / 1000); }
+
+void siren_init(void) {
+  phase_slot = profile_slot("siren_phase", PROFILE_ISR);
+  // PD_14 and PD_15 as TIM4 channel 3 and 4 outputs
+  __HAL_RCC_GPIOD_CLK_ENABLE();
+  GPIO_InitTypeDef pins = {0};
+  pins.Pin = GPIO_PIN_14 | GPIO_PIN_15;
+  pins.Mode = GPIO_MODE_AF_PP;
+  pins.Pull = GPIO_NOPULL;
+  pins.Speed = GPIO_SPEED_FREQ_LOW;
+  pins.Alternate = GPIO_AF2_TIM4;
+  HAL_GPIO_Init(GPIOD, &pins);
+
+  // TIM4 counting at 10kHz, PWM mode 1 with preloaded ARR and CCRs so a step only changes on an update
+  __HAL_RCC_TIM4_CLK_ENABLE();
+  TIM4->CR1 = TIM_CR1_ARPE;
+  TIM4->PSC = SystemCoreClock / SIREN_TIMER_HZ - 1;
+  TIM4->CCER = TIM_CCER_CC3E | TIM_CCER_CC4E;
+  TIM4->DCR = TIM_DMABASE_ARR | TIM_DMABURSTLENGTH_6TRANSFERS; // Each update request writes ARR..CCR4
+  outputs_off();
+
+  // DMA1 channel 2 routed to the TIM4 update request through the DMAMUX, circular over the steps
+  __HAL_RCC_DMAMUX1_CLK_ENABLE();
+  __HAL_RCC_DMA1_CLK_ENABLE();
+  siren_dma.Instance = DMA1_Channel2;
+  siren_dma.Init.Request = DMA_REQUEST_TIM4_UP;
+  siren_dma.Init.Direction = DMA_MEMORY_TO_PERIPH;
+  siren_dma.Init.PeriphInc = DMA_PINC_DISABLE; // Always TIM4->DMAR, the timer walks the registers
+  siren_dma.Init.MemInc = DMA_MINC_ENABLE;
+  siren_dma.Init.PeriphDataAlignment = DMA_PDATAALIGN_WORD;
+  siren_dma.Init.MemDataAlignment = DMA_MDATAALIGN_WORD;
+  siren_dma.Init.Mode = DMA_CIRCULAR;
+  siren_dma.Init.Priority = DMA_PRIORITY_LOW; // The microphone DMA comes first
+  HAL_DMA_Init(&siren_dma);
+}
+
+void siren_start(const SirenPhase *phases, int count) {
+  core_util_critical_section_enter(); // The phase timeout also calls play_phase
+  phase_table = phases;
+  phase_count = count;
+  play_phase(0);
+  core_util_critical_section_exit();
+}
+
+void siren_stop(void) {
+  core_util_critical_section_enter();
+  phase_timeout.detach();
+  current_phase = -1;
+  HAL_DMA_Abort(&siren_dma);
+  outputs_off();
+  core_util_critical_section_exit();
+}
+
+int siren_phase(void) { return current_phase; }
+
+static void play_phase(int phase) {
+  const SirenPhase &p = phase_table[phase];
+  int steps = p.step_count > SIREN_STEPS_MAX ? SIREN_STEPS_MAX : p.step_count;
+
+  TIM4->CR1 &= ~TIM_CR1_CEN;
+  TIM4->DIER &= ~TIM_DIER_UDE;
+  HAL_DMA_Abort(&siren_dma);
+
+  // Step 0 goes straight into the timer and step 1 into the preload registers. The DMA then
+  // supplies steps 2, 3, ... so the burst image starts two steps in
+  for (int i = 0; i < steps; i++) {
+    const SirenStep &step = p.steps[(i + 2) % steps];
+    burst[i][0] = ms_to_counts(step.period_ms) - 1;
+    burst[i][1] = 0;
+    burst[i][2] = 0;
+    burst[i][3] = 0;
+    burst[i][4] = ms_to_counts(step.buzzer_ms); // Equal to the period -> on for the whole step
+    burst[i][5] = ms_to_counts(step.strobe_ms);
+  }
+  const SirenStep &first = p.steps[0];
+  TIM4->ARR = ms_to_counts(first.period_ms) - 1;
+  TIM4->CCR3 = ms_to_counts(first.buzzer_ms);
+  TIM4->CCR4 = ms_to_counts(first.strobe_ms);
+  TIM4->CCMR2 = (6 << TIM_CCMR2_OC3M_Pos) | TIM_CCMR2_OC3PE | (6 << TIM_CCMR2_OC4M_Pos) | TIM_CCMR2_OC4PE; // PWM mode 1
+  TIM4->CNT = 0;
+  TIM4->EGR = TIM_EGR_UG; // Loads step 0, UDE is off so no burst yet
+  TIM4->SR = 0;
+  const SirenStep &second = p.steps[1 % steps];
+  TIM4->ARR = ms_to_counts(second.period_ms) - 1;
+  TIM4->CCR3 = ms_to_counts(second.buzzer_ms);
+  TIM4->CCR4 = ms_to_counts(second.strobe_ms);
+
+  HAL_DMA_Start(&siren_dma, (uint32_t)burst, (uint32_t)&TIM4->DMAR, steps * BURST_WORDS);
+  TIM4->DIER |= TIM_DIER_UDE;
+  TIM4->CR1 |= TIM_CR1_CEN; // Outputs go high right away for steps that start on
+
+  current_phase = phase;
+  phase_timeout.detach();
+  if (p.duration_ms != SIREN_FOREVER && phase + 1 < phase_count) {
+    phase_timeout.attach(&next_phase, std::chrono::milliseconds(p.duration_ms));
+  }
+}
+
+static void next_phase(void) {
+  uint32_t start = profile_begin();
+  if (current_phase >= 0 && current_phase + 1 < phase_count) {
+    play_phase(current_phase + 1);
+  }
+  profile_end(phase_slot, start);
+}
+
+static void outputs_off(void) {
+  TIM4->CR1 &= ~TIM_CR1_CEN;
+  TIM4->DIER &= ~TIM_DIER_UDE;
+  TIM4->CCMR2 = (4 << TIM_CCMR2_OC3M_Pos) | (4 << TIM_CCMR2_OC4M_Pos); // Forced inactive -> both pins low
+}
@@ -0,0 +1,56 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: Siren and strobe engine. TIM4 drives the buzzer and the alarm LEDs as two PWM
+ *               channels and DMA reloads each step from a table, so a running pattern costs no CPU
+ *
+ * Modules:
+ *
+ * Subroutines:
+ * void siren_init(void) - Sets up TIM4, its output pins and the step DMA, outputs off
+ * void siren_start(const SirenPhase *phases, int count) - Plays the phases in order, the last one until stopped
+ * void siren_stop(void) - Stops the siren and drives both outputs low
+ * int siren_phase(void) - Index of the phase playing (-1 -> stopped)
+ *
+ * Assignment: Project 3
+ * Inputs:
+ * Outputs:
+ *      Active buzzer - PD_14 (TIM4_CH3)
+ *      Alarm LEDs - PD_15 (TIM4_CH4)
+ * Constraints:
+ *      TIM4 and DMA1 channel 2 are reserved for the siren
+ *      Step times are in ms, at most SIREN_PERIOD_MAX_MS, and a phase has at most SIREN_STEPS_MAX steps
+ *      An on time equal to the period holds the output on for the whole step
+ *      Only phase changes use the CPU (one Timeout interrupt per phase)
+ * References:
+ *      STM32L4+ Reference Manual, TIM2/3/4/5 DMA burst mode - https://www.st.com/resource/en/reference_manual/rm0432-stm32l4-series-advanced-armbased-32bit-mcus-stmicroelectronics.pdf
+ */
+#ifndef CSE321_PROJECT3_MABAUTIS_SIREN_H
+#define CSE321_PROJECT3_MABAUTIS_SIREN_H
+
+#include <stdint.h>
+
+#define SIREN_STEPS_MAX 16       // Steps in one phase
+#define SIREN_PERIOD_MAX_MS 6500 // Longest step (16 bit timer at 10kHz)
+#define SIREN_FOREVER 0          // Phase duration for a phase that plays until stopped
+
+// One step of a pattern. A pulse is one step with equal on and off time, a strobe is one step
+// with a short on time, and a sweep is several steps whose period shrinks or grows
+struct SirenStep {
+  uint16_t period_ms; // Length of the step
+  uint16_t buzzer_ms; // Buzzer on time at the start of the step
+  uint16_t strobe_ms; // Alarm LED on time at the start of the step
+};
+
+struct SirenPhase {
+  const SirenStep *steps; // Steps repeated for the whole phase
+  uint8_t step_count;     // Steps in the table
+  uint32_t duration_ms;   // Time before the next phase (SIREN_FOREVER -> until stopped)
+};
+
+void siren_init(void); // Sets up TIM4, its output pins and the step DMA, outputs off
+void siren_start(const SirenPhase *phases, int count); // Plays the phases in order, the last one until stopped
+void siren_stop(void); // Stops the siren and drives both outputs low
+int siren_phase(void); // Index of the phase playing (-1 -> stopped)
+
+#endif
@@ -0,0 +1,178 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: Binary telemetry stream. Fixed layout records go into a RAM ring and a low priority
+ *               thread sends them COBS framed on a spare UART with DMA
+ *
+ * Modules:
+ *      CSE321_project3_mabautis_memory - Sender thread stack size
+ *      CSE321_project3_mabautis_profile - CPU time of the sender
+ *
+ * Subroutines:
+ * void telemetry_start(void) - Sets up USART3 TX and its DMA channel and starts the sender thread
+ * void telemetry_log(int type, int channel, uint32_t value) - Adds a record to the RAM ring (ISR safe, no UART access)
+ * uint32_t telemetry_dropped(void) - Records lost because the RAM ring was full
+ * void telemetry_sender(void) - Sender thread, encodes records into one buffer while the DMA sends the other
+ * uint32_t encode_frames(uint8_t *out) - Moves records from the ring into a transfer buffer as frames
+ * uint32_t encode_frame(const TelemetryRecord *record, uint8_t *out) - COBS encodes one record and adds the delimiter
+ * void tx_dma_irq(void) - DMA1 channel 3 ISR, hands the interrupt to the HAL
+ * void transfer_done(DMA_HandleTypeDef *dma) - HAL transfer complete callback, wakes the sender
+ *
+ * Assignment: Project 3
+ * Inputs:
+ * Outputs:
+ *      USART3 TX - PB_10 (AF7)
+ * Constraints:
+ *      USART3 and DMA1 channel 3 are reserved for telemetry
+ *      telemetry_log is a timestamp, a critical section and four stores. It never signals the sender,
+ *      the sender polls every TELEMETRY_PERIOD_MS instead so logging stays cheap in ISRs
+ *      A full ring keeps the older records, the count of dropped ones is sent as a TELEMETRY_LOST record
+ * References:
+ *      STM32L4+ HAL UART/DMA driver - https://www.st.com/resource/en/user_manual/um1884-description-of-stm32l4l4-hal-and-lowlayer-drivers-stmicroelectronics.pdf
+ *      Consistent Overhead Byte Stuffing - http://www.stuartcheshire.org/papers/COBSforToN.pdf
+ */
+#include "CSE321_project3_mabautis_telemetry.h"
+#include "CSE321_project3_mabautis_memory.h"
+#include "CSE321_project3_mabautis_profile.h"
+#include <mbed.h>
+
+#define FLAG_TX_DONE 1 // Thread flag: the DMA transfer finished
+
+static void telemetry_sender(void); // Sender thread, encodes records into one buffer while the DMA sends the other
+static uint32_t encode_frames(uint8_t *out); // Moves records from the ring into a transfer buffer as frames
+static uint32_t encode_frame(const TelemetryRecord *record, uint8_t *out); // COBS encodes one record and adds the delimiter
+static void tx_dma_irq(void); // DMA1 channel 3 ISR, hands the interrupt to the HAL
+static void transfer_done(DMA_HandleTypeDef *dma); // HAL transfer complete callback, wakes the sender
+
+static TelemetryRecord ring[TELEMETRY_RECORDS]; // Records not yet sent
+static volatile uint32_t ring_head = 0; // Next free entry (free running, masked on use)
+static volatile uint32_t ring_tail = 0; // Oldest entry not yet encoded
+static volatile uint32_t dropped = 0; // Records lost to a full ring
+static uint32_t dropped_sent = 0; // Dropped count already reported in a lost record
+
+static UART_HandleTypeDef tx_uart; // USART3, transmit only
+static DMA_HandleTypeDef tx_dma; // DMA1 channel 3, one transfer per buffer
+alignas(4) static uint8_t tx_buffers[2][TELEMETRY_TX_FRAMES * TELEMETRY_FRAME_BYTES];
+static int sender_slot = -1; // Profiler slot of the sender
+
+static Thread sender_thread(osPriorityLow, TELEMETRY_STACK_SIZE, nullptr, "telemetry"); // Behind the keypad and alarm
+
+void telemetry_start(void) {
+  // PB_10 as USART3 TX
+  __HAL_RCC_GPIOB_CLK_ENABLE();
+  GPIO_InitTypeDef pin = {0};
+  pin.Pin = GPIO_PIN_10;
+  pin.Mode = GPIO_MODE_AF_PP;
+  pin.Pull = GPIO_NOPULL;
+  pin.Speed = GPIO_SPEED_FREQ_HIGH;
+  pin.Alternate = GPIO_AF7_USART3;
+  HAL_GPIO_Init(GPIOB, &pin);
+
+  __HAL_RCC_USART3_CLK_ENABLE();
+  tx_uart.Instance = USART3;
+  tx_uart.Init.BaudRate = TELEMETRY_BAUD;
+  tx_uart.Init.WordLength = UART_WORDLENGTH_8B;
+  tx_uart.Init.StopBits = UART_STOPBITS_1;
+  tx_uart.Init.Parity = UART_PARITY_NONE;
+  tx_uart.Init.Mode = UART_MODE_TX;
+  tx_uart.Init.HwFlowCtl = UART_HWCONTROL_NONE;
+  tx_uart.Init.OverSampling = UART_OVERSAMPLING_16;
+  HAL_UART_Init(&tx_uart);
+  USART3->CR3 |= USART_CR3_DMAT; // Every empty TDR requests a byte from the DMA
+
+  // DMA1 channel 3 routed to the USART3 TX request through the DMAMUX
+  __HAL_RCC_DMAMUX1_CLK_ENABLE();
+  __HAL_RCC_DMA1_CLK_ENABLE();
+  tx_dma.Instance = DMA1_Channel3;
+  tx_dma.Init.Request = DMA_REQUEST_USART3_TX;
+  tx_dma.Init.Direction = DMA_MEMORY_TO_PERIPH;
+  tx_dma.Init.PeriphInc = DMA_PINC_DISABLE;
+  tx_dma.Init.MemInc = DMA_MINC_ENABLE;
+  tx_dma.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+  tx_dma.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+  tx_dma.Init.Mode = DMA_NORMAL;
+  tx_dma.Init.Priority = DMA_PRIORITY_LOW; // The microphone DMA comes first
+  HAL_DMA_Init(&tx_dma);
+  tx_dma.XferCpltCallback = &transfer_done;
+  NVIC_SetVector(DMA1_Channel3_IRQn, (uint32_t)&tx_dma_irq);
+  NVIC_EnableIRQ(DMA1_Channel3_IRQn);
+
+  sender_slot = profile_slot("telemetry", PROFILE_THREAD);
+  sender_thread.start(&telemetry_sender);
+}
+
+void telemetry_log(int type, int channel, uint32_t value) {
+  core_util_critical_section_enter(); // Callers are threads and ISRs
+  uint32_t now = us_ticker_read(); // Read inside, so records go into the ring in time order
+  if (ring_head - ring_tail == TELEMETRY_RECORDS) {
+    dropped++; // Keep the older records, they have not been sent yet
+  } else {
+    TelemetryRecord &record = ring[ring_head & (TELEMETRY_RECORDS - 1)];
+    record.time_us = now;
+    record.type = type;
+    record.channel = channel;
+    record.value = value > 0xFFFF ? 0xFFFF : value;
+    ring_head++;
+  }
+  core_util_critical_section_exit();
+}
+
+uint32_t telemetry_dropped(void) { return dropped; }
+
+static void telemetry_sender(void) {
+  int next = 0; // Buffer the next transfer is encoded into
+  int sending = 0; // A transfer from the other buffer is in flight
+  while (1) {
+    uint32_t start = profile_begin();
+    uint32_t length = encode_frames(tx_buffers[next]);
+    profile_end(sender_slot, start);
+    if (!length) {
+      ThisThread::sleep_for(std::chrono::milliseconds(TELEMETRY_PERIOD_MS));
+      continue;
+    }
+    if (sending) {
+      ThisThread::flags_wait_any(FLAG_TX_DONE); // The buffer just encoded waits for the other one to go out
+    }
+    HAL_DMA_Start_IT(&tx_dma, (uint32_t)tx_buffers[next], (uint32_t)&USART3->TDR, length);
+    sending = 1;
+    next = !next;
+  }
+}
+
+static uint32_t encode_frames(uint8_t *out) {
+  uint32_t length = 0;
+  uint32_t lost = dropped - dropped_sent;
+  if (lost) {
+    TelemetryRecord record = {us_ticker_read(), TELEMETRY_LOST, 0, (uint16_t)(lost > 0xFFFF ? 0xFFFF : lost)};
+    length += encode_frame(&record, out);
+    dropped_sent += lost;
+  }
+  while (ring_tail != ring_head && length + TELEMETRY_FRAME_BYTES <= sizeof(tx_buffers[0])) {
+    TelemetryRecord record = ring[ring_tail & (TELEMETRY_RECORDS - 1)];
+    ring_tail++; // Only the sender moves the tail, the entry is free once copied
+    length += encode_frame(&record, out + length);
+  }
+  return length;
+}
+
+static uint32_t encode_frame(const TelemetryRecord *record, uint8_t *out) {
+  // Each code byte is the distance to the next zero, records are shorter than a 254 byte run
+  const uint8_t *data = (const uint8_t *)record;
+  uint32_t code_at = 0;
+  uint32_t length = 1;
+  for (uint32_t i = 0; i < sizeof(TelemetryRecord); i++) {
+    if (data[i]) {
+      out[length++] = data[i];
+    } else {
+      out[code_at] = length - code_at;
+      code_at = length++;
+    }
+  }
+  out[code_at] = length - code_at;
+  out[length++] = 0; // Frame delimiter, never appears inside a frame
+  return length;
+}
+
+static void tx_dma_irq(void) { HAL_DMA_IRQHandler(&tx_dma); }
+
+static void transfer_done(DMA_HandleTypeDef *dma) { sender_thread.flags_set(FLAG_TX_DONE); }
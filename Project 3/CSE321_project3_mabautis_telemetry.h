@@ -0,0 +1,59 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: Binary telemetry stream. Fixed layout records go into a RAM ring and a low priority
+ *               thread sends them COBS framed on a spare UART with DMA
+ *
+ * Modules:
+ *
+ * Subroutines:
+ * void telemetry_start(void) - Sets up USART3 TX and its DMA channel and starts the sender thread
+ * void telemetry_log(int type, int channel, uint32_t value) - Adds a record to the RAM ring (ISR safe, no UART access)
+ * uint32_t telemetry_dropped(void) - Records lost because the RAM ring was full
+ *
+ * Assignment: Project 3
+ * Inputs:
+ * Outputs:
+ *      USART3 TX - PB_10, TELEMETRY_BAUD 8N1
+ * Constraints:
+ *      Wire format: one frame per record, the COBS encoding of the 8 byte little endian TelemetryRecord
+ *      followed by a 0x00 delimiter (10 bytes). A receiver that starts mid frame syncs at the next 0x00
+ *      Times are us_ticker_read() values, the decoder unwraps them: a step back of more than half the
+ *      range is a wrap, a shorter one is left out of order. Records more than ~35 minutes apart come out wrong
+ *      The header has no mbed dependencies so the host decoder uses the same record layout
+ * References:
+ *      Consistent Overhead Byte Stuffing - http://www.stuartcheshire.org/papers/COBSforToN.pdf
+ */
+#ifndef CSE321_PROJECT3_MABAUTIS_TELEMETRY_H
+#define CSE321_PROJECT3_MABAUTIS_TELEMETRY_H
+
+#include <stdint.h>
+
+#define TELEMETRY_RECORDS 256     // RAM ring size, power of two (2KB, 25ms of records at the full baud rate)
+#define TELEMETRY_BAUD 921600     // USART3 baud rate, about 9200 records per second
+#define TELEMETRY_PERIOD_MS 10    // Sender wake up period while the ring is empty
+#define TELEMETRY_TX_FRAMES 32    // Frames per DMA transfer, two transfer buffers
+#define TELEMETRY_FRAME_BYTES 10  // COBS code byte, record, delimiter
+
+enum TelemetryType {
+  TELEMETRY_LOST = 0,     // Records dropped since the last lost record, sent before the next record
+  TELEMETRY_KEY = 1,      // Valid key press, value is the key ('*' for every digit, the passcode is never sent)
+  TELEMETRY_STATE = 2,    // Alarm state changed, channel is the journal source, value is the new state
+  TELEMETRY_DISTANCE = 3, // Sonar reading in mm, channel is the zone
+  TELEMETRY_MIC = 4,      // Microphone block RMS in ADC counts
+  TELEMETRY_TRIP = 5,     // Armed zone tripped, channel is the zone, value is the sensor kind
+  TELEMETRY_TYPE_COUNT
+};
+
+struct TelemetryRecord {
+  uint32_t time_us; // us_ticker_read() when the record was logged
+  uint8_t type;     // TelemetryType
+  uint8_t channel;  // Zone or source
+  uint16_t value;   // Reading (saturated)
+};
+
+void telemetry_start(void); // Sets up USART3 TX and its DMA channel and starts the sender thread
+void telemetry_log(int type, int channel, uint32_t value); // Adds a record to the RAM ring (ISR safe, no UART access)
+uint32_t telemetry_dropped(void); // Records lost because the RAM ring was full
+
+#endif
@@ -0,0 +1,104 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: Input trace recorder. Keeps timestamped keypad edges, sonar echo widths and
+ *               microphone levels in a RAM ring so a field incident can be replayed on the host
+ *
+ * Modules:
+ *
+ * Subroutines:
+ * void trace_start(void) - Clears the ring and starts recording
+ * void trace_stop(void) - Stops recording, the ring keeps what it has
+ * int trace_recording(void) - 1 while recording
+ * void trace_key(int row, int col, int level) - Records a keypad column edge (ISR safe)
+ * void trace_level(int source, int channel, uint32_t value) - Records a sensor reading if it changed (ISR safe)
+ * int trace_dump(void (*print_record)(uint64_t time_us, const TraceRecord *record)) - Passes every record, oldest first, to print_record
+ * uint32_t trace_lost(void) - Records overwritten since the trace started
+ * void add_record(int source, int channel, uint32_t value) - Writes one record at the head of the ring
+ *
+ * Assignment: Project 3
+ * Inputs:
+ * Outputs:
+ * Constraints:
+ *      Callers are ISRs, each record is written inside a critical section (a few register
+ *      writes, no printing). Recording is paused while the ring is dumped
+ * References:
+ *      MBED Critical section - https://os.mbed.com/docs/mbed-os/v6.15/apis/criticalsectionlock.html
+ */
+#include "CSE321_project3_mabautis_trace.h"
+#include <mbed.h>
+
+static void add_record(int source, int channel, uint32_t value); // Writes one record at the head of the ring
+
+static TraceRecord ring[TRACE_RECORDS];
+static volatile uint32_t head = 0; // Records written since the trace started (free running, masked on use)
+static volatile int recording = 0;
+static int last_key = 0; // Key position of the last press, releases do not know which column fell
+static uint16_t last_level[TRACE_SOURCE_COUNT][TRACE_LEVEL_CHANNELS]; // Last recorded sensor readings
+
+void trace_start(void) {
+  core_util_critical_section_enter();
+  head = 0;
+  memset(last_level, 0, sizeof(last_level));
+  recording = 1;
+  core_util_critical_section_exit();
+}
+
+void trace_stop(void) { recording = 0; }
+
+int trace_recording(void) { return recording; }
+
+uint32_t trace_lost(void) { return head > TRACE_RECORDS ? head - TRACE_RECORDS : 0; }
+
+void trace_key(int row, int col, int level) {
+  if (level && col >= 0) {
+    last_key = row * 4 + col;
+  }
+  add_record(TRACE_KEY, last_key, level);
+}
+
+void trace_level(int source, int channel, uint32_t value) {
+  if (channel < 0 || channel >= TRACE_LEVEL_CHANNELS) {
+    return;
+  }
+  uint16_t level = value > 0xFFFF ? 0xFFFF : value;
+  uint16_t last = last_level[source][channel];
+  uint16_t step = last / 8 > TRACE_LEVEL_MIN_STEP ? last / 8 : TRACE_LEVEL_MIN_STEP;
+  if (level + step > last && level < last + step) {
+    return; // Same reading as far as a replay is concerned
+  }
+  last_level[source][channel] = level;
+  add_record(source, channel, level);
+}
+
+static void add_record(int source, int channel, uint32_t value) {
+  core_util_critical_section_enter(); // Keypad, sonar and microphone ISRs can nest on the target
+  uint32_t now = us_ticker_read(); // Read inside, so records go into the ring in time order
+  if (recording) {
+    TraceRecord &record = ring[head & (TRACE_RECORDS - 1)];
+    record.time_us = now;
+    record.source = source;
+    record.channel = channel;
+    record.value = value;
+    head++;
+  }
+  core_util_critical_section_exit();
+}
+
+int trace_dump(void (*print_record)(uint64_t time_us, const TraceRecord *record)) {
+  int was_recording = recording;
+  recording = 0; // Nothing overwrites the ring while it is printed
+  uint32_t first = head > TRACE_RECORDS ? head - TRACE_RECORDS : 0;
+  uint64_t high = 0; // Wraps of the 32 bit us ticker so far
+  uint32_t previous = 0;
+  for (uint32_t i = first; i != head; i++) {
+    const TraceRecord *record = &ring[i & (TRACE_RECORDS - 1)];
+    if (i != first && record->time_us < previous && previous - record->time_us > 1u << 31) {
+      high += 1ull << 32; // Only a step back of over half the range is a wrap, anything shorter is out of order
+    }
+    previous = record->time_us;
+    print_record(high + record->time_us, record);
+  }
+  recording = was_recording;
+  return head - first;
+}
@@ -0,0 +1,64 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: Input trace recorder. Keeps timestamped keypad edges, sonar echo widths and
+ *               microphone levels in a RAM ring so a field incident can be replayed on the host
+ *
+ * Modules:
+ *
+ * Subroutines:
+ * void trace_start(void) - Clears the ring and starts recording
+ * void trace_stop(void) - Stops recording, the ring keeps what it has
+ * int trace_recording(void) - 1 while recording
+ * void trace_key(int row, int col, int level) - Records a keypad column edge (ISR safe)
+ * void trace_level(int source, int channel, uint32_t value) - Records a sensor reading if it changed (ISR safe)
+ * int trace_dump(void (*print_record)(uint64_t time_us, const TraceRecord *record)) - Passes every record, oldest first, to print_record
+ * uint32_t trace_lost(void) - Records overwritten since the trace started
+ *
+ * Assignment: Project 3
+ * Inputs:
+ * Outputs:
+ * Constraints:
+ *      The ring overwrites its oldest record, so it always holds the last TRACE_RECORDS inputs
+ *      Sensor readings are only recorded when they move by more than 1/8 (and TRACE_LEVEL_MIN_STEP)
+ *      from the last recorded value, a steady sonar or microphone does not flush the keypad edges out
+ *      Times are us_ticker_read() values, unwrapped by trace_dump: a step back of more than half the
+ *      range is a wrap, a shorter one is left out of order. Records more than ~35 minutes apart come out wrong
+ *      Text format printed by the "trace" console command and read by the host replayer:
+ *          <us> key <row> <col> <0|1>
+ *          <us> sonar <zone> <echo width us>
+ *          <us> mic <zone> <block RMS>
+ * References:
+ */
+#ifndef CSE321_PROJECT3_MABAUTIS_TRACE_H
+#define CSE321_PROJECT3_MABAUTIS_TRACE_H
+
+#include <stdint.h>
+
+#define TRACE_RECORDS 1024        // RAM ring size, power of two (8KB)
+#define TRACE_LEVEL_CHANNELS 4    // Sensor channels (zones) tracked per source
+#define TRACE_LEVEL_MIN_STEP 16   // Smallest change in a sensor reading that is recorded
+
+enum TraceSource {
+  TRACE_KEY = 0,   // Keypad column edge, channel is row * 4 + column, value is the level
+  TRACE_SONAR = 1, // Echo pulse width in us, channel is the zone
+  TRACE_MIC = 2,   // Block RMS in ADC counts, channel is the zone
+  TRACE_SOURCE_COUNT
+};
+
+struct TraceRecord {
+  uint32_t time_us; // us_ticker_read() at the input
+  uint8_t source;   // TraceSource
+  uint8_t channel;  // Key position or zone
+  uint16_t value;   // Level, width or RMS (saturated)
+};
+
+void trace_start(void); // Clears the ring and starts recording
+void trace_stop(void); // Stops recording, the ring keeps what it has
+int trace_recording(void); // 1 while recording
+void trace_key(int row, int col, int level); // Records a keypad column edge (ISR safe)
+void trace_level(int source, int channel, uint32_t value); // Records a sensor reading if it changed (ISR safe)
+int trace_dump(void (*print_record)(uint64_t time_us, const TraceRecord *record)); // Passes every record, oldest first, to print_record
+uint32_t trace_lost(void); // Records overwritten since the trace started
+
+#endif
@@ -0,0 +1,145 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: HC-SR04 sensor driver. Pings on the zone scheduler, times the echo pulse and converts it to a distance
+ *
+ * Modules:
+ *      CSE321_project3_mabautis_filter - Median, EMA and M of N filtering of the readings
+ *      CSE321_project3_mabautis_sensors - Zone registry and scheduler the driver plugs into
+ *      CSE321_project3_mabautis_trace - Records echo widths for host replay
+ *      CSE321_project3_mabautis_profile - CPU time of the trigger pulse end
+ *      CSE321_project3_mabautis_telemetry - Sends every distance reading
+ *
+ * Subroutines:
+ * uint32_t distance_mm(int zone) - Median of the recent distances in mm
+ * uint32_t distance_ema_mm(int zone) - Moving average of the recent distances in mm
+ * uint32_t echo_to_mm(uint32_t echo_us) - Converts an echo pulse width to a distance in mm using fixed point
+ * void set_trigger_range_mm(uint32_t range) - Sets the distance under which an object trips a sonar zone
+ * uint32_t trigger_range_mm(void) - Distance under which an object trips a sonar zone
+ * int in_trigger_range(uint32_t distance) - Returns 1 if the distance is a valid reading inside the trigger range
+ * uint32_t ping_period_ms(int zone) - Current time between pings for a zone (0 -> not pinging)
+ * void sonar_start(int zone) - Sets up the trigger pin and filters of a zone
+ * void sonar_edge(int zone, int rising) - Times the echo pulse and confirms readings in the trigger range
+ * int sonar_poll(int zone) - Starts a ping unless another sonar's echo is in flight
+ * void sonar_reset(int zone) - Clears the M of N history
+ * void end_trigger_pulse(void) - Timeout ISR that ends the 10us trigger pulse
+ *
+ * Assignment: Project 3
+ * Inputs:
+ *      HC-SR04 echo pulse of every sonar zone (timed on both edges)
+ * Outputs:
+ *      HC-SR04 trigger pulse (10us, ended by a one-shot Timeout shared by every sonar)
+ * Constraints:
+ *      Pings are at least PING_PERIOD_BURST_MS apart so echoes from the last ping have died out
+ *      Only one sonar pings at a time so sonars do not hear each other's echoes
+ *      Readings under ULTRASONIC_MIN_RANGE_MM are below the sensor's rated range and are treated as noise
+ * References:
+ *      HC-SR04 Datasheet - https://cdn.sparkfun.com/datasheets/Sensors/Proximity/HCSR04.pdf
+ */
+#include "CSE321_project3_mabautis_ultrasonic.h"
+#include "CSE321_project3_mabautis_filter.h"
+#include "CSE321_project3_mabautis_trace.h"
+#include "CSE321_project3_mabautis_profile.h"
+#include "CSE321_project3_mabautis_telemetry.h"
+
+static void sonar_start(int zone); // Sets up the trigger pin and filters of a zone
+static void sonar_edge(int zone, int rising); // Times the echo pulse and confirms readings in the trigger range
+static int sonar_poll(int zone); // Starts a ping unless another sonar's echo is in flight
+static void sonar_reset(int zone); // Clears the M of N history
+static void end_trigger_pulse(void); // Timeout ISR that ends the 10us trigger pulse
+
+const Sensor ultrasonic_sensor = {SENSOR_ULTRASONIC, &sonar_start, &sonar_edge, &ping_period_ms, &sonar_poll, &sonar_reset};
+
+static Timeout pulse_timeout; // One-shot timer that ends the trigger pulse, shared by every sonar
+
+static const uint32_t mode_periods[] = {PING_PERIOD_POWER_ON_MS, PING_PERIOD_UNARMED_MS,
+                                        PING_PERIOD_ARMED_MS, PING_PERIOD_TRIGGERED_MS}; // Indexed by system mode
+
+static volatile uint32_t range = ULTRASONIC_DEFAULT_RANGE_MM; // Trigger distance in mm
+static volatile int active_sonar = -1; // Zone whose ping is in flight (-1 -> none)
+static volatile uint32_t ping_us = 0; // Time the active ping was sent
+static gpio_t *pulse_pin = nullptr; // Trigger pin of the pulse being sent
+static int pulse_slot = -1; // Profiler slot of end_trigger_pulse
+
+uint32_t distance_mm(int zone) { return distance_median(&zone_state(zone)->filter.distance); }
+
+uint32_t distance_ema_mm(int zone) { return distance_ema(&zone_state(zone)->filter.distance); }
+
+void set_trigger_range_mm(uint32_t new_range) { range = new_range; }
+
+uint32_t trigger_range_mm(void) { return range; }
+
+int in_trigger_range(uint32_t distance) {
+  return distance >= ULTRASONIC_MIN_RANGE_MM && distance <= range;
+}
+
+uint32_t ping_period_ms(int zone) {
+  uint32_t period = mode_periods[sensors_mode()];
+  return (period && zone_state(zone)->burst_left) ? PING_PERIOD_BURST_MS : period;
+}
+
+static void sonar_start(int zone) {
+  ZoneState *state = zone_state(zone);
+  if (pulse_slot < 0) {
+    pulse_slot = profile_slot("trigger_end", PROFILE_ISR); // One Timeout for every sonar
+  }
+  gpio_init_out(&state->output, zone_info(zone)->output);
+  state->confirm.m = SONAR_CONFIRM_M;
+  state->confirm.n = SONAR_CONFIRM_N;
+  confirm_reset(&state->confirm);
+  distance_filter_reset(&state->filter.distance);
+}
+
+static void sonar_reset(int zone) { confirm_reset(&zone_state(zone)->confirm); }
+
+static int sonar_poll(int zone) {
+  uint32_t now = us_ticker_read();
+  if (active_sonar >= 0 && now - ping_us < PING_ECHO_MAX_US) {
+    return 0; // Another sonar is waiting for its echo
+  }
+  ZoneState *state = zone_state(zone);
+  active_sonar = zone;
+  ping_us = now;
+  pulse_pin = &state->output;
+  gpio_write(pulse_pin, 1); // Activate pulse, one-shot timer ends it instead of spinning
+  pulse_timeout.attach(&end_trigger_pulse, std::chrono::microseconds(PING_TRIGGER_PULSE_US));
+  if (state->burst_left) {
+    state->burst_left--;
+  }
+  return 1;
+}
+
+static void sonar_edge(int zone, int rising) {
+  ZoneState *state = zone_state(zone);
+  uint32_t now = us_ticker_read();
+  if (rising) {
+    state->edge_us = now; // Start timing the echo pulse
+    return;
+  }
+  if (active_sonar == zone) {
+    active_sonar = -1; // Echo done, the next sonar can ping
+  }
+  uint32_t distance = echo_to_mm(now - state->edge_us);
+  trace_level(TRACE_SONAR, zone, now - state->edge_us);
+  telemetry_log(TELEMETRY_DISTANCE, zone, distance);
+
+  // Closing in on the trigger range while armed -> ping at the burst rate for a while
+  if (sensors_armed() && zone_armed(zone) && distance + PING_APPROACH_MM < state->last_mm &&
+      distance <= 3 * range) {
+    if (!state->burst_left) {
+      zone_poll_in(zone, PING_PERIOD_BURST_MS); // Bring the next ping forward
+    }
+    state->burst_left = PING_BURST_COUNT;
+  }
+  state->last_mm = distance;
+  distance_filter_push(&state->filter.distance, distance);
+  if (confirm_push(&state->confirm, in_trigger_range(distance))) { // Within triggering distance for M of N pings
+    zone_trip(zone);
+  }
+}
+
+static void end_trigger_pulse(void) {
+  uint32_t start = profile_begin();
+  gpio_write(pulse_pin, 0); // Deactivate trigger pulse
+  profile_end(pulse_slot, start);
+}
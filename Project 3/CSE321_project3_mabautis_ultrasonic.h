@@ -0,0 +1,73 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: HC-SR04 sensor driver. Pings on the zone scheduler, times the echo pulse and converts it to a distance
+ *
+ * Modules:
+ *      CSE321_project3_mabautis_filter - Median, EMA and M of N filtering of the readings
+ *      CSE321_project3_mabautis_sensors - Zone registry and scheduler the driver plugs into
+ *
+ * Subroutines:
+ * uint32_t distance_mm(int zone) - Median of the recent distances in mm
+ * uint32_t distance_ema_mm(int zone) - Moving average of the recent distances in mm
+ * uint32_t echo_to_mm(uint32_t echo_us) - Converts an echo pulse width to a distance in mm using fixed point
+ * void set_trigger_range_mm(uint32_t range) - Sets the distance under which an object trips a sonar zone
+ * uint32_t trigger_range_mm(void) - Distance under which an object trips a sonar zone
+ * int in_trigger_range(uint32_t distance) - Returns 1 if the distance is a valid reading inside the trigger range
+ * uint32_t ping_period_ms(int zone) - Current time between pings for a zone (0 -> not pinging)
+ *
+ * Assignment: Project 3
+ * Inputs:
+ *      HC-SR04 echo pulse of every sonar zone (timed on both edges)
+ * Outputs:
+ *      HC-SR04 trigger pulse (10us, ended by a one-shot Timeout shared by every sonar)
+ * Constraints:
+ *      Pings are at least PING_PERIOD_BURST_MS apart so echoes from the last ping have died out
+ *      Only one sonar pings at a time so sonars do not hear each other's echoes
+ *      Readings under ULTRASONIC_MIN_RANGE_MM are below the sensor's rated range and are treated as noise
+ * References:
+ *      HC-SR04 Datasheet - https://cdn.sparkfun.com/datasheets/Sensors/Proximity/HCSR04.pdf
+ */
+#ifndef CSE321_PROJECT3_MABAUTIS_ULTRASONIC_H
+#define CSE321_PROJECT3_MABAUTIS_ULTRASONIC_H
+
+#include <mbed.h>
+#include <stdint.h>
+#include "CSE321_project3_mabautis_sensors.h"
+
+#define ULTRASONIC_DEFAULT_RANGE_MM 150 // Default trigger distance (old fixed 888us timeout was ~15cm)
+#define ULTRASONIC_MIN_RANGE_MM 20      // HC-SR04 can not measure closer than 2cm
+#define ULTRASONIC_MAX_RANGE_MM 4000    // HC-SR04 can not measure farther than 4m
+#define ULTRASONIC_MM_PER_US_Q16 11239  // 0.1715 mm/us (343 m/s there and back) in Q16 fixed point
+
+// Time between pings for each system mode (0 -> off)
+#define PING_PERIOD_POWER_ON_MS 0    // Nothing to protect before the passcode is set
+#define PING_PERIOD_UNARMED_MS 1000  // Readings are only informational
+#define PING_PERIOD_ARMED_MS 250     // Sensor trips the alarm
+#define PING_PERIOD_TRIGGERED_MS 1000 // Alarm already sounding
+#define PING_PERIOD_BURST_MS 60      // Object approaching while armed
+#define PING_BURST_COUNT 10          // Pings at the burst rate after an approach is seen
+#define PING_APPROACH_MM 30          // Distance drop between pings that counts as approaching
+#define PING_TRIGGER_PULSE_US 10     // HC-SR04 trigger pulse width
+#define PING_ECHO_MAX_US 40000       // Longest echo (no object is 38ms), a ping older than this is given up
+
+// Sonar trips need several in range readings out of the last pings
+#define SONAR_CONFIRM_M 3
+#define SONAR_CONFIRM_N 5
+
+extern const Sensor ultrasonic_sensor; // Driver for HC-SR04 zones
+
+uint32_t distance_mm(int zone); // Median of the recent distances in mm
+uint32_t distance_ema_mm(int zone); // Moving average of the recent distances in mm
+
+void set_trigger_range_mm(uint32_t range); // Sets the distance under which an object trips a sonar zone
+uint32_t trigger_range_mm(void); // Distance under which an object trips a sonar zone
+int in_trigger_range(uint32_t distance); // Returns 1 if the distance is a valid reading inside the trigger range
+
+uint32_t ping_period_ms(int zone); // Current time between pings for a zone (0 -> not pinging)
+
+inline uint32_t echo_to_mm(uint32_t echo_us) { // Converts an echo pulse width to a distance in mm using fixed point
+  return (echo_us * ULTRASONIC_MM_PER_US_Q16) >> 16; // 38ms (no object) still fits in 32 bits
+}
+
+#endif
@@ -0,0 +1,167 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: Known-answer vectors for the DSP block statistics and the sensor filters, run by the
+ *               benchmark build on the board and on the host emulator
+ *
+ * Modules:
+ *      CSE321_project3_mabautis_dsp - Block mean, RMS and peak (SIMD on the board, plain C on the host)
+ *      CSE321_project3_mabautis_filter - Median/EMA, edge rate and M of N sensor filters
+ *
+ * Subroutines:
+ * int vectors_run(void) - Runs every vector, prints the failures and a summary, returns the number that failed
+ * void check(const char *name, uint32_t got, uint32_t expected) - Counts one result, prints it if it is wrong
+ * void check_block(const char *name, const uint16_t *samples, const BlockStats *expected) - Checks block_stats
+ *      and block_stats_c of one block against the known answer
+ * void check_dsp(void) - DC, full scale square wave, sine and single spike blocks, then isqrt
+ * void check_filters(void) - Spike through the median and EMA, EMA Q8 rounding, the M of N boundary and an edge
+ *      rate window across the ms counter wrap
+ *
+ * Assignment: Project 3
+ * Inputs:
+ * Outputs:
+ *      USB serial (STDIO), "# vector <name> FAIL ..." for every failure then "# vectors <n> passed <m> failed".
+ *      Lines start with # so the benchmark CSV that follows stays readable by CSV tools
+ * Constraints:
+ *      Only run by the benchmark build (bench option in mbed_app.json). On the board block_stats takes the
+ *      SMLAD/USUB16/SEL path and every block is also checked against block_stats_c, on the host both are C
+ *      Expected answers were worked out by hand (DC, square, filters) or with exact integer math (sine, spike, EMA)
+ * References:
+ */
+#include "CSE321_project3_mabautis_vectors.h"
+#include "CSE321_project3_mabautis_dsp.h"
+#include "CSE321_project3_mabautis_filter.h"
+#include <cstdio>
+
+#define VECTOR_BLOCK 64 // Samples per DSP vector block, even like a mic_adc half buffer
+
+static void check(const char *name, uint32_t got, uint32_t expected); // Counts one result, prints it if it is wrong
+static void check_block(const char *name, const uint16_t *samples, const BlockStats *expected); // Checks both block_stats paths against the known answer
+static void check_dsp(void); // DC, full scale square wave, sine and single spike blocks, then isqrt
+static void check_filters(void); // Spike, EMA rounding, M of N boundary and edge rate window across the ms wrap
+
+// First quarter of 2047 * sin(2 pi i / 64), rounded. The other quarters are mirrored from it
+static const int16_t sine_quarter[VECTOR_BLOCK / 4 + 1] = {0,    201,  399,  594,  783,  965,  1137, 1299, 1447,
+                                                           1582, 1702, 1805, 1891, 1959, 2008, 2037, 2047};
+
+static uint16_t block[VECTOR_BLOCK] __attribute__((aligned(4))); // block_stats reads sample pairs as words
+static int passed = 0;
+static int failed = 0;
+
+int vectors_run(void) {
+  passed = 0;
+  failed = 0;
+  check_dsp();
+  check_filters();
+  printf("# vectors %d passed %d failed\n", passed, failed);
+  return failed;
+}
+
+static void check(const char *name, uint32_t got, uint32_t expected) {
+  if (got == expected) {
+    passed++;
+    return;
+  }
+  failed++;
+  printf("# vector %s FAIL got %lu expected %lu\n", name, (unsigned long)got, (unsigned long)expected);
+}
+
+static void check_block(const char *name, const uint16_t *samples, const BlockStats *expected) {
+  BlockStats simd;
+  BlockStats reference;
+  block_stats(samples, VECTOR_BLOCK, &simd);
+  block_stats_c(samples, VECTOR_BLOCK, &reference);
+  char label[40];
+  snprintf(label, sizeof(label), "%s_mean", name);
+  check(label, simd.mean, expected->mean);
+  snprintf(label, sizeof(label), "%s_rms", name);
+  check(label, simd.rms, expected->rms);
+  snprintf(label, sizeof(label), "%s_peak", name);
+  check(label, simd.peak, expected->peak);
+  snprintf(label, sizeof(label), "%s_c_path", name); // SIMD and C must agree on every field
+  check(label, reference.mean == simd.mean && reference.rms == simd.rms && reference.peak == simd.peak, 1);
+}
+
+static void check_dsp(void) {
+  for (int i = 0; i < VECTOR_BLOCK; i++) {
+    block[i] = 2048; // Microphone bias, silence
+  }
+  BlockStats dc = {2048, 0, 0};
+  check_block("dsp_dc", block, &dc);
+
+  for (int i = 0; i < VECTOR_BLOCK; i++) {
+    block[i] = i % 2 ? 4095 : 0; // 12-bit full scale, low and high halfwords differ in every pair
+  }
+  BlockStats square = {2047, 2047, 2048}; // Mean 2047.5 rounds down, so the high half is 2048 away
+  check_block("dsp_square", block, &square);
+
+  for (int i = 0; i < VECTOR_BLOCK; i++) {
+    int quarter = i / (VECTOR_BLOCK / 4);
+    int step = i % (VECTOR_BLOCK / 4);
+    int offset = quarter % 2 ? sine_quarter[VECTOR_BLOCK / 4 - step] : sine_quarter[step];
+    block[i] = 2048 + (quarter < 2 ? offset : -offset);
+  }
+  BlockStats sine = {2048, 1447, 2047}; // RMS 2047 / sqrt(2)
+  check_block("dsp_sine", block, &sine);
+
+  for (int i = 0; i < VECTOR_BLOCK; i++) {
+    block[i] = 2000;
+  }
+  block[17] = 4095; // One loud sample in a high halfword
+  BlockStats spike = {2032, 259, 2063};
+  check_block("dsp_spike", block, &spike);
+
+  check("isqrt_0", isqrt(0), 0);
+  check("isqrt_3", isqrt(3), 1);
+  check("isqrt_4", isqrt(4), 2);
+  check("isqrt_2048_squared_less_1", isqrt(2048 * 2048 - 1), 2047);
+  check("isqrt_2048_squared", isqrt(2048 * 2048), 2048);
+  check("isqrt_max", isqrt(0xFFFFFFFF), 65535);
+}
+
+static void check_filters(void) {
+  DistanceFilter distance;
+  distance_filter_reset(&distance);
+  check("median_seed", distance_filter_push(&distance, 1000), 1000);
+  distance_filter_push(&distance, 1000);
+  check("median_spike", distance_filter_push(&distance, 120), 1000); // One short echo is outvoted
+  check("ema_spike", distance_ema(&distance), 780); // 1000 + (120 - 1000) / 4
+  distance_filter_push(&distance, 1000);
+  check("median_after_spike", distance_filter_push(&distance, 1000), 1000);
+  check("ema_after_spike", distance_ema(&distance), 876); // Back 1/4 of the way twice, Q8 rounded
+
+  distance_filter_reset(&distance);
+  distance_filter_push(&distance, 100);
+  distance_filter_push(&distance, 101);
+  check("ema_q8_quarter", distance_ema(&distance), 100); // 100.25 rounds down
+  distance_filter_push(&distance, 101);
+  check("ema_q8_under_half", distance_ema(&distance), 100); // 100.4375 rounds down
+  distance_filter_push(&distance, 101);
+  check("ema_q8_over_half", distance_ema(&distance), 101); // 100.578 rounds up
+  distance_filter_reset(&distance);
+  distance_filter_push(&distance, 101);
+  distance_filter_push(&distance, 100);
+  check("ema_q8_falling", distance_ema(&distance), 101); // 100.75 rounds up
+
+  Confirmation confirm = {0, 3, 5}; // 3 of the last 5
+  confirm_reset(&confirm);
+  confirm_push(&confirm, 1);
+  confirm_push(&confirm, 0);
+  confirm_push(&confirm, 1);
+  check("m_of_n_below", confirm_push(&confirm, 0), 0); // 2 hits
+  check("m_of_n_at_m", confirm_push(&confirm, 1), 1); // Exactly 3 hits
+  check("m_of_n_drop", confirm_push(&confirm, 0), 0); // The first hit leaves the window
+  check("m_of_n_back", confirm_push(&confirm, 1), 1);
+
+  EdgeRateFilter edges = {{0}, 0, 0, 3, 100}; // 3 edges inside 100ms
+  edge_rate_reset(&edges);
+  edge_rate_push(&edges, 0);
+  check("edge_rate_filling", edge_rate_push(&edges, 50), 0); // Not enough edges yet
+  check("edge_rate_at_window", edge_rate_push(&edges, 100), 1); // Exactly the window
+  check("edge_rate_past_window", edge_rate_push(&edges, 151), 0); // 50 to 151 is 101ms
+  edge_rate_reset(&edges);
+  edge_rate_push(&edges, 0xFFFFFFC0);
+  edge_rate_push(&edges, 0xFFFFFFF0);
+  check("edge_rate_wrap", edge_rate_push(&edges, 0x10), 1); // 80ms across the ms counter wrap
+  check("edge_rate_wrap_past_window", edge_rate_push(&edges, 0x60), 0); // 0xFFFFFFF0 to 0x60 is 112ms
+}
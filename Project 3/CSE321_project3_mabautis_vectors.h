@@ -0,0 +1,29 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: Known-answer vectors for the DSP block statistics and the sensor filters, run by the
+ *               benchmark build on the board and on the host emulator
+ *
+ * Modules:
+ *      CSE321_project3_mabautis_dsp - Block mean, RMS and peak (SIMD on the board, plain C on the host)
+ *      CSE321_project3_mabautis_filter - Median/EMA, edge rate and M of N sensor filters
+ *
+ * Subroutines:
+ * int vectors_run(void) - Runs every vector, prints the failures and a summary, returns the number that failed
+ *
+ * Assignment: Project 3
+ * Inputs:
+ * Outputs:
+ *      USB serial (STDIO), "# vector <name> FAIL ..." for every failure then "# vectors <n> passed <m> failed".
+ *      Lines start with # so the benchmark CSV that follows stays readable by CSV tools
+ * Constraints:
+ *      Only run by the benchmark build (bench option in mbed_app.json). On the board block_stats takes the
+ *      SMLAD/USUB16/SEL path and every block is also checked against block_stats_c, on the host both are C
+ * References:
+ */
+#ifndef CSE321_PROJECT3_MABAUTIS_VECTORS_H
+#define CSE321_PROJECT3_MABAUTIS_VECTORS_H
+
+int vectors_run(void); // Runs every vector, prints the failures and a summary, returns the number that failed
+
+#endif
@@ -0,0 +1,124 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: Host decoder for the telemetry stream. Splits a UART capture into COBS frames and
+ *               prints every record as a CSV row
+ *
+ * Modules:
+ *      CSE321_project3_mabautis_telemetry - Record layout and types shared with the target
+ *
+ * Subroutines:
+ * int cobs_decode(const uint8_t *frame, int length, uint8_t *out) - Decodes one frame, returns the
+ * decoded length or -1 if the frame is malformed
+ * void print_record(const TelemetryRecord *record) - Prints one record, unwrapping the 32 bit timestamp
+ *
+ * Assignment: Project 3
+ * Inputs:
+ *      Capture file (argument) or stdin, raw bytes from USART3
+ * Outputs:
+ *      "time_us,type,channel,value" then one row per record on stdout. Time is us since the first
+ *      record, type is the name of the TelemetryType
+ *      Bad and lost record counts on stderr
+ * Constraints:
+ *      Build and run on the host from this folder:
+ *          g++ -std=c++17 -O2 -I.. CSE321_project3_mabautis_telemetry_decode.cpp -o telemetry_decode
+ *          ./telemetry_decode capture.bin > telemetry.csv
+ *      Capture from a USB-UART adapter on PB_10, for example:
+ *          stty -F /dev/ttyUSB0 921600 raw && cat /dev/ttyUSB0 > capture.bin
+ *      The capture may start mid frame, bytes before the first delimiter are only used if they
+ *      decode to a whole record
+ *      .mbedignore keeps this folder out of the target build
+ * References:
+ *      Consistent Overhead Byte Stuffing - http://www.stuartcheshire.org/papers/COBSforToN.pdf
+ */
+#include "CSE321_project3_mabautis_telemetry.h"
+#include <cstdio>
+#include <cstring>
+
+static int cobs_decode(const uint8_t *frame, int length, uint8_t *out); // Decodes one frame, -1 if malformed
+static void print_record(const TelemetryRecord *record); // Prints one record, unwrapping the 32 bit timestamp
+
+static const char *const type_names[TELEMETRY_TYPE_COUNT] = {"lost", "key", "state", "distance", "mic", "trip"};
+
+static uint64_t time_high = 0; // Wraps of the 32 bit us ticker so far
+static uint32_t last_time = 0;
+static uint64_t first_time = 0;
+static int records = 0;
+static unsigned long lost = 0;
+
+int main(int argc, char **argv) {
+  FILE *in = stdin;
+  if (argc > 1 && !(in = fopen(argv[1], "rb"))) {
+    fprintf(stderr, "can not open %s\n", argv[1]);
+    return 1;
+  }
+  printf("time_us,type,channel,value\n");
+  uint8_t frame[TELEMETRY_FRAME_BYTES];
+  int length = 0;
+  int first = 1; // No delimiter seen yet, the frame may be the tail of one sent before the capture
+  int overlong = 0; // Frame is longer than any record frame, dropped at its delimiter
+  int bad = 0;
+  int c;
+  while ((c = fgetc(in)) != EOF) {
+    if (c) {
+      if (length < (int)sizeof(frame)) {
+        frame[length++] = c;
+      } else {
+        overlong = 1;
+      }
+      continue;
+    }
+    if (length) { // Empty frames are back to back delimiters, not errors
+      TelemetryRecord record;
+      if (!overlong && cobs_decode(frame, length, (uint8_t *)&record) == (int)sizeof(record) &&
+          record.type < TELEMETRY_TYPE_COUNT) {
+        print_record(&record);
+      } else if (!first) {
+        bad++;
+      }
+    }
+    first = 0;
+    length = 0;
+    overlong = 0;
+  }
+  fprintf(stderr, "%d records, %d bad frames, %lu records lost on the target\n", records, bad, lost);
+  return 0;
+}
+
+static int cobs_decode(const uint8_t *frame, int length, uint8_t *out) {
+  int count = 0;
+  int i = 0;
+  while (i < length) {
+    int code = frame[i++];
+    if (i + code - 1 > length || count + code - 1 > (int)sizeof(TelemetryRecord)) {
+      return -1; // Code points past the frame or the record
+    }
+    for (int j = 1; j < code; j++) {
+      out[count++] = frame[i++];
+    }
+    if (code < 0xFF && i < length) {
+      if (count == (int)sizeof(TelemetryRecord)) {
+        return -1;
+      }
+      out[count++] = 0; // Every code but the last stands for a zero
+    }
+  }
+  return count;
+}
+
+static void print_record(const TelemetryRecord *record) {
+  if (records && record->time_us < last_time && last_time - record->time_us > 1u << 31) {
+    time_high += 1ull << 32; // Only a step back of over half the range is a wrap, anything shorter is out of order
+  }
+  last_time = record->time_us;
+  uint64_t time_us = time_high + record->time_us;
+  if (!records) {
+    first_time = time_us;
+  }
+  records++;
+  if (record->type == TELEMETRY_LOST) {
+    lost += record->value;
+  }
+  printf("%llu,%s,%u,%u\n", (unsigned long long)(time_us - first_time), type_names[record->type],
+         record->channel, record->value);
+}
@@ -0,0 +1,79 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: Host emulator of the Nucleo-L4R5ZI and the project hardware. Runs the firmware on a
+ *               virtual clock with emulated threads, timers, interrupts and board models
+ *
+ * Modules:
+ *      mbed/mbed.h - The mbed OS stand-in the firmware is built against
+ *
+ * Subroutines:
+ * void emu_boot(int (*firmware_main)(void)) - Creates the main thread for the firmware's main, it starts on the first run
+ * void emu_run_for(std::chrono::microseconds t) - Runs the firmware until the virtual clock has moved t
+ * void emu_at(std::chrono::microseconds t, std::function<void()> event) - Runs event as hardware t from now
+ * uint64_t emu_now_us(void) - Virtual time since boot
+ * const char *emu_halted(void) - Why the firmware stopped (watchdog reset), nullptr while it runs
+ * void emu_keypad_attach(const PinName rows[4], const PinName cols[4], const char keys[4][4]) - Wires the keypad model
+ * void emu_key_down(char key), void emu_key_up(void) - Presses and releases a key
+ * void emu_button(int pressed) - Presses (1) or releases (0) the user button
+ * const char *emu_lcd_line(int row) - Text on one line of the LCD model
+ * int emu_lcd_backlight(void) - Backlight state of the LCD model
+ * void emu_lcd_watch(void (*changed)(void)) - Calls changed after every LCD update
+ * void emu_sonar_attach(PinName trigger, PinName echo) - Wires the HC-SR04 model
+ * void emu_sonar_set_mm(uint32_t mm) - Object distance seen by the sonar (0 -> nothing in range)
+ * void emu_mic_set_level(uint32_t amplitude) - Noise amplitude in ADC counts heard by the microphone
+ * void emu_serial_input(const char *text) - Queues text on the UART receive side
+ * void emu_uart_capture(FILE *out) - Writes every byte sent on USART3 to out (nullptr -> dropped)
+ * int emu_pin_read(PinName pin) - Level of any pin
+ * void emu_pin_watch(PinName pin, void (*changed)(PinName pin, int level)) - Calls changed on every edge of a pin
+ * void emu_report(FILE *out) - Prints CPU time per thread, ISR and idle time
+ *
+ * Assignment: Host emulator
+ * Inputs:
+ * Outputs:
+ * Constraints:
+ *      One host thread runs everything. Emulated threads are coroutines (ucontext) switched by an
+ *      RTX-like scheduler: highest priority ready thread runs, 5ms round robin between equals,
+ *      mutexes hand over to the highest waiter with priority inheritance
+ *      The clock only moves when code spends CPU time (EMU_COST_* per call, wait_us, I2C and flash
+ *      timing) or when every thread is blocked, then it jumps to the next timer. Runs are
+ *      deterministic: the same script gives the same output and timestamps
+ *      A bare-metal loop that polls an empty EventQueue with dispatch_once jumps to the next timer
+ *      or input instead of spinning, keypad rows then advance once per jump
+ *      ISRs never nest, an edge raised during an ISR or critical section runs when it ends
+ *      Target stack depth is not emulated, the memory report shows reserved sizes only
+ * References:
+ *      RTX5 scheduler - https://arm-software.github.io/CMSIS_5/RTOS2/html/theory_of_operation.html
+ */
+#ifndef CSE321_MABAUTIS_EMULATOR_H
+#define CSE321_MABAUTIS_EMULATOR_H
+
+#include <mbed.h>
+
+#define EMU_SLICE_NS 5000000ull // RTX round robin time slice (5 ticks)
+
+void emu_boot(int (*firmware_main)(void)); // Creates the main thread for the firmware's main, it starts on the first run
+void emu_run_for(std::chrono::microseconds t); // Runs the firmware until the virtual clock has moved t
+void emu_at(std::chrono::microseconds t, std::function<void()> event); // Runs event as hardware t from now
+uint64_t emu_now_us(void); // Virtual time since boot
+const char *emu_halted(void); // Why the firmware stopped (watchdog reset), nullptr while it runs
+void emu_halt(const char *reason); // Stops the firmware, the script gets control back
+
+// Board models
+void emu_keypad_attach(const PinName rows[4], const PinName cols[4], const char keys[4][4]); // Wires the keypad model
+void emu_key_down(char key); // Connects the key's row to its column
+void emu_key_up(void); // Releases the pressed key
+void emu_button(int pressed); // Presses (1) or releases (0) the user button
+const char *emu_lcd_line(int row); // Text on one line of the LCD model (16 characters)
+int emu_lcd_backlight(void); // Backlight state of the LCD model
+void emu_lcd_watch(void (*changed)(void)); // Calls changed after every LCD update
+void emu_sonar_attach(PinName trigger, PinName echo); // Wires the HC-SR04 model
+void emu_sonar_set_mm(uint32_t mm); // Object distance seen by the sonar (0 -> nothing in range)
+void emu_mic_set_level(uint32_t amplitude); // Noise amplitude in ADC counts heard by the microphone
+void emu_serial_input(const char *text); // Queues text on the UART receive side
+void emu_uart_capture(FILE *out); // Writes every byte sent on USART3 to out (nullptr -> dropped)
+int emu_pin_read(PinName pin); // Level of any pin
+void emu_pin_watch(PinName pin, void (*changed)(PinName pin, int level)); // Calls changed on every edge of a pin
+void emu_report(FILE *out); // Prints CPU time per thread, ISR and idle time
+
+#endif
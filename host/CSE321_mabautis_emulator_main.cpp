@@ -0,0 +1,456 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: Script runner for the host emulator. Boots the firmware, wires the keypad and sonar
+ *               models, then plays a script of inputs and checks against virtual time
+ *
+ * Modules:
+ *      CSE321_mabautis_emulator - Virtual clock, threads and board models
+ *
+ * Subroutines:
+ * int main(int argc, char **argv) - Boots the firmware and runs the script
+ * int run_line(char *line) - Runs one script command, returns 0 when it fails
+ * void run(uint64_t us) - Runs the firmware, no faster than the pacing speed
+ * int parse_time(const char *text, uint64_t *us) - Reads a time like 250ms, 10s or 9min
+ * int parse_pin(const char *text, PinName *pin) - Reads a pin name like PD_15
+ * void print_lcd(void) - Prints the LCD model with the virtual time
+ * int replay(const char *path) - Schedules the inputs of a device trace, returns 0 if it can not be read
+ * void lcd_changed(void), void lcd_settled(void) - Add settled LCD contents to the output trace
+ * void pin_changed(PinName pin, int level) - Adds a watched pin edge to the output trace
+ * int check_golden(void) - Compares the output trace with the golden file, or writes it if there is none
+ * ssize_t capture_stdout(void *cookie, const char *buffer, size_t length) - Writes firmware output to fd 1 and keeps it for expect output
+ *
+ * Assignment: Host emulator
+ * Inputs:
+ *      Script file (argument) or stdin, one command per line, # starts a comment:
+ *          run <time>                   Runs the firmware for <time> (us, ms, s, min, default ms)
+ *          key <keys> [hold] [gap]      Presses each key for hold then waits gap (default 100ms each)
+ *          button [hold] [gap]          Presses the user button for hold then waits gap (default 100ms each)
+ *          sonar <mm>                   Object distance (0 -> nothing in range)
+ *          mic <amplitude>              Microphone noise amplitude in ADC counts
+ *          serial <text>                Sends text and a newline to the console
+ *          uart <file>                  Writes every byte the firmware sends on USART3 to file
+ *          lcd                          Prints the LCD
+ *          lcd watch                    Prints the LCD after every change
+ *          expect lcd <row> <text>      Fails unless LCD row 0 or 1 starts with text
+ *          expect backlight <0|1>       Fails unless the backlight is in that state
+ *          expect pin <pin> <0|1>       Fails unless the pin (like PD_15) is at that level
+ *          expect output <text>         Fails unless the firmware printed text since the last expect output
+ *          report                       Prints CPU time per thread
+ *          speed <factor>               Paces later runs to factor x real time (0 -> as fast as possible)
+ *          replay <trace>               Injects the inputs of a device trace at their times, runs to the last one
+ *          watch <pin>                  Adds the pin's edges to the output trace
+ *          golden <file> [tolerance]    Checks the output trace against file at the end of the script,
+ *                                       timestamps may differ by tolerance. Writes file if it does not exist
+ * Outputs:
+ *      Firmware printf on stdout, script results and the virtual/host time ratio on stderr
+ *      USART3 capture file (uart command), Project 3 telemetry frames
+ *      Exit code 0 when every expect passed, 1 when one failed, 2 when the firmware halted
+ * Constraints:
+ *      Keypad rows [PA_3, PC_0, PC_3, PC_1] and columns [PF_14, PE_11, PE_9, PF_13] like both projects
+ *      Sonar trigger PD_6 and echo PD_5 like Project 3
+ *      Replayed echo widths become sonar distances: the firmware pings on its own schedule, so the
+ *      recorded edges can not be injected as they were. Microphone levels become a noise amplitude
+ *      with the same block RMS (uniform noise, RMS = amplitude / sqrt(3))
+ *      Output trace lines are "<us> lcd |<row 0>|<row 1>| <backlight>" once the LCD has been still
+ *      for LCD_SETTLE_US, and "<us> pin <pin> <level>" for every edge of a watched pin
+ * References:
+ */
+#include "CSE321_mabautis_emulator.h"
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#define LCD_SETTLE_US 5000 // An LCD redraw is one output once it has been still this long
+#define PACE_SLICE_US 10000 // Virtual time run between pacing checks
+#define ECHO_NO_OBJECT_US 30000 // Replayed echo at least this wide -> nothing in range
+#define OUTPUT_KEEP_BYTES 65536 // Firmware output kept for expect output, older text is dropped
+
+extern int firmware_main(void); // The firmware's main, renamed at compile time
+
+static const PinName keypad_rows[4] = {PA_3, PC_0, PC_3, PC_1};
+static const PinName keypad_cols[4] = {PF_14, PE_11, PE_9, PF_13};
+static const char keypad_keys[4][4] = {{'1', '2', '3', 'A'}, {'4', '5', '6', 'B'}, {'7', '8', '9', 'C'}, {'*', '0', '#', 'D'}};
+
+static int run_line(char *line); // Runs one script command, returns 0 when it fails
+static void run(uint64_t us); // Runs the firmware, no faster than the pacing speed
+static int parse_time(const char *text, uint64_t *us); // Reads a time like 250ms, 10s or 9min
+static int parse_pin(const char *text, PinName *pin); // Reads a pin name like PD_15
+static void print_lcd(void); // Prints the LCD model with the virtual time
+static int replay(const char *path); // Schedules the inputs of a device trace, returns 0 if it can not be read
+static void lcd_changed(void); // Starts the settle check of an LCD change
+static void lcd_settled(void); // Adds the LCD contents to the output trace once they stop changing
+static void pin_changed(PinName pin, int level); // Adds a watched pin edge to the output trace
+static int check_golden(void); // Compares the output trace with the golden file, or writes it if there is none
+static ssize_t capture_stdout(void *cookie, const char *buffer, size_t length); // Writes firmware output to fd 1 and keeps it for expect output
+
+static int failures = 0;
+static int line_number = 0;
+static double speed = 0; // Pacing factor (0 -> unpaced)
+static std::chrono::steady_clock::time_point host_start;
+static uint64_t virtual_start_us = 0; // Virtual time when pacing started
+static int lcd_watching = 0; // Print every LCD change
+static std::vector<std::string> outputs; // Output trace
+static std::string last_lcd; // Last LCD state in the output trace
+static uint64_t lcd_change_us = 0; // Time of the newest LCD change not yet in the output trace
+static int lcd_settling = 0; // Settle check scheduled
+static std::string golden_path; // Golden file ("" -> no check)
+static uint64_t golden_tolerance_us = 0;
+static std::string firmware_output; // Firmware output since the last expect output
+
+int main(int argc, char **argv) {
+  FILE *script = stdin;
+  if (argc > 1 && !(script = fopen(argv[1], "r"))) {
+    fprintf(stderr, "can not open %s\n", argv[1]);
+    return 1;
+  }
+  cookie_io_functions_t capture = {nullptr, &capture_stdout, nullptr, nullptr};
+  stdout = fopencookie(nullptr, "w", capture); // Firmware printf and serial writes go through stdout
+  setvbuf(stdout, nullptr, _IOLBF, 0);
+  emu_keypad_attach(keypad_rows, keypad_cols, keypad_keys);
+  emu_sonar_attach(PD_6, PD_5);
+  emu_boot(&firmware_main);
+  emu_lcd_watch(&lcd_changed);
+  last_lcd = std::string("|") + emu_lcd_line(0) + "|" + emu_lcd_line(1) + "| off"; // Blank, not an output
+
+  host_start = std::chrono::steady_clock::now();
+  char line[256];
+  while (fgets(line, sizeof(line), script) && !emu_halted()) {
+    line_number++;
+    if (!run_line(line)) {
+      failures++;
+    }
+  }
+  if (!golden_path.empty() && !emu_halted()) {
+    run(LCD_SETTLE_US); // Let the last LCD change settle into the trace
+    if (!check_golden()) {
+      failures++;
+    }
+  }
+  double host_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - host_start).count();
+  double virtual_s = emu_now_us() / 1e6;
+  fprintf(stderr, "[emu] %.3f s virtual in %.3f s host (%.0fx)\n", virtual_s, host_s, host_s > 0 ? virtual_s / host_s : 0);
+  fflush(stdout);
+  fflush(stderr);
+  // Emulated threads are parked mid-function, skip global destructors that would run under them
+  _exit(emu_halted() ? 2 : failures ? 1 : 0);
+}
+
+static int run_line(char *line) {
+  char *comment = strchr(line, '#');
+  if (comment) {
+    *comment = '\0';
+  }
+  char command[16] = "", arg1[128] = "", arg2[32] = "", arg3[32] = "";
+  int count = sscanf(line, "%15s %127s %31s %31s", command, arg1, arg2, arg3);
+  if (count <= 0) {
+    return 1; // Blank line
+  }
+  uint64_t us = 0;
+  if (!strcmp(command, "run") && count == 2 && parse_time(arg1, &us)) {
+    run(us);
+    return 1;
+  }
+  if (!strcmp(command, "key") && count >= 2) {
+    uint64_t hold_us = 100000, gap_us = 100000;
+    if ((count >= 3 && !parse_time(arg2, &hold_us)) || (count >= 4 && !parse_time(arg3, &gap_us))) {
+      fprintf(stderr, "line %d: bad time\n", line_number);
+      return 0;
+    }
+    for (const char *key = arg1; *key && !emu_halted(); key++) {
+      emu_key_down(*key);
+      run(hold_us);
+      emu_key_up();
+      run(gap_us);
+    }
+    return 1;
+  }
+  if (!strcmp(command, "button")) {
+    uint64_t hold_us = 100000, gap_us = 100000;
+    if ((count >= 2 && !parse_time(arg1, &hold_us)) || (count >= 3 && !parse_time(arg2, &gap_us))) {
+      fprintf(stderr, "line %d: bad time\n", line_number);
+      return 0;
+    }
+    emu_button(1);
+    run(hold_us);
+    emu_button(0);
+    run(gap_us);
+    return 1;
+  }
+  if (!strcmp(command, "sonar") && count == 2) {
+    emu_sonar_set_mm(strtoul(arg1, nullptr, 10));
+    return 1;
+  }
+  if (!strcmp(command, "mic") && count == 2) {
+    emu_mic_set_level(strtoul(arg1, nullptr, 10));
+    return 1;
+  }
+  if (!strcmp(command, "serial") && count >= 2) {
+    char *text = strstr(line, arg1); // Whole rest of the line, spaces included
+    size_t length = strcspn(text, "\r\n");
+    while (length && text[length - 1] == ' ') {
+      length--; // Spaces before a comment
+    }
+    text[length] = '\0';
+    emu_serial_input(text);
+    emu_serial_input("\n");
+    return 1;
+  }
+  if (!strcmp(command, "uart") && count == 2) {
+    FILE *capture = fopen(arg1, "wb");
+    if (!capture) {
+      fprintf(stderr, "line %d: can not open %s\n", line_number, arg1);
+      return 0;
+    }
+    emu_uart_capture(capture); // Left open, flushed after every transfer
+    return 1;
+  }
+  if (!strcmp(command, "lcd")) {
+    if (count == 2 && !strcmp(arg1, "watch")) {
+      lcd_watching = 1;
+    }
+    print_lcd();
+    return 1;
+  }
+  if (!strcmp(command, "speed") && count == 2) {
+    speed = atof(arg1);
+    host_start = std::chrono::steady_clock::now();
+    virtual_start_us = emu_now_us();
+    return 1;
+  }
+  if (!strcmp(command, "replay") && count == 2) {
+    return replay(arg1);
+  }
+  PinName pin;
+  if (!strcmp(command, "watch") && count == 2 && parse_pin(arg1, &pin)) {
+    emu_pin_watch(pin, &pin_changed);
+    return 1;
+  }
+  if (!strcmp(command, "golden") && count >= 2) {
+    golden_path = arg1;
+    if (count >= 3 && !parse_time(arg2, &golden_tolerance_us)) {
+      fprintf(stderr, "line %d: bad time\n", line_number);
+      return 0;
+    }
+    return 1;
+  }
+  if (!strcmp(command, "report")) {
+    emu_report(stderr);
+    return 1;
+  }
+  if (!strcmp(command, "expect") && count >= 3) {
+    int ok;
+    if (!strcmp(arg1, "lcd")) {
+      const char *text = strstr(line, arg2) + strlen(arg2); // Text after the row, may hold spaces
+      text += strspn(text, " \t");
+      std::string wanted(text, strcspn(text, "\r\n"));
+      ok = !strncmp(emu_lcd_line(atoi(arg2)), wanted.c_str(), wanted.size());
+    } else if (!strcmp(arg1, "backlight")) {
+      ok = emu_lcd_backlight() == atoi(arg2);
+    } else if (!strcmp(arg1, "pin") && count == 4 && parse_pin(arg2, &pin)) {
+      ok = emu_pin_read(pin) == atoi(arg3);
+    } else if (!strcmp(arg1, "output")) {
+      const char *text = strstr(line, arg1) + strlen(arg1); // Text may hold spaces
+      text += strspn(text, " \t");
+      std::string wanted(text, strcspn(text, "\r\n"));
+      fflush(stdout);
+      ok = firmware_output.find(wanted) != std::string::npos;
+      firmware_output.clear();
+    } else {
+      fprintf(stderr, "line %d: bad expect\n", line_number);
+      return 0;
+    }
+    fprintf(stderr, "[%8.3f s] line %d: %s %s", emu_now_us() / 1e6, line_number, ok ? "pass" : "FAIL", line + strspn(line, " \t"));
+    if (!ok) {
+      print_lcd();
+    }
+    return ok;
+  }
+  fprintf(stderr, "line %d: unknown command %s", line_number, line);
+  return 0;
+}
+
+static void run(uint64_t us) {
+  if (speed <= 0) {
+    emu_run_for(std::chrono::microseconds(us));
+    return;
+  }
+  uint64_t end = emu_now_us() + us;
+  while (emu_now_us() < end && !emu_halted()) {
+    emu_run_for(std::chrono::microseconds(std::min<uint64_t>(PACE_SLICE_US, end - emu_now_us())));
+    std::chrono::duration<double> due((emu_now_us() - virtual_start_us) / 1e6 / speed); // Host time this virtual time is due at
+    std::this_thread::sleep_until(host_start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(due));
+  }
+}
+
+static int parse_time(const char *text, uint64_t *us) {
+  char *unit;
+  double value = strtod(text, &unit);
+  if (unit == text || value < 0) {
+    return 0;
+  }
+  if (!strcmp(unit, "us")) {
+    *us = value;
+  } else if (!*unit || !strcmp(unit, "ms")) {
+    *us = value * 1e3;
+  } else if (!strcmp(unit, "s")) {
+    *us = value * 1e6;
+  } else if (!strcmp(unit, "min")) {
+    *us = value * 60e6;
+  } else {
+    return 0;
+  }
+  return 1;
+}
+
+static void print_lcd(void) {
+  fprintf(stderr, "[%8.3f s] lcd |%s| |%s| backlight %s\n", emu_now_us() / 1e6, emu_lcd_line(0), emu_lcd_line(1),
+          emu_lcd_backlight() ? "on" : "off");
+}
+
+static int parse_pin(const char *text, PinName *pin) {
+  if (strlen(text) < 4 || text[0] != 'P' || text[1] < 'A' || text[1] > 'H' || text[2] != '_') {
+    return 0;
+  }
+  *pin = (PinName)((text[1] - 'A') << 4 | atoi(text + 3));
+  return 1;
+}
+
+static int replay(const char *path) {
+  FILE *trace = fopen(path, "r");
+  if (!trace) {
+    fprintf(stderr, "line %d: can not open %s\n", line_number, path);
+    return 0;
+  }
+  uint64_t last_us = emu_now_us();
+  int scheduled = 0, skipped = 0;
+  char line[128];
+  while (fgets(line, sizeof(line), trace)) {
+    unsigned long long time_us;
+    char source[8];
+    int a, b, c;
+    int count = sscanf(line, "%llu %7s %d %d %d", &time_us, source, &a, &b, &c);
+    if (count < 4) {
+      continue; // Comments and console noise around the dump
+    }
+    if (time_us < emu_now_us()) {
+      skipped++; // Already past, the trace started before this point of the script
+      continue;
+    }
+    std::function<void()> input;
+    if (!strcmp(source, "key") && count == 5 && a >= 0 && a < 4 && b >= 0 && b < 4) {
+      char key = keypad_keys[a][b];
+      input = c ? std::function<void()>([key]() { emu_key_down(key); }) : std::function<void()>(&emu_key_up);
+    } else if (!strcmp(source, "sonar")) {
+      uint32_t mm = b >= ECHO_NO_OBJECT_US ? 0 : (uint32_t)b * 343 / 2000; // Round trip at 343 m/s
+      input = [mm]() { emu_sonar_set_mm(mm); };
+    } else if (!strcmp(source, "mic")) {
+      uint32_t amplitude = (uint32_t)b * 1732 / 1000; // sqrt(3) * RMS
+      input = [amplitude]() { emu_mic_set_level(amplitude); };
+    } else {
+      continue;
+    }
+    emu_at(std::chrono::microseconds(time_us - emu_now_us()), input);
+    last_us = std::max<uint64_t>(last_us, time_us);
+    scheduled++;
+  }
+  fclose(trace);
+  fprintf(stderr, "[%8.3f s] line %d: replaying %d inputs from %s", emu_now_us() / 1e6, line_number, scheduled, path);
+  fprintf(stderr, skipped ? " (%d before now skipped)\n" : "\n", skipped);
+  run(last_us - emu_now_us());
+  return 1;
+}
+
+static void lcd_settled(void) {
+  lcd_settling = 0;
+  std::string lcd = std::string("|") + emu_lcd_line(0) + "|" + emu_lcd_line(1) + "| " + (emu_lcd_backlight() ? "on" : "off");
+  if (emu_now_us() - lcd_change_us < LCD_SETTLE_US) { // Changed again since, check once it is still
+    lcd_settling = 1;
+    emu_at(std::chrono::microseconds(LCD_SETTLE_US - (emu_now_us() - lcd_change_us)), &lcd_settled);
+  } else if (lcd != last_lcd) {
+    last_lcd = lcd;
+    outputs.push_back(std::to_string(lcd_change_us) + " lcd " + lcd);
+  }
+}
+
+static void lcd_changed(void) {
+  lcd_change_us = emu_now_us();
+  if (!lcd_settling) {
+    lcd_settling = 1;
+    emu_at(std::chrono::microseconds(LCD_SETTLE_US), &lcd_settled);
+  }
+  if (lcd_watching) {
+    print_lcd();
+  }
+}
+
+static void pin_changed(PinName pin, int level) {
+  char line[48];
+  snprintf(line, sizeof(line), "%llu pin P%c_%d %d", (unsigned long long)emu_now_us(), 'A' + (pin >> 4), pin & 0xF, level);
+  outputs.push_back(line);
+}
+
+static int check_golden(void) {
+  FILE *golden = fopen(golden_path.c_str(), "r");
+  if (!golden) {
+    golden = fopen(golden_path.c_str(), "w");
+    if (!golden) {
+      fprintf(stderr, "can not write %s\n", golden_path.c_str());
+      return 0;
+    }
+    for (const std::string &output : outputs) {
+      fprintf(golden, "%s\n", output.c_str());
+    }
+    fclose(golden);
+    fprintf(stderr, "[%8.3f s] golden %s written (%zu outputs)\n", emu_now_us() / 1e6, golden_path.c_str(), outputs.size());
+    return 1;
+  }
+  char line[128];
+  size_t index = 0;
+  int ok = 1;
+  while (ok && fgets(line, sizeof(line), golden)) {
+    line[strcspn(line, "\r\n")] = '\0';
+    char *text;
+    unsigned long long wanted_us = strtoull(line, &text, 10);
+    if (index >= outputs.size()) {
+      fprintf(stderr, "golden %s:%zu: missing output: %s\n", golden_path.c_str(), index + 1, line);
+      ok = 0;
+      break;
+    }
+    const char *got = outputs[index].c_str();
+    char *got_text;
+    unsigned long long got_us = strtoull(got, &got_text, 10);
+    uint64_t difference = got_us > wanted_us ? got_us - wanted_us : wanted_us - got_us;
+    if (strcmp(text, got_text) || difference > golden_tolerance_us) {
+      fprintf(stderr, "golden %s:%zu: expected %s\n%*sgot      %s\n", golden_path.c_str(), index + 1, line,
+              (int)(golden_path.size() + 10 + std::to_string(index + 1).size()), "", got);
+      ok = 0;
+    }
+    index++;
+  }
+  if (ok && index < outputs.size()) {
+    fprintf(stderr, "golden %s: unexpected output: %s\n", golden_path.c_str(), outputs[index].c_str());
+    ok = 0;
+  }
+  fclose(golden);
+  fprintf(stderr, "[%8.3f s] golden %s: %s (%zu outputs)\n", emu_now_us() / 1e6, golden_path.c_str(), ok ? "pass" : "FAIL",
+          outputs.size());
+  return ok;
+}
+
+static ssize_t capture_stdout(void *cookie, const char *buffer, size_t length) {
+  firmware_output.append(buffer, length);
+  if (firmware_output.size() > OUTPUT_KEEP_BYTES) {
+    firmware_output.erase(0, firmware_output.size() - OUTPUT_KEEP_BYTES);
+  }
+  size_t written = 0;
+  while (written < length) {
+    ssize_t count = write(STDOUT_FILENO, buffer + written, length - written);
+    if (count <= 0) {
+      break; // Output closed, expect output still sees the text
+    }
+    written += count;
+  }
+  return length;
+}
@@ -0,0 +1,2 @@
+// mbed OS header name used by the firmware, everything is in the stand-in mbed.h
+#include "mbed.h"
@@ -0,0 +1,848 @@
+/*
+ * Author: Miguel Bautista (50298507)
+ *
+ * File Purpose: Host stand-in for the mbed OS 6 APIs, CMSIS registers and STM32 HAL calls used by
+ *               Projects 1, 2 and 3, so their sources build unchanged on Linux and run on the
+ *               emulator's virtual clock
+ *
+ * Modules:
+ *      CSE321_mabautis_emulator - Implements every class and function declared here
+ *
+ * Subroutines:
+ *      DigitalOut, InterruptIn, Ticker, Timeout, Timer, EventQueue, Thread, ThisThread, Mutex,
+ *      Kernel::Clock, Watchdog, I2C, FlashIAP - Same interfaces as mbed OS 6
+ *      wait_us, wait_ns, thread_sleep_for, us_ticker_read, time, set_time, getchar,
+ *      core_util_atomic_* - Same as mbed OS 6
+ *      gpio_*, gpio_irq_* - Same as the mbed GPIO HAL
+ *      HAL_*, NVIC_* - The STM32L4 HAL and CMSIS calls the drivers make
+ *
+ * Assignment: Host emulator
+ * Inputs:
+ * Outputs:
+ * Constraints:
+ *      Only the parts of each API the projects use. Anything else fails to build, which is the
+ *      signal to add it here
+ *      GPIO and DMA flag registers are objects so writes reach the emulator's models. RCC, PWR, RTC,
+ *      TIM, ADC and USART registers are plain memory
+ *      DWT->CYCCNT counts virtual time, so cycle counts on the host come from the EMU_COST_* estimates
+ *      Every call costs virtual CPU time (EMU_COST_*), which is how busy loops move the clock
+ * References:
+ *      MBED OS 6 API - https://os.mbed.com/docs/mbed-os/v6.15/apis/index.html
+ *      STM32L4R5 reference manual (RM0432) - register layouts
+ */
+#ifndef CSE321_HOST_MBED_H
+#define CSE321_HOST_MBED_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <string>
+#include <sys/types.h>
+#include <type_traits>
+#include <utility>
+
+// Virtual CPU time of each emulated operation in ns, roughly a 120MHz Cortex-M4 running mbed OS
+#define EMU_COST_REGISTER 20    // Peripheral register read or write
+#define EMU_COST_CALL 200       // Driver call (InterruptIn::read, DigitalOut::write, ticker attach)
+#define EMU_COST_KERNEL 600     // RTOS call that does not switch (mutex, flags, queue post)
+#define EMU_COST_SWITCH 1500    // Context switch
+#define EMU_COST_ISR 800        // Interrupt entry, mbed dispatch and exit
+#define EMU_COST_EVENT 1000     // EventQueue dispatch of one event
+
+// Virtual clock and timers, shared by every stand-in below
+
+void emu_spend(uint64_t ns); // Moves the clock forward as if the running code used the CPU for ns
+uint64_t emu_now_ns(void); // Virtual time since boot
+
+struct EmuTimer { // Hardware timer channel, handler runs as an ISR
+  std::function<void()> handler;
+  uint64_t due_ns = 0;    // Next expiry
+  uint64_t period_ns = 0; // 0 -> one shot
+  uint64_t order = 0;     // Start order, breaks ties between timers due at the same time
+  bool active = false;
+  bool hardware = false;  // Board model event, not an interrupt (no ISR cost)
+};
+void emu_timer_start(EmuTimer *timer, uint64_t delay_ns, uint64_t period_ns); // (Re)starts a timer
+void emu_timer_stop(EmuTimer *timer); // Stops a timer, safe if it is not running
+
+// Callback
+
+namespace mbed {
+template <typename F> class Callback;
+
+template <typename R, typename... A> class Callback<R(A...)> {
+public:
+  Callback() = default;
+  Callback(std::nullptr_t) {}
+  template <typename F, typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, Callback>::value>::type>
+  Callback(F f) {
+    if (!is_null(f)) {
+      _function = std::move(f);
+    }
+  }
+  template <typename T, typename M> Callback(T *object, M method) : _function([object, method](A... args) { return (object->*method)(args...); }) {}
+  R operator()(A... args) const { return _function(args...); }
+  R call(A... args) const { return _function(args...); }
+  explicit operator bool() const { return (bool)_function; }
+
+private:
+  template <typename F> static bool is_null(const F &f) {
+    if constexpr (std::is_pointer<F>::value) {
+      return f == nullptr;
+    } else {
+      return false;
+    }
+  }
+  std::function<R(A...)> _function;
+};
+
+template <typename R, typename... A> Callback<R(A...)> callback(R (*function)(A...)) { return Callback<R(A...)>(function); }
+template <typename T, typename R, typename... A> Callback<R(A...)> callback(T *object, R (T::*method)(A...)) {
+  return Callback<R(A...)>(object, method);
+}
+} // namespace mbed
+
+using namespace mbed;
+using namespace std;
+using namespace std::chrono_literals;
+
+// Pins
+
+#define EMU_PORTS 8 // GPIOA - GPIOH
+
+enum PinName {
+#define EMU_PORT_PINS(port, index)                                                                          \
+  P##port##_0 = (index) << 4, P##port##_1, P##port##_2, P##port##_3, P##port##_4, P##port##_5, P##port##_6, \
+  P##port##_7, P##port##_8, P##port##_9, P##port##_10, P##port##_11, P##port##_12, P##port##_13,           \
+  P##port##_14, P##port##_15
+  EMU_PORT_PINS(A, 0), EMU_PORT_PINS(B, 1), EMU_PORT_PINS(C, 2), EMU_PORT_PINS(D, 3),
+  EMU_PORT_PINS(E, 4), EMU_PORT_PINS(F, 5), EMU_PORT_PINS(G, 6), EMU_PORT_PINS(H, 7),
+#undef EMU_PORT_PINS
+  // Nucleo-L4R5ZI names
+  LED1 = PC_7,
+  LED2 = PB_7,
+  LED3 = PB_14,
+  BUTTON1 = PC_13,
+  USBTX = PG_7,
+  USBRX = PG_8,
+  NC = (int)0xFFFFFFFF
+};
+
+enum PinMode { PullNone = 0, PullUp = 1, PullDown = 2, OpenDrainPullUp, OpenDrainNoPull, OpenDrainPullDown, PullDefault = PullNone };
+
+// Something that wants to know when a pin changes level (interrupt inputs and the board models)
+class EmuPinListener {
+public:
+  virtual ~EmuPinListener();
+  virtual void pin_changed(int level) = 0; // Runs in hardware context, ISRs must go through emu_interrupt
+  void listen(PinName pin); // Starts listening to pin (NC -> stop)
+  PinName listen_pin = NC;
+};
+void emu_interrupt(std::function<void()> isr); // Runs isr as an interrupt now, or when interrupts are next enabled
+
+// Registers
+
+class EmuRegister { // Peripheral register, writes reach the emulator's port and DMA models
+public:
+  EmuRegister &operator=(uint32_t v) { write(v); return *this; }
+  EmuRegister &operator=(const EmuRegister &other) { write(other.read()); return *this; }
+  EmuRegister &operator|=(uint32_t v) { write(read() | v); return *this; }
+  EmuRegister &operator&=(uint32_t v) { write(read() & v); return *this; }
+  EmuRegister &operator^=(uint32_t v) { write(read() ^ v); return *this; }
+  operator uint32_t() const { return read(); }
+  uint32_t read() const;
+  void write(uint32_t v);
+  uint32_t value = 0;
+};
+
+typedef struct {
+  EmuRegister MODER, OTYPER, OSPEEDR, PUPDR, IDR, ODR, BSRR, LCKR, AFR[2], BRR, ASCR;
+} GPIO_TypeDef;
+
+typedef struct {
+  volatile uint32_t CR, ICSCR, CFGR, PLLCFGR, PLLSAI1CFGR, PLLSAI2CFGR, CIER, CIFR, CICR, RESERVED0;
+  volatile uint32_t AHB1RSTR, AHB2RSTR, AHB3RSTR, RESERVED1, APB1RSTR1, APB1RSTR2, APB2RSTR, RESERVED2;
+  volatile uint32_t AHB1ENR, AHB2ENR, AHB3ENR, RESERVED3, APB1ENR1, APB1ENR2, APB2ENR, RESERVED4;
+  volatile uint32_t AHB1SMENR, AHB2SMENR, AHB3SMENR, RESERVED5, APB1SMENR1, APB1SMENR2, APB2SMENR, RESERVED6;
+  volatile uint32_t CCIPR, RESERVED7, BDCR, CSR, CRRCR, CCIPR2;
+} RCC_TypeDef;
+
+typedef struct {
+  volatile uint32_t CR1, CR2, CR3, CR4, SR1, SR2, SCR;
+} PWR_TypeDef;
+
+typedef struct {
+  volatile uint32_t TR, DR, CR, ISR, PRER, WUTR, RESERVED, ALRMAR, ALRMBR, WPR, SSR, SHIFTR, TSTR, TSDR,
+      TSSSR, CALR, TAMPCR, ALRMASSR, ALRMBSSR, OR;
+  volatile uint32_t BKP0R, BKP1R, BKP2R, BKP3R, BKP4R, BKP5R, BKP6R, BKP7R, BKP8R, BKP9R, BKP10R, BKP11R,
+      BKP12R, BKP13R, BKP14R, BKP15R, BKP16R, BKP17R, BKP18R, BKP19R, BKP20R, BKP21R, BKP22R, BKP23R, BKP24R,
+      BKP25R, BKP26R, BKP27R, BKP28R, BKP29R, BKP30R, BKP31R;
+} RTC_TypeDef;
+
+typedef struct {
+  volatile uint32_t CR1, CR2, SMCR, DIER, SR, EGR, CCMR1, CCMR2, CCER, CNT, PSC, ARR, RCR, CCR1, CCR2, CCR3,
+      CCR4, BDTR, DCR, DMAR, OR1, CCMR3, CCR5, CCR6, OR2, OR3;
+} TIM_TypeDef;
+
+typedef struct {
+  EmuRegister ISR, IFCR;
+} DMA_TypeDef;
+
+class EmuCycleCounter { // DWT cycle counter, counts the virtual clock at SystemCoreClock while enabled
+public:
+  EmuCycleCounter &operator=(uint32_t v);
+  operator uint32_t() const;
+  uint32_t base = 0;    // Value written
+  uint64_t base_ns = 0; // Virtual time of the write
+};
+
+typedef struct {
+  volatile uint32_t CTRL;
+  EmuCycleCounter CYCCNT;
+} DWT_Type;
+
+typedef struct {
+  volatile uint32_t DHCSR, DCRSR, DCRDR, DEMCR;
+} CoreDebug_Type;
+
+typedef struct {
+  volatile uint32_t CCR, CNDTR, CPAR, CMAR;
+} DMA_Channel_TypeDef;
+
+typedef struct {
+  volatile uint32_t ISR, IER, CR, CFGR, CFGR2, SMPR1, SMPR2, RESERVED1, TR1, TR2, TR3, RESERVED2, SQR1, SQR2,
+      SQR3, SQR4, DR;
+} ADC_TypeDef;
+
+typedef struct {
+  volatile uint32_t CR1, CR2, CR3, BRR, GTPR, RTOR, RQR, ISR, ICR, RDR, TDR, PRESC;
+} USART_TypeDef;
+
+extern GPIO_TypeDef emu_gpio[EMU_PORTS];
+extern RCC_TypeDef emu_rcc;
+extern PWR_TypeDef emu_pwr;
+extern RTC_TypeDef emu_rtc;
+extern TIM_TypeDef emu_tim4, emu_tim6;
+extern DMA_TypeDef emu_dma1;
+extern DMA_Channel_TypeDef emu_dma1_channel[7];
+extern ADC_TypeDef emu_adc1;
+extern USART_TypeDef emu_usart3;
+extern DWT_Type emu_dwt;
+extern CoreDebug_Type emu_core_debug;
+
+#define GPIOA (&emu_gpio[0])
+#define GPIOB (&emu_gpio[1])
+#define GPIOC (&emu_gpio[2])
+#define GPIOD (&emu_gpio[3])
+#define GPIOE (&emu_gpio[4])
+#define GPIOF (&emu_gpio[5])
+#define GPIOG (&emu_gpio[6])
+#define GPIOH (&emu_gpio[7])
+#define RCC (&emu_rcc)
+#define PWR (&emu_pwr)
+#define RTC (&emu_rtc)
+#define TIM4 (&emu_tim4)
+#define TIM6 (&emu_tim6)
+#define DMA1 (&emu_dma1)
+#define DMA1_Channel1 (&emu_dma1_channel[0])
+#define DMA1_Channel2 (&emu_dma1_channel[1])
+#define DMA1_Channel3 (&emu_dma1_channel[2])
+#define ADC1 (&emu_adc1)
+#define USART3 (&emu_usart3)
+#define DWT (&emu_dwt)
+#define CoreDebug (&emu_core_debug)
+
+#define DWT_CTRL_CYCCNTENA_Msk (1u << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk (1u << 24)
+
+#define RCC_APB1ENR1_PWREN (1u << 28)
+#define PWR_CR1_DBP (1u << 8)
+
+#define TIM_CR1_CEN (1u << 0)
+#define TIM_CR1_ARPE (1u << 7)
+#define TIM_DIER_UDE (1u << 8)
+#define TIM_EGR_UG (1u << 0)
+#define TIM_CCMR2_OC3PE (1u << 3)
+#define TIM_CCMR2_OC3M_Pos 4
+#define TIM_CCMR2_OC4PE (1u << 11)
+#define TIM_CCMR2_OC4M_Pos 12
+#define TIM_CCER_CC3E (1u << 8)
+#define TIM_CCER_CC4E (1u << 12)
+#define TIM_DMABASE_ARR 0x0000000Bu
+#define TIM_DMABURSTLENGTH_6TRANSFERS 0x00000500u
+
+#define USART_CR1_UE (1u << 0)
+#define USART_CR1_TE (1u << 3)
+#define USART_CR3_DMAT (1u << 7)
+
+#define DMA_ISR_GIF1 (1u << 0)
+#define DMA_ISR_TCIF1 (1u << 1)
+#define DMA_ISR_HTIF1 (1u << 2)
+#define DMA_ISR_TEIF1 (1u << 3)
+#define DMA_IFCR_CGIF1 (1u << 0)
+#define DMA_IFCR_CTCIF1 (1u << 1)
+#define DMA_IFCR_CHTIF1 (1u << 2)
+#define DMA_IFCR_CTEIF1 (1u << 3)
+#define DMA_CCR_EN (1u << 0)
+#define DMA_CCR_TCIE (1u << 1)
+#define DMA_CCR_TEIE (1u << 3)
+
+extern uint32_t SystemCoreClock; // 120MHz
+
+// CMSIS
+
+typedef enum {
+  DMA1_Channel1_IRQn = 11,
+  DMA1_Channel2_IRQn = 12,
+  DMA1_Channel3_IRQn = 13,
+  EMU_IRQ_COUNT = 128
+} IRQn_Type;
+
+void NVIC_SetVector(IRQn_Type irq, uint32_t vector);
+uint32_t NVIC_GetVector(IRQn_Type irq);
+void NVIC_EnableIRQ(IRQn_Type irq);
+void NVIC_DisableIRQ(IRQn_Type irq);
+
+// STM32L4 HAL, only the handles and calls the drivers use
+
+typedef enum { HAL_OK = 0, HAL_ERROR = 1, HAL_BUSY = 2, HAL_TIMEOUT = 3 } HAL_StatusTypeDef;
+
+#define ENABLE 1u
+#define DISABLE 0u
+
+#define GPIO_PIN_4 (1u << 4)
+#define GPIO_PIN_10 (1u << 10)
+#define GPIO_PIN_14 (1u << 14)
+#define GPIO_PIN_15 (1u << 15)
+#define GPIO_MODE_INPUT 0x0u
+#define GPIO_MODE_OUTPUT_PP 0x1u
+#define GPIO_MODE_AF_PP 0x2u
+#define GPIO_MODE_ANALOG 0x3u
+#define GPIO_NOPULL 0x0u
+#define GPIO_PULLUP 0x1u
+#define GPIO_PULLDOWN 0x2u
+#define GPIO_SPEED_FREQ_LOW 0x0u
+#define GPIO_SPEED_FREQ_HIGH 0x2u
+#define GPIO_AF2_TIM4 0x2u
+#define GPIO_AF7_USART3 0x7u
+
+typedef struct {
+  uint32_t Pin, Mode, Pull, Speed, Alternate;
+} GPIO_InitTypeDef;
+
+#define TIM_COUNTERMODE_UP 0x0u
+#define TIM_AUTORELOAD_PRELOAD_ENABLE TIM_CR1_ARPE
+#define TIM_TRGO_UPDATE 0x20u
+#define TIM_MASTERSLAVEMODE_DISABLE 0x0u
+
+typedef struct {
+  uint32_t Prescaler, CounterMode, Period, ClockDivision, RepetitionCounter, AutoReloadPreload;
+} TIM_Base_InitTypeDef;
+
+typedef struct {
+  TIM_TypeDef *Instance;
+  TIM_Base_InitTypeDef Init;
+} TIM_HandleTypeDef;
+
+typedef struct {
+  uint32_t MasterOutputTrigger, MasterOutputTrigger2, MasterSlaveMode;
+} TIM_MasterConfigTypeDef;
+
+#define DMA_REQUEST_ADC1 5u
+#define DMA_REQUEST_USART3_TX 29u
+#define DMA_REQUEST_TIM4_UP 69u
+#define DMA_PERIPH_TO_MEMORY 0x0u
+#define DMA_MEMORY_TO_PERIPH 0x10u
+#define DMA_PINC_DISABLE 0x0u
+#define DMA_MINC_ENABLE 0x80u
+#define DMA_PDATAALIGN_BYTE 0x0u
+#define DMA_MDATAALIGN_BYTE 0x0u
+#define DMA_PDATAALIGN_HALFWORD 0x100u
+#define DMA_PDATAALIGN_WORD 0x200u
+#define DMA_MDATAALIGN_HALFWORD 0x400u
+#define DMA_MDATAALIGN_WORD 0x800u
+#define DMA_NORMAL 0x0u
+#define DMA_CIRCULAR 0x20u
+#define DMA_PRIORITY_LOW 0x0u
+#define DMA_PRIORITY_HIGH 0x2000u
+
+typedef struct {
+  uint32_t Request, Direction, PeriphInc, MemInc, PeriphDataAlignment, MemDataAlignment, Mode, Priority;
+} DMA_InitTypeDef;
+
+typedef struct __DMA_HandleTypeDef {
+  DMA_Channel_TypeDef *Instance;
+  DMA_InitTypeDef Init;
+  void *Parent;
+  void (*XferCpltCallback)(struct __DMA_HandleTypeDef *dma);
+} DMA_HandleTypeDef;
+
+#define ADC_CLOCK_ASYNC_DIV4 0x00080000u
+#define ADC_RESOLUTION_12B 0x0u
+#define ADC_DATAALIGN_RIGHT 0x0u
+#define ADC_SCAN_DISABLE 0x0u
+#define ADC_EOC_SINGLE_CONV 0x4u
+#define ADC_EXTERNALTRIG_T6_TRGO 0x340u
+#define ADC_EXTERNALTRIGCONVEDGE_RISING 0x400u
+#define ADC_OVR_DATA_OVERWRITTEN 0x1000u
+#define ADC_CHANNEL_13 13u
+#define ADC_REGULAR_RANK_1 0x6u
+#define ADC_SAMPLETIME_47CYCLES_5 0x4u
+#define ADC_SINGLE_ENDED 0x7Fu
+#define ADC_OFFSET_NONE 0x4u
+#define RCC_ADCCLKSOURCE_SYSCLK 0x30000000u
+
+typedef struct {
+  uint32_t ClockPrescaler, Resolution, DataAlign, ScanConvMode, EOCSelection, LowPowerAutoWait,
+      ContinuousConvMode, NbrOfConversion, DiscontinuousConvMode, NbrOfDiscConversion, ExternalTrigConv,
+      ExternalTrigConvEdge, DMAContinuousRequests, Overrun, OversamplingMode;
+} ADC_InitTypeDef;
+
+typedef struct {
+  ADC_TypeDef *Instance;
+  ADC_InitTypeDef Init;
+  DMA_HandleTypeDef *DMA_Handle;
+} ADC_HandleTypeDef;
+
+typedef struct {
+  uint32_t Channel, Rank, SamplingTime, SingleDiff, OffsetNumber, Offset;
+} ADC_ChannelConfTypeDef;
+
+#define UART_WORDLENGTH_8B 0x0u
+#define UART_STOPBITS_1 0x0u
+#define UART_PARITY_NONE 0x0u
+#define UART_MODE_TX USART_CR1_TE
+#define UART_HWCONTROL_NONE 0x0u
+#define UART_OVERSAMPLING_16 0x0u
+
+typedef struct {
+  uint32_t BaudRate, WordLength, StopBits, Parity, Mode, HwFlowCtl, OverSampling, OneBitSampling, ClockPrescaler;
+} UART_InitTypeDef;
+
+typedef struct {
+  USART_TypeDef *Instance;
+  UART_InitTypeDef Init;
+} UART_HandleTypeDef;
+
+#define __HAL_RCC_GPIOB_CLK_ENABLE() (RCC->AHB2ENR |= (1u << 1))
+#define __HAL_RCC_GPIOC_CLK_ENABLE() (RCC->AHB2ENR |= (1u << 2))
+#define __HAL_RCC_GPIOD_CLK_ENABLE() (RCC->AHB2ENR |= (1u << 3))
+#define __HAL_RCC_ADC_CLK_ENABLE() (RCC->AHB2ENR |= (1u << 13))
+#define __HAL_RCC_DMA1_CLK_ENABLE() (RCC->AHB1ENR |= (1u << 0))
+#define __HAL_RCC_DMAMUX1_CLK_ENABLE() (RCC->AHB1ENR |= (1u << 2))
+#define __HAL_RCC_TIM4_CLK_ENABLE() (RCC->APB1ENR1 |= (1u << 2))
+#define __HAL_RCC_TIM6_CLK_ENABLE() (RCC->APB1ENR1 |= (1u << 4))
+#define __HAL_RCC_USART3_CLK_ENABLE() (RCC->APB1ENR1 |= (1u << 18))
+#define __HAL_RCC_ADC_CONFIG(source) (RCC->CCIPR = (RCC->CCIPR & ~0x30000000u) | (source))
+#define __HAL_LINKDMA(handle, field, dma) \
+  do {                                    \
+    (handle)->field = &(dma);             \
+    (dma).Parent = (handle);              \
+  } while (0)
+
+void HAL_GPIO_Init(GPIO_TypeDef *port, GPIO_InitTypeDef *init);
+HAL_StatusTypeDef HAL_TIM_Base_Init(TIM_HandleTypeDef *timer);
+HAL_StatusTypeDef HAL_TIM_Base_Start(TIM_HandleTypeDef *timer);
+HAL_StatusTypeDef HAL_TIMEx_MasterConfigSynchronization(TIM_HandleTypeDef *timer, TIM_MasterConfigTypeDef *config);
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef *dma);
+HAL_StatusTypeDef HAL_DMA_Start(DMA_HandleTypeDef *dma, uint32_t source, uint32_t destination, uint32_t length);
+HAL_StatusTypeDef HAL_DMA_Start_IT(DMA_HandleTypeDef *dma, uint32_t source, uint32_t destination, uint32_t length);
+HAL_StatusTypeDef HAL_DMA_Abort(DMA_HandleTypeDef *dma);
+void HAL_DMA_IRQHandler(DMA_HandleTypeDef *dma);
+HAL_StatusTypeDef HAL_ADC_Init(ADC_HandleTypeDef *adc);
+HAL_StatusTypeDef HAL_ADC_ConfigChannel(ADC_HandleTypeDef *adc, ADC_ChannelConfTypeDef *config);
+HAL_StatusTypeDef HAL_ADCEx_Calibration_Start(ADC_HandleTypeDef *adc, uint32_t single_diff);
+HAL_StatusTypeDef HAL_ADC_Start_DMA(ADC_HandleTypeDef *adc, uint32_t *buffer, uint32_t length);
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *uart);
+
+// mbed platform
+
+void wait_us(int us); // Busy wait, the thread keeps the CPU
+void wait_ns(unsigned int ns);
+uint32_t us_ticker_read(void);
+void core_util_critical_section_enter(void);
+void core_util_critical_section_exit(void);
+// One thread runs everything on the host, the target's LDREX/STREX loops become plain accesses
+inline uint32_t core_util_atomic_load_u32(const volatile uint32_t *ptr) { return *ptr; }
+inline void core_util_atomic_store_u32(volatile uint32_t *ptr, uint32_t value) { *ptr = value; }
+inline uint32_t core_util_atomic_incr_u32(volatile uint32_t *ptr, uint32_t delta) { return *ptr += delta; }
+inline bool core_util_atomic_cas_u32(volatile uint32_t *ptr, uint32_t *expected, uint32_t desired) {
+  if (*ptr != *expected) {
+    *expected = *ptr;
+    return false;
+  }
+  *ptr = desired;
+  return true;
+}
+void set_time(time_t t);
+time_t emu_time(time_t *t);
+int emu_getchar(void);
+
+#define EVENTS_EVENT_SIZE 52                          // equeue event header plus an mbed Callback on the target
+#define EVENTS_QUEUE_SIZE (32 * EVENTS_EVENT_SIZE)    // mbed default
+#ifndef OS_STACK_SIZE
+#define OS_STACK_SIZE 4096
+#endif
+
+typedef uint64_t us_timestamp_t;
+
+class DigitalOut {
+public:
+  DigitalOut(PinName pin);
+  DigitalOut(PinName pin, int value);
+  void write(int value);
+  int read();
+  int is_connected() { return _pin != NC; }
+  DigitalOut &operator=(int value) {
+    write(value);
+    return *this;
+  }
+  operator int() { return read(); }
+
+private:
+  PinName _pin;
+};
+
+class DigitalIn {
+public:
+  DigitalIn(PinName pin);
+  DigitalIn(PinName pin, PinMode mode);
+  int read();
+  void mode(PinMode pull);
+  operator int() { return read(); }
+
+private:
+  PinName _pin;
+};
+
+class InterruptIn : private EmuPinListener {
+public:
+  InterruptIn(PinName pin);
+  InterruptIn(PinName pin, PinMode mode);
+  int read();
+  operator int() { return read(); }
+  void rise(Callback<void()> func);
+  void fall(Callback<void()> func);
+  void mode(PinMode pull);
+  void enable_irq();
+  void disable_irq();
+
+private:
+  void pin_changed(int level) override;
+  PinName _pin;
+  Callback<void()> _rise;
+  Callback<void()> _fall;
+  bool _irq_enabled = true;
+};
+
+class Ticker {
+public:
+  Ticker() = default;
+  Ticker(const Ticker &) = delete;
+  virtual ~Ticker();
+  void attach(Callback<void()> func, std::chrono::microseconds t);
+  void attach_us(Callback<void()> func, us_timestamp_t t) { attach(func, std::chrono::microseconds(t)); }
+  void detach();
+
+protected:
+  EmuTimer _timer;
+};
+
+class Timeout : public Ticker {
+public:
+  void attach(Callback<void()> func, std::chrono::microseconds t);
+  void attach_us(Callback<void()> func, us_timestamp_t t) { attach(func, std::chrono::microseconds(t)); }
+  std::chrono::microseconds remaining_time() const;
+};
+
+class Timer {
+public:
+  void start();
+  void stop();
+  void reset();
+  std::chrono::microseconds elapsed_time() const;
+  int read_us() const { return (int)elapsed_time().count(); }
+  int read_ms() const { return (int)(elapsed_time().count() / 1000); }
+  float read() const { return elapsed_time().count() / 1000000.0f; }
+
+private:
+  uint64_t _start_ns = 0;
+  uint64_t _banked_ns = 0;
+  bool _running = false;
+};
+
+// RTOS
+
+typedef void *osThreadId_t;
+typedef enum {
+  osPriorityNone = 0,
+  osPriorityIdle = 1,
+  osPriorityLow = 8,
+  osPriorityBelowNormal = 16,
+  osPriorityNormal = 24,
+  osPriorityAboveNormal = 32,
+  osPriorityHigh = 40,
+  osPriorityRealtime = 48,
+  osPriorityISR = 56
+} osPriority_t;
+typedef osPriority_t osPriority;
+typedef enum {
+  osOK = 0,
+  osError = -1,
+  osErrorTimeout = -2,
+  osErrorResource = -3,
+  osErrorParameter = -4,
+  osErrorNoMemory = -5,
+  osErrorISR = -6
+} osStatus_t;
+typedef osStatus_t osStatus;
+#define osWaitForever 0xFFFFFFFFu
+
+const char *osThreadGetName(osThreadId_t thread_id);
+
+namespace Kernel {
+struct Clock {
+  typedef std::chrono::milliseconds duration;
+  typedef duration::rep rep;
+  typedef duration::period period;
+  typedef std::chrono::time_point<Clock> time_point;
+  typedef std::chrono::duration<uint32_t, std::milli> duration_u32;
+  static constexpr bool is_steady = true;
+  static time_point now();
+};
+uint64_t get_ms_count();
+} // namespace Kernel
+
+struct EmuTask; // Emulated thread, defined by the emulator
+
+class Thread {
+public:
+  enum State {
+    Inactive,
+    Ready,
+    Running,
+    WaitingDelay,
+    WaitingJoin,
+    WaitingThreadFlag,
+    WaitingEventFlag,
+    WaitingMutex,
+    WaitingSemaphore,
+    WaitingMemoryPool,
+    WaitingMessageGet,
+    WaitingMessagePut,
+    WaitingInterval,
+    WaitingOr,
+    WaitingAnd,
+    WaitingMailbox,
+    Deleted
+  };
+  Thread(osPriority priority = osPriorityNormal, uint32_t stack_size = OS_STACK_SIZE,
+         unsigned char *stack_mem = nullptr, const char *name = nullptr);
+  Thread(const Thread &) = delete;
+  ~Thread();
+  osStatus start(Callback<void()> task);
+  osStatus join();
+  osStatus terminate();
+  osStatus set_priority(osPriority priority);
+  osPriority get_priority() const;
+  uint32_t flags_set(uint32_t flags);
+  State get_state() const;
+  uint32_t stack_size() const;
+  uint32_t free_stack() const;
+  uint32_t used_stack() const;
+  uint32_t max_stack() const;
+  const char *get_name() const;
+  osThreadId_t get_id() const;
+
+private:
+  EmuTask *_task;
+};
+
+namespace ThisThread {
+uint32_t flags_clear(uint32_t flags);
+uint32_t flags_get();
+uint32_t flags_wait_all(uint32_t flags, bool clear = true);
+uint32_t flags_wait_any(uint32_t flags, bool clear = true);
+uint32_t flags_wait_all_for(uint32_t flags, Kernel::Clock::duration_u32 rel_time, bool clear = true);
+uint32_t flags_wait_any_for(uint32_t flags, Kernel::Clock::duration_u32 rel_time, bool clear = true);
+uint32_t flags_wait_any_until(uint32_t flags, Kernel::Clock::time_point abs_time, bool clear = true);
+void sleep_for(Kernel::Clock::duration_u32 rel_time);
+void sleep_until(Kernel::Clock::time_point abs_time);
+void yield();
+osThreadId_t get_id();
+const char *get_name();
+} // namespace ThisThread
+
+void thread_sleep_for(uint32_t millisec);
+
+class Mutex {
+public:
+  Mutex(const char *name = nullptr) : _name(name) {}
+  Mutex(const Mutex &) = delete;
+  void lock();
+  bool trylock();
+  bool trylock_for(Kernel::Clock::duration_u32 rel_time);
+  void unlock();
+  osThreadId_t get_owner();
+
+private:
+  const char *_name;
+  EmuTask *_owner = nullptr;
+  uint32_t _count = 0; // Recursive lock depth
+};
+
+struct EmuQueue; // EventQueue storage, defined by the emulator
+
+class EventQueue {
+public:
+  EventQueue(unsigned size = EVENTS_QUEUE_SIZE, unsigned char *buffer = nullptr);
+  EventQueue(const EventQueue &) = delete;
+  ~EventQueue();
+  void dispatch_forever();
+  void dispatch_once();
+  void dispatch_for(std::chrono::milliseconds ms);
+  void break_dispatch();
+  bool cancel(int id);
+  std::chrono::milliseconds time_left(int id);
+
+  template <typename F, typename... Args> int call(F f, Args... args) {
+    return post(0, 0, [=]() { std::invoke(f, args...); });
+  }
+  template <typename F, typename... Args> int call_in(std::chrono::milliseconds ms, F f, Args... args) {
+    return post(ms.count() * 1000000ull, 0, [=]() { std::invoke(f, args...); });
+  }
+  template <typename F, typename... Args> int call_every(std::chrono::milliseconds ms, F f, Args... args) {
+    return post(ms.count() * 1000000ull, ms.count() * 1000000ull, [=]() { std::invoke(f, args...); });
+  }
+
+private:
+  int post(uint64_t delay_ns, uint64_t period_ns, std::function<void()> event);
+  EmuQueue *_queue;
+};
+
+class Watchdog {
+public:
+  static Watchdog &get_instance();
+  bool start(uint32_t timeout);
+  bool start();
+  bool stop();
+  void kick();
+  uint32_t get_timeout() const { return _timeout_ms; }
+  bool is_running() const { return _running; }
+
+private:
+  Watchdog() = default;
+  uint32_t _timeout_ms = 0;
+  bool _running = false;
+  EmuTimer _timer;
+};
+
+// Statistics
+
+typedef struct {
+  uint32_t thread_id, max_size, reserved_size, stack_cnt;
+} mbed_stats_stack_t;
+
+typedef struct {
+  uint32_t current_size, max_size, total_size, reserved_size, alloc_cnt, alloc_fail_cnt, overhead_size;
+} mbed_stats_heap_t;
+
+typedef struct {
+  uint64_t uptime, idle_time, sleep_time, deep_sleep_time;
+} mbed_stats_cpu_t;
+
+size_t mbed_stats_stack_get_each(mbed_stats_stack_t *stats, size_t count);
+void mbed_stats_heap_get(mbed_stats_heap_t *stats);
+void mbed_stats_cpu_get(mbed_stats_cpu_t *stats);
+
+// Drivers
+
+class I2C {
+public:
+  I2C(PinName sda, PinName scl);
+  void frequency(int hz);
+  int write(int address, const char *data, int length, bool repeated = false);
+  int write(int data);
+  int read(int address, char *data, int length, bool repeated = false);
+  void start();
+  void stop();
+
+private:
+  uint32_t _bit_ns; // One SCL period
+};
+
+class FlashIAP {
+public:
+  int init();
+  int deinit();
+  int read(void *buffer, uint32_t address, uint32_t size);
+  int program(const void *buffer, uint32_t address, uint32_t size);
+  int erase(uint32_t address, uint32_t size);
+  uint32_t get_sector_size(uint32_t address) const;
+  uint32_t get_flash_start() const;
+  uint32_t get_flash_size() const;
+  uint32_t get_page_size() const;
+  uint8_t get_erase_value() const;
+};
+
+class UnbufferedSerial { // Console UART, received bytes are shared with getchar
+public:
+  enum IrqType { RxIrq = 0, TxIrq };
+  UnbufferedSerial(PinName tx, PinName rx, int baud = 9600);
+  ~UnbufferedSerial();
+  void attach(Callback<void()> func, IrqType type = RxIrq);
+  ssize_t read(void *buffer, size_t length);
+  ssize_t write(const void *buffer, size_t length);
+  bool readable();
+
+private:
+  friend void emu_serial_input(const char *text);
+  Callback<void()> _rx; // Runs as an ISR for every received byte
+};
+
+// GPIO HAL
+
+typedef enum { PIN_INPUT, PIN_OUTPUT } PinDirection;
+typedef enum { IRQ_NONE, IRQ_RISE, IRQ_FALL } gpio_irq_event;
+typedef void (*gpio_irq_handler)(uint32_t id, gpio_irq_event event);
+
+typedef struct {
+  uint32_t mask;
+  PinName pin;
+} gpio_t;
+
+typedef struct gpio_irq_s : EmuPinListener {
+  void pin_changed(int level) override;
+  gpio_irq_handler handler = nullptr;
+  uint32_t id = 0;
+  bool rise = false;
+  bool fall = false;
+  bool enabled = false;
+} gpio_irq_t;
+
+void gpio_init(gpio_t *obj, PinName pin);
+void gpio_init_in(gpio_t *obj, PinName pin);
+void gpio_init_in_ex(gpio_t *obj, PinName pin, PinMode mode);
+void gpio_init_out(gpio_t *obj, PinName pin);
+void gpio_init_out_ex(gpio_t *obj, PinName pin, int value);
+void gpio_dir(gpio_t *obj, PinDirection direction);
+void gpio_mode(gpio_t *obj, PinMode mode);
+void gpio_write(gpio_t *obj, int value);
+int gpio_read(gpio_t *obj);
+int gpio_irq_init(gpio_irq_t *obj, PinName pin, gpio_irq_handler handler, uint32_t id);
+void gpio_irq_free(gpio_irq_t *obj);
+void gpio_irq_set(gpio_irq_t *obj, gpio_irq_event event, uint32_t enable);
+void gpio_irq_enable(gpio_irq_t *obj);
+void gpio_irq_disable(gpio_irq_t *obj);
+
+// The target's time() reads the RTC and getchar() the UART. Both names are taken by the C library,
+// so calls are routed to the emulator. Only calls are renamed, "time" as a variable is untouched
+#define time(t) emu_time(t)
+#define getchar() emu_getchar()
+
+#endif